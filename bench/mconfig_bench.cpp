@@ -0,0 +1,307 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+// Measures parsing throughput for a single input file.
+//
+// Usage: mconfig_bench <config|varlist|varlist-section> <file> [iterations]
+//
+//     config          - parseConfig() into a new Config on every iteration;
+//     varlist         - VarlistParser::parseVarlist() into a new Varlist;
+//     varlist-section - parseVarlistSection() on the root section of a config
+//                       file which is parsed once, outside of the measurement.
+//
+// Prints one JSON object per run to stdout:
+//
+//     {"benchmark":"config","file":"wide.conf","bytes":1048576,"nodes":65536,
+//      "iterations":10,"best_sec":0.0123,"mean_sec":0.0131,
+//      "mb_per_sec":81.3,"nodes_per_sec":5328130,"peak_rss_kb":10240}
+//
+// Throughput figures are computed from the best iteration. Nodes are sections,
+// attributes, options and values for config files, vars and enable/disable
+// specifiers for varlists. Peak RSS covers the whole process, so run one file
+// per process (bench/run_bench.sh does that).
+
+
+#include <libmary/libmary.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <mconfig/mconfig.h>
+
+
+using namespace M;
+using namespace MConfig;
+
+namespace {
+
+enum Benchmark {
+    Benchmark_Config,
+    Benchmark_Varlist,
+    Benchmark_VarlistSection
+};
+
+char const * const benchmark_names [] = {
+    "config",
+    "varlist",
+    "varlist-section"
+};
+
+double getTimeSeconds ()
+{
+    struct timespec ts;
+    if (clock_gettime (CLOCK_MONOTONIC, &ts)) {
+        perror ("mconfig_bench: clock_gettime()");
+        exit (EXIT_FAILURE);
+    }
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+long getPeakRssKb ()
+{
+    struct rusage usage;
+    if (getrusage (RUSAGE_SELF, &usage)) {
+        perror ("mconfig_bench: getrusage()");
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+
+struct NodeCounter
+{
+    Uint64 num_nodes;
+
+    static bool beginSection (ConstMemory                 /* section_name */,
+                              ConfigAttributeDesc const * /* attrs */,
+                              Count                       const num_attrs,
+                              void                      * const _self)
+    {
+        NodeCounter * const self = static_cast <NodeCounter*> (_self);
+        self->num_nodes += 1 + num_attrs;
+        return true;
+    }
+
+    static bool option (ConstMemory         /* key */,
+                        ConstMemory const * /* values */,
+                        Count               const num_values,
+                        void              * const _self)
+    {
+        NodeCounter * const self = static_cast <NodeCounter*> (_self);
+        self->num_nodes += 1 + num_values;
+        return true;
+    }
+
+    static ConfigEvents const events;
+
+    NodeCounter () : num_nodes (0) {}
+};
+
+ConfigEvents const NodeCounter::events = {
+    NodeCounter::beginSection,
+    NodeCounter::option,
+    NULL /* endSection */,
+    NULL /* cancelSection */
+};
+
+Uint64 countVarlistNodes (Varlist * const varlist)
+{
+    Uint64 num_nodes = 0;
+
+    {
+        Varlist::VarList::iter iter (varlist->var_list);
+        while (!varlist->var_list.iter_done (iter)) {
+            varlist->var_list.iter_next (iter);
+            ++num_nodes;
+        }
+    }
+
+    {
+        Varlist::SectionList::iter iter (varlist->section_list);
+        while (!varlist->section_list.iter_done (iter)) {
+            varlist->section_list.iter_next (iter);
+            ++num_nodes;
+        }
+    }
+
+    return num_nodes;
+}
+
+// Runs one iteration of @benchmark. Time spent outside of the measured call
+// is excluded from *ret_time.
+bool runIteration (Benchmark       const benchmark,
+                   ConstMemory     const filename,
+                   VarlistParser * const varlist_parser,
+                   Config        * const section_config,
+                   double        * const ret_time,
+                   Uint64        * const ret_num_nodes)
+{
+    switch (benchmark) {
+        case Benchmark_Config: {
+            Ref<Config> const config = grab (new (std::nothrow) Config);
+
+            double const start_time = getTimeSeconds ();
+            if (!parseConfig (filename, config)) {
+                fprintf (stderr, "mconfig_bench: parseConfig() failed\n");
+                return false;
+            }
+            *ret_time = getTimeSeconds () - start_time;
+
+            if (!*ret_num_nodes) {
+                NodeCounter counter;
+                if (!parseConfigEvents (filename, &NodeCounter::events, &counter))
+                    return false;
+
+                *ret_num_nodes = counter.num_nodes;
+            }
+        } break;
+        case Benchmark_Varlist: {
+            Varlist varlist;
+
+            double const start_time = getTimeSeconds ();
+            if (!varlist_parser->parseVarlist (filename, &varlist)) {
+                fprintf (stderr, "mconfig_bench: parseVarlist() failed\n");
+                return false;
+            }
+            *ret_time = getTimeSeconds () - start_time;
+
+            *ret_num_nodes = countVarlistNodes (&varlist);
+        } break;
+        case Benchmark_VarlistSection: {
+            Varlist varlist;
+
+            double const start_time = getTimeSeconds ();
+            parseVarlistSection (section_config->getRootSection(), &varlist);
+            *ret_time = getTimeSeconds () - start_time;
+
+            *ret_num_nodes = countVarlistNodes (&varlist);
+        } break;
+    }
+
+    return true;
+}
+
+void usage ()
+{
+    fprintf (stderr, "Usage: mconfig_bench <config|varlist|varlist-section> <file> [iterations]\n");
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    libMaryInit ();
+
+    if (argc != 3 && argc != 4) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    Benchmark benchmark;
+    if (!strcmp (argv [1], benchmark_names [Benchmark_Config])) {
+        benchmark = Benchmark_Config;
+    } else
+    if (!strcmp (argv [1], benchmark_names [Benchmark_Varlist])) {
+        benchmark = Benchmark_Varlist;
+    } else
+    if (!strcmp (argv [1], benchmark_names [Benchmark_VarlistSection])) {
+        benchmark = Benchmark_VarlistSection;
+    } else {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    char const * const filename_str = argv [2];
+    ConstMemory const filename (filename_str, strlen (filename_str));
+
+    unsigned long num_iterations = 10;
+    if (argc == 4) {
+        num_iterations = strtoul (argv [3], NULL, 10);
+        if (num_iterations == 0) {
+            usage ();
+            return EXIT_FAILURE;
+        }
+    }
+
+    Uint64 num_bytes;
+    {
+        struct stat st;
+        if (stat (filename_str, &st)) {
+            perror ("mconfig_bench: stat()");
+            return EXIT_FAILURE;
+        }
+        num_bytes = (Uint64) st.st_size;
+    }
+
+    VarlistParser *varlist_parser = NULL;
+    if (benchmark == Benchmark_Varlist) {
+        varlist_parser = new (std::nothrow) VarlistParser;
+        assert (varlist_parser);
+    }
+
+    Ref<Config> section_config;
+    if (benchmark == Benchmark_VarlistSection) {
+        section_config = grab (new (std::nothrow) Config);
+        if (!parseConfig (filename, section_config)) {
+            fprintf (stderr, "mconfig_bench: parseConfig() failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    double best_time = 0.0;
+    double total_time = 0.0;
+    Uint64 num_nodes = 0;
+    for (unsigned long i = 0; i < num_iterations; ++i) {
+        double time;
+        if (!runIteration (benchmark, filename, varlist_parser, section_config, &time, &num_nodes))
+            return EXIT_FAILURE;
+
+        if (i == 0 || time < best_time)
+            best_time = time;
+
+        total_time += time;
+    }
+
+    delete varlist_parser;
+
+    // Guards against division by zero for tiny inputs.
+    double const best_time_nonzero = (best_time > 1e-9 ? best_time : 1e-9);
+
+    printf ("{\"benchmark\":\"%s\",\"file\":\"%s\",\"bytes\":%llu,\"nodes\":%llu,"
+            "\"iterations\":%lu,\"best_sec\":%.9f,\"mean_sec\":%.9f,"
+            "\"mb_per_sec\":%.3f,\"nodes_per_sec\":%.0f,\"peak_rss_kb\":%ld}\n",
+            benchmark_names [benchmark],
+            filename_str,
+            (unsigned long long) num_bytes,
+            (unsigned long long) num_nodes,
+            num_iterations,
+            best_time,
+            total_time / num_iterations,
+            (double) num_bytes / (1024.0 * 1024.0) / best_time_nonzero,
+            (double) num_nodes / best_time_nonzero,
+            getPeakRssKb ());
+
+    return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,340 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+// Generates synthetic mconfig and varlist files for mconfig_bench.
+//
+// Usage: mconfig_gen <config|varlist> <shape> <size>[K|M] <output_file>
+//
+// Shapes:
+//     wide   - few sections with thousands of options each;
+//     deep   - sections nested 32 levels deep;
+//     lists  - options with 64 values each;
+//     quoted - quoted keys and values with spaces and escapes;
+//     attrs  - sections with 8 attributes each;
+//     mixed  - all of the above, interleaved.
+//
+// For varlist files, "quoted" produces quoted values, other shapes produce
+// plain "name = value" lines mixed with enable/disable specifiers.
+//
+// Output is deterministic for given arguments. The file is at least <size>
+// bytes long and exceeds it by one generated unit at most.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+
+
+namespace {
+
+enum Shape {
+    Shape_Wide,
+    Shape_Deep,
+    Shape_Lists,
+    Shape_Quoted,
+    Shape_Attrs,
+    Shape_Mixed,
+    Shape_Num
+};
+
+char const * const shape_names [] = {
+    "wide",
+    "deep",
+    "lists",
+    "quoted",
+    "attrs",
+    "mixed"
+};
+
+unsigned const wide_options_per_section = 4096;
+unsigned const deep_depth               = 32;
+unsigned const list_num_values          = 64;
+unsigned const attrs_per_section        = 8;
+// Options per wide section in Shape_Mixed.
+unsigned const mixed_wide_options       = 64;
+
+class Generator
+{
+private:
+    FILE *file;
+    unsigned long long num_bytes;
+    unsigned long long counter;
+
+    // Open section in Shape_Wide mode.
+    unsigned wide_options_left;
+    unsigned long long num_wide_options;
+
+    void put (char const *fmt, ...)
+        __attribute__ ((format (printf, 2, 3)))
+    {
+        va_list args;
+        va_start (args, fmt);
+        int const res = vfprintf (file, fmt, args);
+        va_end (args);
+
+        if (res < 0) {
+            perror ("mconfig_gen: vfprintf()");
+            exit (EXIT_FAILURE);
+        }
+
+        num_bytes += (unsigned long long) res;
+    }
+
+    void indent (unsigned const depth)
+    {
+        for (unsigned i = 0; i < depth; ++i)
+            put ("    ");
+    }
+
+    void closeWide ()
+    {
+        if (wide_options_left) {
+            put ("}\n\n");
+            wide_options_left = 0;
+        }
+    }
+
+    void configWide ()
+    {
+        if (!wide_options_left) {
+            put ("wide_%llu {\n", counter);
+            wide_options_left = wide_options_per_section;
+        }
+
+        put ("    option_%llu = value_%llu\n", num_wide_options, num_wide_options * 7);
+
+        ++num_wide_options;
+        --wide_options_left;
+        if (!wide_options_left)
+            put ("}\n\n");
+    }
+
+    void configDeep ()
+    {
+        for (unsigned i = 0; i < deep_depth; ++i) {
+            indent (i);
+            put ("level_%u {\n", i);
+            indent (i + 1);
+            put ("depth = %u\n", i);
+        }
+
+        indent (deep_depth);
+        put ("leaf = leaf_%llu\n", counter);
+
+        for (unsigned i = deep_depth; i > 0; --i) {
+            indent (i - 1);
+            put ("}\n");
+        }
+        put ("\n");
+    }
+
+    void configLists ()
+    {
+        put ("list_%llu = ", counter);
+        for (unsigned i = 0; i < list_num_values; ++i)
+            put ("%sitem_%u", (i ? ", " : ""), i);
+        put ("\n");
+    }
+
+    void configQuoted ()
+    {
+        put ("\"quoted key %llu\" = \"literal value with spaces, "
+             "\\\"escaped quotes\\\" and // no comment %llu\", "
+             "\"second value\"\n",
+             counter, counter);
+    }
+
+    void configAttrs ()
+    {
+        put ("item_%llu", counter);
+        for (unsigned i = 0; i < attrs_per_section; ++i) {
+            if (i % 2)
+                put (" flag_%u", i);
+            else
+                put (" attr_%u = value_%u", i, i);
+        }
+        put (" {\n"
+             "    id = %llu\n"
+             "}\n",
+             counter);
+    }
+
+    void configUnit (Shape const shape)
+    {
+        switch (shape) {
+            case Shape_Wide:   configWide ();   break;
+            case Shape_Deep:   configDeep ();   break;
+            case Shape_Lists:  configLists ();  break;
+            case Shape_Quoted: configQuoted (); break;
+            case Shape_Attrs:  configAttrs ();  break;
+            case Shape_Mixed:  break;
+            case Shape_Num:    break;
+        }
+    }
+
+    void varlistUnit (Shape const shape)
+    {
+        switch (counter % 8) {
+            case 3:
+                put ("enable section_%llu\n", counter);
+                break;
+            case 7:
+                put ("disable section_%llu = 0\n", counter);
+                break;
+            default:
+                if (shape == Shape_Quoted)
+                    put ("var_%llu = \"value with spaces %llu\"\n", counter, counter);
+                else
+                    put ("var_%llu = value_%llu\n", counter, counter);
+        }
+    }
+
+public:
+    void generateConfig (Shape const shape,
+                         unsigned long long const size)
+    {
+        while (num_bytes < size) {
+            if (shape == Shape_Mixed) {
+                Shape const unit_shape = (Shape) (counter % Shape_Mixed);
+                if (unit_shape == Shape_Wide) {
+                    for (unsigned i = 0; i < mixed_wide_options; ++i)
+                        configWide ();
+
+                    closeWide ();
+                } else {
+                    configUnit (unit_shape);
+                }
+            } else {
+                configUnit (shape);
+            }
+
+            ++counter;
+        }
+
+        closeWide ();
+    }
+
+    void generateVarlist (Shape const shape,
+                          unsigned long long const size)
+    {
+        while (num_bytes < size) {
+            varlistUnit (shape);
+            ++counter;
+        }
+    }
+
+    Generator (FILE * const file)
+        : file (file),
+          num_bytes (0),
+          counter (0),
+          wide_options_left (0),
+          num_wide_options (0)
+    {
+    }
+};
+
+bool parseSize (char const * const str,
+                unsigned long long * const ret_size)
+{
+    char *endptr;
+    unsigned long long size = strtoull (str, &endptr, 10);
+    if (endptr == str)
+        return false;
+
+    if (*endptr == 'K' || *endptr == 'k') {
+        size *= 1024;
+        ++endptr;
+    } else
+    if (*endptr == 'M' || *endptr == 'm') {
+        size *= 1024 * 1024;
+        ++endptr;
+    }
+
+    if (*endptr)
+        return false;
+
+    *ret_size = size;
+    return true;
+}
+
+void usage ()
+{
+    fprintf (stderr, "Usage: mconfig_gen <config|varlist> <shape> <size>[K|M] <output_file>\n"
+                     "Shapes: wide, deep, lists, quoted, attrs, mixed\n");
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    if (argc != 5) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    bool varlist = false;
+    if (!strcmp (argv [1], "varlist")) {
+        varlist = true;
+    } else
+    if (strcmp (argv [1], "config")) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    Shape shape = Shape_Num;
+    for (unsigned i = 0; i < Shape_Num; ++i) {
+        if (!strcmp (argv [2], shape_names [i])) {
+            shape = (Shape) i;
+            break;
+        }
+    }
+    if (shape == Shape_Num) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long size;
+    if (!parseSize (argv [3], &size)) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    FILE * const file = fopen (argv [4], "w");
+    if (!file) {
+        perror ("mconfig_gen: fopen()");
+        return EXIT_FAILURE;
+    }
+
+    {
+        Generator gen (file);
+        if (varlist)
+            gen.generateVarlist (shape, size);
+        else
+            gen.generateConfig (shape, size);
+    }
+
+    if (fclose (file)) {
+        perror ("mconfig_gen: fclose()");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
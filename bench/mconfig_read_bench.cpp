@@ -0,0 +1,259 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+// Measures read throughput of a Config shared between threads.
+//
+// Usage: mconfig_read_bench [max_threads] [seconds] [num_options]
+//
+// Builds a Config with num_options integer options (1024 by default) and
+// reads them with Config::getInt64() from 1, 2, 4... up to max_threads
+// threads (the number of online CPUs by default), for the given number of
+// seconds per thread count (1 by default). Decoded values are cached after
+// the first read, so the runs measure path lookups and cache hits, which is
+// what hot configs do.
+//
+// Prints one JSON object per thread count to stdout:
+//
+//     {"benchmark":"read","threads":4,"options":1024,"lookups":123456789,
+//      "sec":1.000123,"lookups_per_sec":123441604,"per_thread":30860401,
+//      "scaling":3.92}
+//
+// "scaling" is throughput relative to the single-threaded run. Lock-free
+// readers should keep it close to the thread count as long as there are
+// enough cores.
+
+
+#include <libmary/libmary.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <mconfig/mconfig.h>
+
+
+using namespace M;
+using namespace MConfig;
+
+namespace {
+
+// Checked once per this many lookups.
+unsigned const stop_check_interval = 1024;
+
+Config *config;
+ConstMemory *paths;
+Count num_options = 1024;
+
+AtomicInt stop_flag;
+pthread_barrier_t start_barrier;
+
+struct ThreadState
+{
+    unsigned idx;
+    Uint64   num_lookups;
+    // Keeps results from being optimized out.
+    Int64    sum;
+    // Keeps counters of neighbouring threads off the same cache line.
+    char     pad [64];
+};
+
+double getTimeSeconds ()
+{
+    struct timespec ts;
+    if (clock_gettime (CLOCK_MONOTONIC, &ts)) {
+        perror ("mconfig_read_bench: clock_gettime()");
+        exit (EXIT_FAILURE);
+    }
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+void* threadFunc (void * const _state)
+{
+    ThreadState * const state = static_cast <ThreadState*> (_state);
+
+    pthread_barrier_wait (&start_barrier);
+
+    // Threads start at different options to avoid reading in lockstep.
+    Count opt_idx = (state->idx * 7919) % num_options;
+    Uint64 num_lookups = 0;
+    Int64 sum = 0;
+    while (!stop_flag.get()) {
+        for (unsigned i = 0; i < stop_check_interval; ++i) {
+            Int64 val = 0;
+            config->getInt64 (paths [opt_idx], &val);
+            sum += val;
+
+            ++opt_idx;
+            if (opt_idx == num_options)
+                opt_idx = 0;
+        }
+
+        num_lookups += stop_check_interval;
+    }
+
+    state->num_lookups = num_lookups;
+    state->sum = sum;
+    return NULL;
+}
+
+// Returns the number of lookups per second.
+double runThreads (unsigned const num_threads,
+                   double   const seconds)
+{
+    pthread_t   * const threads = new (std::nothrow) pthread_t [num_threads];
+    ThreadState * const states  = new (std::nothrow) ThreadState [num_threads];
+    assert (threads && states);
+
+    stop_flag.set (0);
+    // The main thread joins the barrier to start the clock with the workers.
+    if (pthread_barrier_init (&start_barrier, NULL, num_threads + 1)) {
+        perror ("mconfig_read_bench: pthread_barrier_init()");
+        exit (EXIT_FAILURE);
+    }
+
+    for (unsigned i = 0; i < num_threads; ++i) {
+        states [i].idx = i;
+        states [i].num_lookups = 0;
+        states [i].sum = 0;
+        if (pthread_create (&threads [i], NULL, threadFunc, &states [i])) {
+            perror ("mconfig_read_bench: pthread_create()");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    pthread_barrier_wait (&start_barrier);
+    double const start_time = getTimeSeconds ();
+
+    usleep ((useconds_t) (seconds * 1e6));
+    stop_flag.set (1);
+
+    Uint64 num_lookups = 0;
+    for (unsigned i = 0; i < num_threads; ++i) {
+        pthread_join (threads [i], NULL);
+        num_lookups += states [i].num_lookups;
+    }
+
+    double const time = getTimeSeconds () - start_time;
+    pthread_barrier_destroy (&start_barrier);
+
+    double const lookups_per_sec = (double) num_lookups / time;
+
+    static double single_thread_rate = 0.0;
+    if (num_threads == 1)
+        single_thread_rate = lookups_per_sec;
+
+    printf ("{\"benchmark\":\"read\",\"threads\":%u,\"options\":%lu,\"lookups\":%llu,"
+            "\"sec\":%.6f,\"lookups_per_sec\":%.0f,\"per_thread\":%.0f,\"scaling\":%.2f}\n",
+            num_threads,
+            (unsigned long) num_options,
+            (unsigned long long) num_lookups,
+            time,
+            lookups_per_sec,
+            lookups_per_sec / num_threads,
+            (single_thread_rate > 0.0 ? lookups_per_sec / single_thread_rate : 0.0));
+    fflush (stdout);
+
+    delete[] states;
+    delete[] threads;
+
+    return lookups_per_sec;
+}
+
+void usage ()
+{
+    fprintf (stderr, "Usage: mconfig_read_bench [max_threads] [seconds] [num_options]\n");
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    libMaryInit ();
+
+    if (argc > 4) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    long max_threads = sysconf (_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+
+    if (argc >= 2) {
+        max_threads = strtol (argv [1], NULL, 10);
+        if (max_threads < 1) {
+            usage ();
+            return EXIT_FAILURE;
+        }
+    }
+
+    double seconds = 1.0;
+    if (argc >= 3) {
+        seconds = strtod (argv [2], NULL);
+        if (!(seconds > 0.0)) {
+            usage ();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc >= 4) {
+        num_options = strtoul (argv [3], NULL, 10);
+        if (num_options == 0) {
+            usage ();
+            return EXIT_FAILURE;
+        }
+    }
+
+    Ref<Config> const config_ref = grab (new (std::nothrow) Config (true /* use_arena */));
+    config = config_ref;
+
+    Size const max_path_len = 64;
+    char * const path_buf = new (std::nothrow) char [num_options * max_path_len];
+    paths = new (std::nothrow) ConstMemory [num_options];
+    assert (path_buf && paths);
+    for (Count i = 0; i < num_options; ++i) {
+        char * const buf = path_buf + i * max_path_len;
+        int const path_len = snprintf (buf, max_path_len, "section_%lu/option_%lu",
+                                       (unsigned long) (i % 16), (unsigned long) i);
+        paths [i] = ConstMemory (buf, (Size) path_len);
+
+        char value_buf [32];
+        int const value_len = snprintf (value_buf, sizeof (value_buf), "%lu", (unsigned long) i);
+        config->setOption (paths [i], ConstMemory (value_buf, (Size) value_len));
+    }
+
+    for (long num_threads = 1; ; num_threads *= 2) {
+        if (num_threads > max_threads)
+            num_threads = max_threads;
+
+        runThreads ((unsigned) num_threads, seconds);
+
+        if (num_threads == max_threads)
+            break;
+    }
+
+    delete[] paths;
+    delete[] path_buf;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#!/bin/sh
+
+# Generates synthetic inputs with mconfig_gen and runs mconfig_bench on each
+# of them, one process per file. Output is JSON lines, one per run.
+#
+# Usage: run_bench.sh [max_size] [work_dir]
+#
+# Sizes go from 1K up to max_size (500M by default). Inputs are kept in
+# work_dir (./bench-data by default) and reused on subsequent runs.
+# Concurrent read throughput is measured last, for 1 thread up to the number
+# of CPUs.
+
+set -e
+
+# Binaries are looked up in BENCH_BIN_DIR, next to the script by default.
+BENCH_DIR="${BENCH_BIN_DIR:-`dirname "$0"`}"
+MAX_SIZE="${1:-500M}"
+WORK_DIR="${2:-bench-data}"
+
+SIZES="1K 64K 1M 16M 128M 500M"
+SHAPES="wide deep lists quoted attrs mixed"
+
+size_bytes ()
+{
+    case "$1" in
+        *K) echo $((${1%K} * 1024)) ;;
+        *M) echo $((${1%M} * 1024 * 1024)) ;;
+        *)  echo "$1" ;;
+    esac
+}
+
+iterations ()
+{
+    bytes=`size_bytes "$1"`
+    if [ "$bytes" -le 1048576 ]; then
+        echo 100
+    elif [ "$bytes" -le 16777216 ]; then
+        echo 10
+    else
+        echo 3
+    fi
+}
+
+mkdir -p "$WORK_DIR"
+max_bytes=`size_bytes "$MAX_SIZE"`
+
+for size in $SIZES; do
+    if [ `size_bytes "$size"` -gt "$max_bytes" ]; then
+        break
+    fi
+
+    iters=`iterations "$size"`
+
+    for shape in $SHAPES; do
+        file="$WORK_DIR/$shape-$size.conf"
+        [ -f "$file" ] || "$BENCH_DIR/mconfig_gen" config "$shape" "$size" "$file"
+        "$BENCH_DIR/mconfig_bench" config "$file" "$iters"
+    done
+
+    for shape in mixed quoted; do
+        file="$WORK_DIR/$shape-$size.varlist"
+        [ -f "$file" ] || "$BENCH_DIR/mconfig_gen" varlist "$shape" "$size" "$file"
+        "$BENCH_DIR/mconfig_bench" varlist "$file" "$iters"
+    done
+
+    # Varlist lines are valid mconfig options, which is what
+    # parseVarlistSection() consumes.
+    file="$WORK_DIR/mixed-$size.varlist"
+    "$BENCH_DIR/mconfig_bench" varlist-section "$file" "$iters"
+done
+
+"$BENCH_DIR/mconfig_read_bench"
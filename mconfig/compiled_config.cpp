@@ -0,0 +1,1265 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <mconfig/util.h>
+#include <mconfig/config_parser.h>
+#include <mconfig/native_config_parser.h>
+#include <mconfig/compiled_config.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
+
+namespace CompiledConfigFormat {
+
+    Byte const magic [8] = { 'M', 'C', 'O', 'N', 'F', 'I', 'G', 'C' };
+
+    // FNV-1a over 64-bit words.
+    Uint32
+    computeChecksum (ConstMemory const mem)
+    {
+        Uint64 hash = 14695981039346656037ULL;
+
+        Size pos = 0;
+        for (; pos + 8 <= mem.len(); pos += 8) {
+            Uint64 word;
+            memcpy (&word, mem.mem() + pos, 8);
+            hash ^= word;
+            hash *= 1099511628211ULL;
+        }
+
+        for (; pos < mem.len(); ++pos) {
+            hash ^= mem.mem() [pos];
+            hash *= 1099511628211ULL;
+        }
+
+        return (Uint32) (hash ^ (hash >> 32));
+    }
+}
+
+using namespace CompiledConfigFormat;
+
+
+// _________________________________ Lookups ___________________________________
+
+Result
+CompiledValue::getAsDouble (double * const ret_val) const
+{
+    if (!(rec->decoded_types & Value::DecodedType_Double))
+        return Result::Failure;
+
+    if (ret_val)
+        *ret_val = rec->dbl;
+
+    return Result::Success;
+}
+
+Result
+CompiledValue::getAsInt64 (Int64 * const ret_val) const
+{
+    if (!(rec->decoded_types & Value::DecodedType_Int64))
+        return Result::Failure;
+
+    if (ret_val)
+        *ret_val = rec->int64;
+
+    return Result::Success;
+}
+
+Result
+CompiledValue::getAsUint64 (Uint64 * const ret_val) const
+{
+    if (!(rec->decoded_types & Value::DecodedType_Uint64))
+        return Result::Failure;
+
+    if (ret_val)
+        *ret_val = rec->uint64;
+
+    return Result::Success;
+}
+
+BooleanValue
+CompiledOption::getBoolean () const
+{
+    if (rec->num_values == 0)
+        return strToBoolean (ConstMemory());
+
+    return getValue().getAsBoolean();
+}
+
+CompiledOption
+CompiledSectionEntry::asOption () const
+{
+    if (!rec || rec->type != SectionEntry::Type_Option)
+        return CompiledOption ();
+
+    return CompiledOption (base, reinterpret_cast <OptionRecord const *> (rec));
+}
+
+CompiledSection
+CompiledSectionEntry::asSection () const
+{
+    if (!rec || rec->type != SectionEntry::Type_Section)
+        return CompiledSection ();
+
+    return CompiledSection (base, reinterpret_cast <SectionRecord const *> (rec));
+}
+
+CompiledAttribute
+CompiledSection::getAttribute (ConstMemory const attr_name) const
+{
+    AttributeRecord const * const attrs = reinterpret_cast <AttributeRecord const *> (base + rec->attrs);
+    for (Count i = 0; i < rec->num_attrs; ++i) {
+        if (equal (ConstMemory (base + attrs [i].name.offset, attrs [i].name.len), attr_name))
+            return CompiledAttribute (base, &attrs [i]);
+    }
+
+    return CompiledAttribute ();
+}
+
+CompiledSectionEntry
+CompiledSection::getSectionEntry_nopath (ConfigNameKey const &entry_name) const
+{
+    if (rec->hash_size == 0)
+        return CompiledSectionEntry ();
+
+    Uint32 const * const hash = reinterpret_cast <Uint32 const *> (base + rec->hash);
+    Uint32 const mask = rec->hash_size - 1;
+    for (Uint32 idx = entry_name.hash & mask; ; idx = (idx + 1) & mask) {
+        Uint32 const entry_offset = hash [idx];
+        if (entry_offset == 0)
+            return CompiledSectionEntry ();
+
+        EntryRecord const * const entry = reinterpret_cast <EntryRecord const *> (base + entry_offset);
+        if (entry->name_hash == entry_name.hash
+            && entry->name.len == entry_name.mem.len()
+            && memcmp (base + entry->name.offset, entry_name.mem.mem(), entry->name.len) == 0)
+        {
+            return CompiledSectionEntry (base, entry);
+        }
+    }
+}
+
+CompiledSectionEntry
+CompiledSection::getSectionEntry (ConstMemory const path_) const
+{
+    CompiledSection section = *this;
+
+    ConstMemory path = path_;
+    for (;;) {
+        while (path.len() > 0 && path.mem() [0] == '/')
+            path = path.region (1);
+
+        Byte const * const delim = (Byte const *) memchr (path.mem(), '/', path.len());
+        if (!delim)
+            return section.getSectionEntry_nopath (path);
+
+        section = section.getSectionEntry_nopath (path.region (0, delim - path.mem())).asSection();
+        if (section.isNull())
+            return CompiledSectionEntry ();
+
+        path = path.region (delim - path.mem() + 1);
+    }
+}
+
+CompiledSection
+CompiledSection::getSection (ConstMemory const path) const
+{
+    return getSectionEntry (path).asSection ();
+}
+
+ConstMemory
+CompiledConfig::getString (ConstMemory   const path,
+                           bool        * const ret_is_set) const
+{
+    CompiledOption const option = getOption (path);
+    if (option.isNull()
+        || option.getNumValues() == 0)
+    {
+        if (ret_is_set)
+            *ret_is_set = false;
+
+        return ConstMemory ();
+    }
+
+    if (ret_is_set)
+        *ret_is_set = true;
+
+    return option.getValue().mem();
+}
+
+ConstMemory
+CompiledConfig::getString_default (ConstMemory const path,
+                                   ConstMemory const default_value) const
+{
+    bool is_set;
+    ConstMemory const str = getString (path, &is_set);
+    if (is_set)
+        return str;
+
+    return default_value;
+}
+
+GetResult
+CompiledConfig::getInt64 (ConstMemory   const path,
+                          Int64       * const ret_value) const
+{
+    CompiledValue const value = getOption (path).getValue();
+    if (value.isNull() || value.mem().len() == 0)
+        return GetResult::Default;
+
+    if (!value.getAsInt64 (ret_value))
+        return GetResult::Invalid;
+
+    return GetResult::Success;
+}
+
+GetResult
+CompiledConfig::getUint64 (ConstMemory   const path,
+                           Uint64      * const ret_value) const
+{
+    CompiledValue const value = getOption (path).getValue();
+    if (value.isNull() || value.mem().len() == 0)
+        return GetResult::Default;
+
+    if (!value.getAsUint64 (ret_value))
+        return GetResult::Invalid;
+
+    return GetResult::Success;
+}
+
+GetResult
+CompiledConfig::getDouble (ConstMemory   const path,
+                           double      * const ret_value) const
+{
+    CompiledValue const value = getOption (path).getValue();
+    if (value.isNull() || value.mem().len() == 0)
+        return GetResult::Default;
+
+    if (!value.getAsDouble (ret_value))
+        return GetResult::Invalid;
+
+    return GetResult::Success;
+}
+
+BooleanValue
+CompiledConfig::getBoolean (ConstMemory const path) const
+{
+    CompiledOption const option = getOption (path);
+    if (option.isNull())
+        return Boolean_Default;
+
+    return option.getBoolean ();
+}
+
+
+// ________________________________ Compilation ________________________________
+
+namespace {
+class ImageBuilder
+{
+private:
+    Byte *buf;
+    Size  len;
+    Size  size;
+
+    // Names are stored once per image. Open addressing hash table of name
+    // strings which have been written already.
+    struct NameSlot
+    {
+        StringRef str;
+        Uint32    hash;
+        bool      used;
+    };
+
+    NameSlot *name_slots;
+    Count     num_name_slots;
+    Count     num_names;
+
+    void growNameSlots ();
+
+public:
+    // Returns the offset of @nbytes of zeroed memory aligned to 8 bytes.
+    Uint32 alloc (Size nbytes);
+
+    template <class T>
+    T* at (Uint32 const offset)
+    {
+        return reinterpret_cast <T*> (buf + offset);
+    }
+
+    StringRef addString (ConstMemory str);
+
+    StringRef addName (ConfigNameKey const &name);
+
+    Uint32 addSection (Section * mt_nonnull section);
+
+    Uint32 addOption (Option * mt_nonnull option);
+
+    Size getLength () const
+    {
+        return len;
+    }
+
+    // The caller takes ownership of the buffer.
+    Byte* releaseBuffer ()
+    {
+        Byte * const res = buf;
+        buf = NULL;
+        len = 0;
+        size = 0;
+        return res;
+    }
+
+    ImageBuilder ()
+        : buf            (NULL),
+          len            (0),
+          size           (0),
+          name_slots     (NULL),
+          num_name_slots (0),
+          num_names      (0)
+    {
+    }
+
+    ~ImageBuilder ()
+    {
+        delete[] buf;
+        delete[] name_slots;
+    }
+};
+}
+
+Uint32
+ImageBuilder::alloc (Size nbytes)
+{
+    nbytes = (nbytes + 7) & ~(Size) 7;
+
+    if (size - len < nbytes) {
+        Size new_size = (size ? size * 2 : 4096);
+        while (new_size - len < nbytes)
+            new_size *= 2;
+
+        Byte * const new_buf = new (std::nothrow) Byte [new_size];
+        assert (new_buf);
+        if (len)
+            memcpy (new_buf, buf, len);
+
+        delete[] buf;
+        buf = new_buf;
+        size = new_size;
+    }
+
+    // Offsets are 32-bit.
+    assert (len + nbytes <= (Uint32) -1);
+
+    Uint32 const offset = (Uint32) len;
+    memset (buf + len, 0, nbytes);
+    len += nbytes;
+    return offset;
+}
+
+StringRef
+ImageBuilder::addString (ConstMemory const str)
+{
+    StringRef ref;
+    ref.offset = alloc (str.len());
+    ref.len = (Uint32) str.len();
+    if (str.len())
+        memcpy (buf + ref.offset, str.mem(), str.len());
+
+    return ref;
+}
+
+void
+ImageBuilder::growNameSlots ()
+{
+    NameSlot * const old_slots = name_slots;
+    Count const old_num_slots = num_name_slots;
+
+    num_name_slots = (num_name_slots ? num_name_slots * 2 : 256);
+    name_slots = new (std::nothrow) NameSlot [num_name_slots];
+    assert (name_slots);
+    for (Count i = 0; i < num_name_slots; ++i)
+        name_slots [i].used = false;
+
+    for (Count i = 0; i < old_num_slots; ++i) {
+        if (!old_slots [i].used)
+            continue;
+
+        Count idx = old_slots [i].hash & (num_name_slots - 1);
+        while (name_slots [idx].used)
+            idx = (idx + 1) & (num_name_slots - 1);
+
+        name_slots [idx] = old_slots [i];
+    }
+
+    delete[] old_slots;
+}
+
+StringRef
+ImageBuilder::addName (ConfigNameKey const &name)
+{
+    if ((num_names + 1) * 2 > num_name_slots)
+        growNameSlots ();
+
+    Count idx = name.hash & (num_name_slots - 1);
+    while (name_slots [idx].used) {
+        NameSlot const &slot = name_slots [idx];
+        if (slot.hash == name.hash
+            && slot.str.len == name.mem.len()
+            && memcmp (buf + slot.str.offset, name.mem.mem(), slot.str.len) == 0)
+        {
+            return slot.str;
+        }
+
+        idx = (idx + 1) & (num_name_slots - 1);
+    }
+
+    StringRef const str = addString (name.mem);
+
+    name_slots [idx].str  = str;
+    name_slots [idx].hash = name.hash;
+    name_slots [idx].used = true;
+    ++num_names;
+
+    return str;
+}
+
+Uint32
+ImageBuilder::addOption (Option * const mt_nonnull option)
+{
+    Count const num_values = option->getNumValues();
+
+    StringRef const name = addName (option->getNameKey());
+
+    Uint32 const rec_offset = alloc (sizeof (OptionRecord));
+    Uint32 const values_offset = alloc (sizeof (ValueRecord) * num_values);
+    {
+        OptionRecord * const rec = at <OptionRecord> (rec_offset);
+        rec->entry.name      = name;
+        rec->entry.name_hash = option->getNameKey().hash;
+        rec->entry.type      = SectionEntry::Type_Option;
+        rec->num_values      = num_values;
+        rec->values          = values_offset;
+    }
+
+    Count idx = 0;
+    Option::iter iter (*option);
+    while (!option->iter_done (iter)) {
+        Value * const value = option->iter_next (iter);
+        ConstMemory const mem = value->mem();
+
+        StringRef const str = addString (mem);
+        ValueRecord * const rec = at <ValueRecord> (values_offset) + idx;
+        ++idx;
+
+        rec->str = str;
+
+      // Numbers are decoded here directly rather than through Value's cache,
+      // which would report every string value as an error.
+
+        if (strToInt64_safe (mem, &rec->int64))
+            rec->decoded_types |= Value::DecodedType_Int64;
+
+        if (strToUint64_safe (mem, &rec->uint64))
+            rec->decoded_types |= Value::DecodedType_Uint64;
+
+        if (strToDouble_safe (mem, &rec->dbl))
+            rec->decoded_types |= Value::DecodedType_Double;
+
+        rec->boolean = strToBoolean (mem);
+        rec->decoded_types |= Value::DecodedType_Boolean;
+    }
+
+    return rec_offset;
+}
+
+Uint32
+ImageBuilder::addSection (Section * const mt_nonnull section)
+{
+    Count num_entries = 0;
+    {
+        Section::iter iter (*section);
+        while (!section->iter_done (iter)) {
+            section->iter_next (iter);
+            ++num_entries;
+        }
+    }
+
+    Count num_attrs = 0;
+    {
+        Section::attribute_iterator iter (*section);
+        while (!iter.done()) {
+            iter.next ();
+            ++num_attrs;
+        }
+    }
+
+    Uint32 hash_size = 0;
+    if (num_entries) {
+        hash_size = 1;
+        while (hash_size < num_entries * 2)
+            hash_size *= 2;
+    }
+
+    StringRef const name = addName (section->getNameKey());
+
+    Uint32 const rec_offset     = alloc (sizeof (SectionRecord));
+    Uint32 const entries_offset = alloc (sizeof (Uint32) * num_entries);
+    Uint32 const hash_offset    = alloc (sizeof (Uint32) * hash_size);
+    Uint32 const attrs_offset   = alloc (sizeof (AttributeRecord) * num_attrs);
+    {
+        SectionRecord * const rec = at <SectionRecord> (rec_offset);
+        rec->entry.name      = name;
+        rec->entry.name_hash = section->getNameKey().hash;
+        rec->entry.type      = SectionEntry::Type_Section;
+        rec->num_entries     = num_entries;
+        rec->entries         = entries_offset;
+        rec->hash_size       = hash_size;
+        rec->hash            = hash_offset;
+        rec->num_attrs       = num_attrs;
+        rec->attrs           = attrs_offset;
+    }
+
+    {
+        Count idx = 0;
+        Section::attribute_iterator iter (*section);
+        while (!iter.done()) {
+            Attribute * const attr = iter.next ();
+
+            StringRef const attr_name  = addName (attr->getNameKey());
+            StringRef const attr_value = addString (attr->getValue());
+
+            AttributeRecord * const rec = at <AttributeRecord> (attrs_offset) + idx;
+            ++idx;
+
+            rec->name      = attr_name;
+            rec->value     = attr_value;
+            rec->name_hash = attr->getNameKey().hash;
+            rec->has_value = attr->hasValue();
+        }
+    }
+
+  // Repeated sections keep their original order, so that lookups in the image
+  // find the first of them, as in the source tree.
+    List<SectionEntry*> entries;
+    {
+        Section::iter iter (*section);
+        while (!section->iter_done (iter)) {
+            SectionEntry * const section_entry = section->iter_next (iter);
+            if (section_entry->getType() == SectionEntry::Type_Section) {
+                Section *sibling = static_cast <Section*> (section_entry);
+                if (sibling->getPrevSibling())
+                    continue;
+
+                for (; sibling; sibling = sibling->getNextSibling())
+                    entries.append (sibling);
+
+                continue;
+            }
+
+            entries.append (section_entry);
+        }
+    }
+
+    Count idx = 0;
+    for (List<SectionEntry*>::Element *el = entries.first; el; el = el->next) {
+        SectionEntry * const section_entry = el->data;
+
+        Uint32 entry_offset;
+        switch (section_entry->getType()) {
+            case SectionEntry::Type_Option:
+                entry_offset = addOption (static_cast <Option*> (section_entry));
+                break;
+            case SectionEntry::Type_Section:
+                entry_offset = addSection (static_cast <Section*> (section_entry));
+                break;
+            default:
+                unreachable ();
+        }
+
+        at <Uint32> (entries_offset) [idx] = entry_offset;
+        ++idx;
+
+      // The first of same-named entries wins, as the lookups stop there.
+        Uint32 * const hash = at <Uint32> (hash_offset);
+        Uint32 slot = section_entry->getNameKey().hash & (hash_size - 1);
+        while (hash [slot] != 0)
+            slot = (slot + 1) & (hash_size - 1);
+
+        hash [slot] = entry_offset;
+    }
+
+    return rec_offset;
+}
+
+namespace {
+struct FileMetadata
+{
+    bool   exists;
+    Uint64 size;
+    Int64  mtime_sec;
+    Uint32 mtime_nsec;
+    // Zero where not available.
+    Uint64 dev;
+    Uint64 ino;
+};
+}
+
+// Gets the metadata of @path without reading the file. Only the size is known
+// on Win32.
+static void
+getFileMetadata (ConstMemory    const path,
+                 FileMetadata * const mt_nonnull ret_md)
+{
+    ret_md->exists     = false;
+    ret_md->size       = 0;
+    ret_md->mtime_sec  = 0;
+    ret_md->mtime_nsec = 0;
+    ret_md->dev        = 0;
+    ret_md->ino        = 0;
+
+#ifndef LIBMARY_PLATFORM_WIN32
+    struct stat st;
+    if (stat ((char const *) makeString (path)->cstr(), &st) != 0)
+        return;
+
+    ret_md->exists    = true;
+    ret_md->size      = (Uint64) st.st_size;
+    ret_md->mtime_sec = (Int64) st.st_mtime;
+#ifdef __linux__
+    ret_md->mtime_nsec = (Uint32) st.st_mtim.tv_nsec;
+#endif
+    ret_md->dev       = (Uint64) st.st_dev;
+    ret_md->ino       = (Uint64) st.st_ino;
+#else
+    NativeFile file;
+    if (!file.open (path, 0 /* open_flags */, FileAccessMode::ReadOnly))
+        return;
+
+    FileStat fs;
+    if (!file.stat (&fs))
+        return;
+
+    ret_md->exists = true;
+    ret_md->size   = (Uint64) fs.size;
+#endif
+}
+
+namespace {
+// Files which the image is compiled from: the source file and the files which
+// it includes, directly or indirectly. Their metadata is gathered before the
+// files are parsed, so that a file which changes in between makes the image
+// stale rather than letting it record the new metadata.
+class DependencyList
+{
+private:
+    struct Dependency
+    {
+        Ref<String>  path;
+        bool         is_source;
+        FileMetadata md;
+    };
+
+    List<Dependency> deps;
+
+    // Includes which are nested deeper than this are not followed.
+    enum { MaxIncludeDepth = 64 };
+
+    struct IncludeDirective_Data
+    {
+        DependencyList *self;
+        ConstMemory     dir;
+        Count           depth;
+    };
+
+    static void includeDirective (ConstMemory  include_name,
+                                  void        *_data);
+
+    bool hasDependency (ConstMemory         path,
+                        FileMetadata const &md) const;
+
+    void addFile (ConstMemory path,
+                  Count       depth);
+
+public:
+    // Records the metadata of the source file. Should be called before
+    // the file is read, and before any other file is added.
+    void addSourceFile (ConstMemory source_filename);
+
+    // Records files included by @source, which is the text of
+    // @source_filename.
+    void collectIncludes (ConstMemory source_filename,
+                          ConstMemory source);
+
+    void writeToImage (ImageBuilder * mt_nonnull builder,
+                       Header       * mt_nonnull header);
+};
+}
+
+// Returns the directory part of @filename, with the trailing slash, or an empty
+// string for files in the current directory.
+static ConstMemory
+getDirectory (ConstMemory const filename)
+{
+    Size len = filename.len();
+    while (len > 0 && filename.mem() [len - 1] != '/')
+        --len;
+
+    return filename.region (0, len);
+}
+
+void
+DependencyList::includeDirective (ConstMemory   const include_name,
+                                  void        * const _data)
+{
+    IncludeDirective_Data * const data = static_cast <IncludeDirective_Data*> (_data);
+
+    if (include_name.len() > 0 && include_name.mem() [0] == '/') {
+        data->self->addFile (include_name, data->depth);
+        return;
+    }
+
+    Ref<String> const path = makeString (data->dir, include_name);
+    data->self->addFile (path->mem(), data->depth);
+}
+
+// Existing files are identified by device and inode numbers where these are
+// known, so that different paths to the same file are recognized.
+bool
+DependencyList::hasDependency (ConstMemory         const path,
+                               FileMetadata const &md) const
+{
+    bool const by_inode = md.exists && (md.dev || md.ino);
+
+    for (List<Dependency>::Element *el = deps.first; el; el = el->next) {
+        Dependency const &dep = el->data;
+        if (by_inode) {
+            if (dep.md.exists && dep.md.dev == md.dev && dep.md.ino == md.ino)
+                return true;
+        } else {
+            if (dep.md.exists == md.exists && equal (dep.path->mem(), path))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void
+DependencyList::addFile (ConstMemory const path,
+                         Count       const depth)
+{
+    FileMetadata md;
+    getFileMetadata (path, &md);
+
+  // Also breaks include cycles.
+    if (hasDependency (path, md))
+        return;
+
+    if (depth > MaxIncludeDepth) {
+        logD (mconfig, _func, "includes are nested too deep, not following ", path);
+        return;
+    }
+
+    Dependency dep;
+    dep.path      = makeString (path);
+    dep.is_source = false;
+    dep.md        = md;
+    deps.append (dep);
+
+    if (!md.exists)
+        return;
+
+  // Read only to look for nested includes, which happens at compile time.
+    MappedFile file;
+    if (!file.open (path, false /* log_open_error */))
+        return;
+
+    IncludeDirective_Data data;
+    data.self  = this;
+    data.dir   = getDirectory (path);
+    data.depth = depth + 1;
+
+    nativeConfigGetIncludes (file.getMem(), includeDirective, &data);
+}
+
+void
+DependencyList::addSourceFile (ConstMemory const source_filename)
+{
+    Dependency dep;
+    dep.path      = makeString (source_filename);
+    dep.is_source = true;
+    getFileMetadata (source_filename, &dep.md);
+
+  // The source file goes first, see Header::deps.
+    assert (deps.isEmpty());
+    deps.append (dep);
+}
+
+void
+DependencyList::collectIncludes (ConstMemory const source_filename,
+                                 ConstMemory const source)
+{
+    IncludeDirective_Data data;
+    data.self  = this;
+    data.dir   = getDirectory (source_filename);
+    data.depth = 1;
+
+    nativeConfigGetIncludes (source, includeDirective, &data);
+}
+
+void
+DependencyList::writeToImage (ImageBuilder * const mt_nonnull builder,
+                              Header       * const mt_nonnull header)
+{
+    Count num_deps = 0;
+    for (List<Dependency>::Element *el = deps.first; el; el = el->next)
+        ++num_deps;
+
+    if (num_deps == 0)
+        return;
+
+    Uint32 const deps_offset = builder->alloc (sizeof (DependencyRecord) * num_deps);
+
+    Count idx = 0;
+    for (List<Dependency>::Element *el = deps.first; el; el = el->next) {
+        Dependency &dep = el->data;
+
+        StringRef const path = builder->addString (dep.path->mem());
+
+      // The builder's buffer may have been reallocated by addString().
+        DependencyRecord * const rec = builder->at <DependencyRecord> (deps_offset) + idx;
+        rec->path       = path;
+        rec->flags      = (dep.md.exists ? DependencyFlag_Exists : 0)
+                          | (dep.is_source ? DependencyFlag_Source : 0);
+        rec->mtime_nsec = dep.md.mtime_nsec;
+        rec->size       = dep.md.size;
+        rec->mtime_sec  = dep.md.mtime_sec;
+        rec->dev        = dep.md.dev;
+        rec->ino        = dep.md.ino;
+
+        ++idx;
+    }
+
+    header->num_deps = (Uint32) num_deps;
+    header->deps     = deps_offset;
+}
+
+static Byte*
+buildImage (Config         * const mt_nonnull config,
+            ConstMemory      const source,
+            DependencyList * const deps,
+            Size           * const mt_nonnull ret_len)
+{
+    ImageBuilder builder;
+
+    Uint32 const header_offset = builder.alloc (sizeof (Header));
+    assert (header_offset == 0);
+
+    Uint32 const root_offset = builder.addSection (config->getRootSection());
+
+    Header header;
+    memset (&header, 0, sizeof (header));
+    if (deps)
+        deps->writeToImage (&builder, &header);
+
+    memcpy (header.magic, magic, sizeof (magic));
+    header.version         = Version;
+    header.byte_order      = ByteOrder;
+    header.header_len      = sizeof (Header);
+    header.root_section    = root_offset;
+    header.image_len       = builder.getLength();
+    header.source_len      = source.len();
+    header.source_checksum = computeChecksum (source);
+    *builder.at <Header> (header_offset) = header;
+
+    *ret_len = builder.getLength();
+    Byte * const buf = builder.releaseBuffer ();
+
+    reinterpret_cast <Header*> (buf)->image_checksum =
+            computeChecksum (ConstMemory (buf + sizeof (Header), *ret_len - sizeof (Header)));
+
+    return buf;
+}
+
+Byte*
+compileConfigImage (Config      * const mt_nonnull config,
+                    ConstMemory   const source,
+                    Size        * const mt_nonnull ret_len,
+                    ConstMemory   const source_filename)
+{
+    if (source_filename.len() == 0)
+        return buildImage (config, source, NULL /* deps */, ret_len);
+
+    DependencyList deps;
+    deps.addSourceFile (source_filename);
+    deps.collectIncludes (source_filename, source);
+    return buildImage (config, source, &deps, ret_len);
+}
+
+#ifndef LIBMARY_PLATFORM_WIN32
+static Result
+writeImageToFd (int         const fd,
+                ConstMemory const image,
+                ConstMemory const filename)
+{
+    Size pos = 0;
+    while (pos < image.len()) {
+        ssize_t const res = write (fd, image.mem() + pos, image.len() - pos);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            logE_ (_func, "Write error for ", filename, ": ", strerror (errno));
+            return Result::Failure;
+        }
+
+        pos += (Size) res;
+    }
+
+  // mkstemp() creates files with 0600 permissions.
+    if (fchmod (fd, 0644) != 0) {
+        logE_ (_func, "fchmod() failed for ", filename, ": ", strerror (errno));
+        return Result::Failure;
+    }
+
+    if (fsync (fd) != 0) {
+        logE_ (_func, "fsync() failed for ", filename, ": ", strerror (errno));
+        return Result::Failure;
+    }
+
+    return Result::Success;
+}
+
+// Writes to a uniquely named temporary file in the same directory first, so
+// that readers never see a partially written image, and concurrent writers
+// don't clobber each other's files.
+static Result
+writeImageFile (ConstMemory const image,
+                ConstMemory const image_filename)
+{
+    Ref<String> const tmp_filename = makeString (image_filename, ".XXXXXX");
+
+    int const fd = mkstemp ((char*) tmp_filename->cstr());
+    if (fd == -1) {
+        logE_ (_func, "Could not create a temporary file for ", image_filename, ": ", strerror (errno));
+        return Result::Failure;
+    }
+
+    if (!writeImageToFd (fd, image, tmp_filename->mem())) {
+        close (fd);
+        unlink ((char const *) tmp_filename->cstr());
+        return Result::Failure;
+    }
+
+    if (close (fd) != 0) {
+        logE_ (_func, "Could not close ", tmp_filename, ": ", strerror (errno));
+        unlink ((char const *) tmp_filename->cstr());
+        return Result::Failure;
+    }
+
+    if (rename ((char const *) tmp_filename->cstr(), (char const *) makeString (image_filename)->cstr()) != 0) {
+        logE_ (_func, "Could not rename ", tmp_filename, " to ", image_filename, ": ", strerror (errno));
+        unlink ((char const *) tmp_filename->cstr());
+        return Result::Failure;
+    }
+
+    return Result::Success;
+}
+#else
+// Writes to a temporary file first so that readers never see a partially
+// written image. Concurrent writers of the same image are not supported.
+static Result
+writeImageFile (ConstMemory const image,
+                ConstMemory const image_filename)
+{
+    Ref<String> const tmp_filename = makeString (image_filename, ".tmp");
+
+    NativeFile file;
+    if (!file.open (tmp_filename->mem(),
+                    OpenFlags::Create | OpenFlags::Truncate,
+                    FileAccessMode::WriteOnly))
+    {
+        logE_ (_func, "Could not open ", tmp_filename, ": ", exc->toString());
+        return Result::Failure;
+    }
+
+    if (!file.writeFull (image, NULL /* ret_nwritten */)) {
+        logE_ (_func, "Write error for ", tmp_filename, ": ", exc->toString());
+        file.close (false /* flush_data */);
+        return Result::Failure;
+    }
+
+    if (!file.close (true /* flush_data */)) {
+        logE_ (_func, "Could not close ", tmp_filename, ": ", exc->toString());
+        return Result::Failure;
+    }
+
+    if (rename ((char const *) tmp_filename->cstr(), (char const *) makeString (image_filename)->cstr()) != 0) {
+        logE_ (_func, "Could not rename ", tmp_filename, " to ", image_filename, ": ", strerror (errno));
+        return Result::Failure;
+    }
+
+    return Result::Success;
+}
+#endif
+
+Result
+compileConfig (Config      * const mt_nonnull config,
+               ConstMemory   const source,
+               ConstMemory   const image_filename,
+               ConstMemory   const source_filename)
+{
+    Size image_len;
+    Byte * const image = compileConfigImage (config, source, &image_len, source_filename);
+
+    Result const res = writeImageFile (ConstMemory (image, image_len), image_filename);
+
+    delete[] image;
+    return res;
+}
+
+
+// __________________________________ Loading __________________________________
+
+bool
+CompiledConfig::isValidImage (ConstMemory const image)
+{
+    if (image.len() < sizeof (Header)) {
+        logD (mconfig, _func, "image is too short");
+        return false;
+    }
+
+    Header const * const header = reinterpret_cast <Header const *> (image.mem());
+    if (memcmp (header->magic, magic, sizeof (magic)) != 0) {
+        logD (mconfig, _func, "not a compiled config image");
+        return false;
+    }
+
+    if (header->version    != Version   ||
+        header->byte_order != ByteOrder ||
+        header->header_len != sizeof (Header))
+    {
+        logD (mconfig, _func, "unsupported image version");
+        return false;
+    }
+
+    if (header->image_len != image.len()
+        || header->root_section < sizeof (Header)
+        || header->root_section + sizeof (SectionRecord) > image.len())
+    {
+        logD (mconfig, _func, "bad image length");
+        return false;
+    }
+
+    if ((Uint64) header->deps + (Uint64) header->num_deps * sizeof (DependencyRecord) > image.len()) {
+        logD (mconfig, _func, "bad dependency list");
+        return false;
+    }
+
+    DependencyRecord const * const deps =
+            reinterpret_cast <DependencyRecord const *> (image.mem() + header->deps);
+    for (Count i = 0; i < header->num_deps; ++i) {
+        if ((Uint64) deps [i].path.offset + deps [i].path.len > image.len()) {
+            logD (mconfig, _func, "bad dependency path");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+CompiledConfig::isUpToDate () const
+{
+    Header const * const header = getHeader ();
+    DependencyRecord const * const deps =
+            reinterpret_cast <DependencyRecord const *> (image.mem() + header->deps);
+
+    for (Count i = 0; i < header->num_deps; ++i) {
+        DependencyRecord const &dep = deps [i];
+        ConstMemory const path (image.mem() + dep.path.offset, dep.path.len);
+
+        FileMetadata md;
+        getFileMetadata (path, &md);
+
+        bool const existed = (dep.flags & DependencyFlag_Exists);
+        if (md.exists != existed
+            || (existed
+                && (md.size       != dep.size
+                    || md.mtime_sec  != dep.mtime_sec
+                    || md.mtime_nsec != dep.mtime_nsec
+                    || md.dev        != dep.dev
+                    || md.ino        != dep.ino)))
+        {
+            logD (mconfig, _func, "stale image: ", path, " has changed");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ConstMemory
+CompiledConfig::getSourceFilename () const
+{
+    Header const * const header = getHeader ();
+    if (header->num_deps == 0)
+        return ConstMemory();
+
+    DependencyRecord const * const dep =
+            reinterpret_cast <DependencyRecord const *> (image.mem() + header->deps);
+    if (!(dep->flags & DependencyFlag_Source))
+        return ConstMemory();
+
+    return ConstMemory (image.mem() + dep->path.offset, dep->path.len);
+}
+
+bool
+CompiledConfig::verify (ConstMemory const * const source) const
+{
+    Header const * const header = getHeader ();
+
+    if (computeChecksum (image.region (sizeof (Header))) != header->image_checksum) {
+        logD (mconfig, _func, "image checksum mismatch");
+        return false;
+    }
+
+    if (source) {
+        if (header->source_len != source->len()
+            || header->source_checksum != computeChecksum (*source))
+        {
+            logD (mconfig, _func, "image was compiled from different text");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Ref<CompiledConfig>
+CompiledConfig::createFromBuffer (Byte * const buf,
+                                  Size   const len)
+{
+    Ref<CompiledConfig> const compiled_config = grab (new (std::nothrow) CompiledConfig);
+    assert (compiled_config);
+
+    compiled_config->image_buf = buf;
+    compiled_config->image = ConstMemory (buf, len);
+
+    return compiled_config;
+}
+
+Ref<CompiledConfig>
+CompiledConfig::createFromFile (ConstMemory const image_filename)
+{
+    Ref<CompiledConfig> const compiled_config = grab (new (std::nothrow) CompiledConfig);
+    assert (compiled_config);
+
+  // Images are replaced with rename() and never truncated in place, hence it
+  // is safe to map them.
+    if (!compiled_config->mapped_file.open (image_filename, false /* log_open_error */, true /* allow_mmap */))
+        return NULL;
+
+    if (!isValidImage (compiled_config->mapped_file.getMem())) {
+        logD (mconfig, _func, "rejected ", image_filename);
+        return NULL;
+    }
+
+    compiled_config->image = compiled_config->mapped_file.getMem();
+    return compiled_config;
+}
+
+CompiledConfig::~CompiledConfig ()
+{
+    delete[] image_buf;
+}
+
+Ref<CompiledConfig>
+loadCompiledConfig (ConstMemory const image_filename,
+                    bool        const check_up_to_date)
+{
+    Ref<CompiledConfig> const compiled_config = CompiledConfig::createFromFile (image_filename);
+    if (!compiled_config)
+        return NULL;
+
+    if (check_up_to_date && !compiled_config->isUpToDate ())
+        return NULL;
+
+    return compiled_config;
+}
+
+Ref<CompiledConfig>
+loadOrCompileConfig (ConstMemory const source_filename,
+                     ConstMemory const image_filename)
+{
+    {
+        Ref<CompiledConfig> const compiled_config = loadCompiledConfig (image_filename, true /* check_up_to_date */);
+        if (compiled_config && equal (compiled_config->getSourceFilename(), source_filename))
+            return compiled_config;
+    }
+
+    logD (mconfig, _func, "compiling ", source_filename, " into ", image_filename);
+
+    DependencyList deps;
+    deps.addSourceFile (source_filename);
+
+    MappedFile source_file;
+    if (!source_file.open (source_filename))
+        return NULL;
+
+    ConstMemory const source = source_file.getMem();
+    deps.collectIncludes (source_filename, source);
+
+  // Parsing the file rather than @source lets relative includes be resolved
+  // against the directory of the source file.
+    Ref<Config> const config = grab (new (std::nothrow) Config (true /* use_arena */));
+    assert (config);
+    if (!parseConfig (source_filename, config)) {
+        logE_ (_func, "Could not parse ", source_filename);
+        return NULL;
+    }
+
+    Size image_len;
+    Byte * const image = buildImage (config, source, &deps, &image_len);
+
+    // The image is usable even if it could not be saved; errors are logged.
+    writeImageFile (ConstMemory (image, image_len), image_filename);
+
+  // The image which has just been built is used directly instead of being
+  // mapped back from the file.
+    return CompiledConfig::createFromBuffer (image, image_len);
+}
+
+}
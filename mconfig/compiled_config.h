@@ -0,0 +1,546 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__COMPILED_CONFIG__H__
+#define MCONFIG__COMPILED_CONFIG__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/mapped_file.h>
+#include <mconfig/config.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Layout of compiled config images. All offsets are relative to the beginning
+// of the image, which makes images position-independent. Numbers are stored in
+// native byte order; images with a different byte order are rejected.
+namespace CompiledConfigFormat {
+
+    enum {
+        Version   = 3,
+        ByteOrder = 0x01020304
+    };
+
+    extern Byte const magic [8];
+
+    struct Header
+    {
+        Byte   magic [8];
+        Uint32 version;
+        Uint32 byte_order;
+        Uint32 header_len;
+        // Offset of the root SectionRecord.
+        Uint32 root_section;
+        Uint64 image_len;
+        // Length and checksum of the text which the image was compiled from.
+        Uint64 source_len;
+        Uint32 source_checksum;
+        // Checksum of the image following the header. Checked by
+        // CompiledConfig::verify() only.
+        Uint32 image_checksum;
+        // DependencyRecord array: the source file, if the image was compiled
+        // from a file, followed by the files which it includes.
+        Uint32 num_deps;
+        Uint32 deps;
+    };
+
+    struct StringRef
+    {
+        Uint32 offset;
+        Uint32 len;
+    };
+
+    enum DependencyFlags {
+        DependencyFlag_Exists = 0x1,
+        // The source file itself rather than an included one.
+        DependencyFlag_Source = 0x2
+    };
+
+    // A file which the image was compiled from. Changes are detected by file
+    // metadata, without reading the file. Relative paths are relative to the
+    // current directory at compile time.
+    struct DependencyRecord
+    {
+        StringRef path;
+        // DependencyFlags. Missing includes are recorded as well, so that
+        // the image becomes stale when they appear.
+        Uint32    flags;
+        Uint32    mtime_nsec;
+        Uint64    size;
+        Int64     mtime_sec;
+        // Zero where not available.
+        Uint64    dev;
+        Uint64    ino;
+    };
+
+    // Common header of SectionRecord and OptionRecord.
+    struct EntryRecord
+    {
+        StringRef name;
+        Uint32    name_hash;
+        // SectionEntry::Type
+        Uint32    type;
+    };
+
+    struct SectionRecord
+    {
+        EntryRecord entry;
+
+        // Uint32 offsets of entry records in iteration order.
+        Uint32 num_entries;
+        Uint32 entries;
+
+        // Open addressing hash table of Uint32 entry record offsets, 0 marks
+        // empty slots. hash_size is a power of 2, or 0 for empty sections.
+        Uint32 hash_size;
+        Uint32 hash;
+
+        // AttributeRecord array.
+        Uint32 num_attrs;
+        Uint32 attrs;
+    };
+
+    struct AttributeRecord
+    {
+        StringRef name;
+        StringRef value;
+        Uint32    name_hash;
+        Uint32    has_value;
+    };
+
+    struct ValueRecord
+    {
+        StringRef str;
+        // Value::DecodedType flags for representations which are valid.
+        Uint32    decoded_types;
+        // BooleanValue
+        Uint32    boolean;
+        Int64     int64;
+        Uint64    uint64;
+        double    dbl;
+    };
+
+    struct OptionRecord
+    {
+        EntryRecord entry;
+
+        // ValueRecord array.
+        Uint32 num_values;
+        Uint32 values;
+    };
+
+    Uint32 computeChecksum (ConstMemory mem);
+}
+
+// Read-only views of a compiled image. Views are small value types which stay
+// valid as long as the CompiledConfig object is alive. Lookups work directly
+// on the image and do not allocate.
+
+class CompiledValue
+{
+private:
+    Byte const *base;
+    CompiledConfigFormat::ValueRecord const *rec;
+
+public:
+    bool isNull () const { return rec == NULL; }
+
+    ConstMemory mem () const
+    {
+        return ConstMemory (base + rec->str.offset, rec->str.len);
+    }
+
+    Result getAsDouble (double *ret_val) const;
+
+    Result getAsInt64 (Int64 *ret_val) const;
+
+    Result getAsUint64 (Uint64 *ret_val) const;
+
+    BooleanValue getAsBoolean () const
+    {
+        return (BooleanValue) rec->boolean;
+    }
+
+    CompiledValue (Byte const * const base,
+                   CompiledConfigFormat::ValueRecord const * const rec)
+        : base (base),
+          rec  (rec)
+    {
+    }
+
+    CompiledValue ()
+        : base (NULL),
+          rec  (NULL)
+    {
+    }
+};
+
+class CompiledAttribute
+{
+private:
+    Byte const *base;
+    CompiledConfigFormat::AttributeRecord const *rec;
+
+public:
+    bool isNull () const { return rec == NULL; }
+
+    ConstMemory getName () const
+    {
+        return ConstMemory (base + rec->name.offset, rec->name.len);
+    }
+
+    bool hasValue () const
+    {
+        return rec->has_value;
+    }
+
+    ConstMemory getValue () const
+    {
+        return ConstMemory (base + rec->value.offset, rec->value.len);
+    }
+
+    CompiledAttribute (Byte const * const base,
+                       CompiledConfigFormat::AttributeRecord const * const rec)
+        : base (base),
+          rec  (rec)
+    {
+    }
+
+    CompiledAttribute ()
+        : base (NULL),
+          rec  (NULL)
+    {
+    }
+};
+
+class CompiledOption;
+class CompiledSection;
+
+class CompiledSectionEntry
+{
+private:
+    Byte const *base;
+    CompiledConfigFormat::EntryRecord const *rec;
+
+public:
+    bool isNull () const { return rec == NULL; }
+
+    SectionEntry::Type getType () const
+    {
+        return (SectionEntry::Type) rec->type;
+    }
+
+    ConstMemory getName () const
+    {
+        return ConstMemory (base + rec->name.offset, rec->name.len);
+    }
+
+    // Returns a null view if the entry is not an option.
+    CompiledOption asOption () const;
+
+    // Returns a null view if the entry is not a section.
+    CompiledSection asSection () const;
+
+    CompiledSectionEntry (Byte const * const base,
+                          CompiledConfigFormat::EntryRecord const * const rec)
+        : base (base),
+          rec  (rec)
+    {
+    }
+
+    CompiledSectionEntry ()
+        : base (NULL),
+          rec  (NULL)
+    {
+    }
+};
+
+class CompiledOption
+{
+private:
+    Byte const *base;
+    CompiledConfigFormat::OptionRecord const *rec;
+
+public:
+    bool isNull () const { return rec == NULL; }
+
+    ConstMemory getName () const
+    {
+        return ConstMemory (base + rec->entry.name.offset, rec->entry.name.len);
+    }
+
+    Count getNumValues () const
+    {
+        return rec->num_values;
+    }
+
+    // Returns a null view if there's no value with index @idx, or if the
+    // option itself is a null view.
+    CompiledValue getValue (Count const idx = 0) const
+    {
+        if (!rec || idx >= rec->num_values)
+            return CompiledValue ();
+
+        return CompiledValue (base,
+                              reinterpret_cast <CompiledConfigFormat::ValueRecord const *> (base + rec->values) + idx);
+    }
+
+    // Same as Option::getBoolean().
+    BooleanValue getBoolean () const;
+
+    CompiledOption (Byte const * const base,
+                    CompiledConfigFormat::OptionRecord const * const rec)
+        : base (base),
+          rec  (rec)
+    {
+    }
+
+    CompiledOption ()
+        : base (NULL),
+          rec  (NULL)
+    {
+    }
+};
+
+class CompiledSection
+{
+private:
+    Byte const *base;
+    CompiledConfigFormat::SectionRecord const *rec;
+
+public:
+    bool isNull () const { return rec == NULL; }
+
+    ConstMemory getName () const
+    {
+        return ConstMemory (base + rec->entry.name.offset, rec->entry.name.len);
+    }
+
+    CompiledAttribute getAttribute (ConstMemory attr_name) const;
+
+    // Path semantics are the same as for Section::getSectionEntry().
+    CompiledSectionEntry getSectionEntry (ConstMemory path) const;
+
+    CompiledOption getOption (ConstMemory const path) const
+    {
+        return getSectionEntry (path).asOption ();
+    }
+
+    CompiledSection getSection (ConstMemory path) const;
+
+    CompiledSectionEntry getSectionEntry_nopath (ConfigNameKey const &entry_name) const;
+
+    CompiledSectionEntry getSectionEntry_nopath (ConstMemory const entry_name) const
+    {
+        return getSectionEntry_nopath (ConfigNameKey (entry_name));
+    }
+
+    Count getNumAttributes () const
+    {
+        return rec->num_attrs;
+    }
+
+    CompiledAttribute getAttributeAt (Count const idx) const
+    {
+        return CompiledAttribute (base,
+                                  reinterpret_cast <CompiledConfigFormat::AttributeRecord const *> (base + rec->attrs) + idx);
+    }
+
+    CompiledSection (Byte const * const base,
+                     CompiledConfigFormat::SectionRecord const * const rec)
+        : base (base),
+          rec  (rec)
+    {
+    }
+
+    CompiledSection ()
+        : base (NULL),
+          rec  (NULL)
+    {
+    }
+
+
+  // __________________________________ iter ___________________________________
+
+    // Entries are iterated in the same order as in the Config which the image
+    // was compiled from.
+    class iter
+    {
+        friend class CompiledSection;
+
+    private:
+        Count idx;
+
+    public:
+        iter (CompiledSection const & /* section */) : idx (0) {}
+        iter () : idx (0) {}
+    };
+
+    void iter_begin (iter &iter) const
+        { iter.idx = 0; }
+
+    CompiledSectionEntry iter_next (iter &iter) const
+    {
+        Uint32 const entry_offset =
+                reinterpret_cast <Uint32 const *> (base + rec->entries) [iter.idx];
+        ++iter.idx;
+        return CompiledSectionEntry (base,
+                                     reinterpret_cast <CompiledConfigFormat::EntryRecord const *> (base + entry_offset));
+    }
+
+    bool iter_done (iter &iter) const
+        { return iter.idx >= rec->num_entries; }
+
+  // ___________________________________________________________________________
+
+};
+
+// Compiled config image, either mmap'ed from a file or held in memory.
+class CompiledConfig : public Object
+{
+private:
+    MappedFile mapped_file;
+    Byte *image_buf;
+
+    mt_const ConstMemory image;
+
+    CompiledConfig ()
+        : image_buf (NULL)
+    {
+    }
+
+    CompiledConfigFormat::Header const * getHeader () const
+    {
+        return reinterpret_cast <CompiledConfigFormat::Header const *> (image.mem());
+    }
+
+public:
+    CompiledSection getRootSection () const
+    {
+        CompiledConfigFormat::Header const * const header = getHeader ();
+        return CompiledSection (image.mem(),
+                                reinterpret_cast <CompiledConfigFormat::SectionRecord const *> (image.mem() + header->root_section));
+    }
+
+    ConstMemory getImage () const
+    {
+        return image;
+    }
+
+  // Getters with the same semantics as Config's, except that bad values are
+  // not reported.
+
+    CompiledOption getOption (ConstMemory const path) const
+    {
+        return getRootSection().getOption (path);
+    }
+
+    CompiledSection getSection (ConstMemory const path) const
+    {
+        return getRootSection().getSection (path);
+    }
+
+    ConstMemory getString (ConstMemory  path,
+                           bool        *ret_is_set = NULL) const;
+
+    ConstMemory getString_default (ConstMemory path,
+                                   ConstMemory default_value) const;
+
+    GetResult getInt64 (ConstMemory  path,
+                        Int64       *ret_value) const;
+
+    GetResult getUint64 (ConstMemory  path,
+                         Uint64      *ret_value) const;
+
+    GetResult getDouble (ConstMemory  path,
+                         double      *ret_value) const;
+
+    BooleanValue getBoolean (ConstMemory path) const;
+
+    // Checks the header of @image and the bounds of its dependency table.
+    // The rest of the image is not read, so that loading a mapped image
+    // touches a few pages only.
+    static bool isValidImage (ConstMemory image);
+
+    // Returns false if any of the files which the image was compiled from has
+    // changed since then, judging by size, modification time, device and inode
+    // (only the size on Win32). Files are not read. Images compiled without
+    // a source filename have no files recorded and are never stale.
+    bool isUpToDate () const;
+
+    // Source file which the image was compiled from, or an empty string.
+    ConstMemory getSourceFilename () const;
+
+    // Full verification, which is not done on load: checks the checksum of
+    // the whole image, reading all of it, and if @source is non-NULL, checks
+    // that the image was compiled from the text in @source.
+    bool verify (ConstMemory const *source = NULL) const;
+
+    // Takes ownership of @buf, which must be allocated with new Byte[].
+    static Ref<CompiledConfig> createFromBuffer (Byte *buf,
+                                                 Size  len);
+
+    // Maps @image_filename and checks it with isValidImage().
+    static Ref<CompiledConfig> createFromFile (ConstMemory image_filename);
+
+    ~CompiledConfig ();
+};
+
+// Serializes @config into a new image. @source is the text which @config was
+// parsed from; its length and checksum are stored in the image so that stale
+// images can be detected with CompiledConfig::verify(). If @source_filename is
+// given, then the metadata of the source file and of the files which it
+// includes is recorded for CompiledConfig::isUpToDate(), with relative includes
+// resolved against the directory of the including file. This should be done
+// right after @source is read. The returned buffer is allocated with new Byte[].
+Byte* compileConfigImage (Config      * mt_nonnull config,
+                          ConstMemory  source,
+                          Size        * mt_nonnull ret_len,
+                          ConstMemory  source_filename = ConstMemory());
+
+// Writes the image for @config to @image_filename. The file is replaced
+// atomically.
+Result compileConfig (Config      * mt_nonnull config,
+                      ConstMemory  source,
+                      ConstMemory  image_filename,
+                      ConstMemory  source_filename = ConstMemory());
+
+// Loads a compiled image. Returns NULL if the image is missing, has a bad
+// header, was built by a different version of the library, or, if
+// @check_up_to_date is true, is stale (see CompiledConfig::isUpToDate()).
+// Use CompiledConfig::verify() to check the image contents.
+Ref<CompiledConfig> loadCompiledConfig (ConstMemory image_filename,
+                                        bool        check_up_to_date = true);
+
+// Loads @image_filename if it was compiled from @source_filename and is up to
+// date with it and the files which it includes. Otherwise parses
+// @source_filename and writes a fresh image.
+Ref<CompiledConfig> loadOrCompileConfig (ConstMemory source_filename,
+                                         ConstMemory image_filename);
+
+}
+
+
+#endif /* MCONFIG__COMPILED_CONFIG__H__ */
+
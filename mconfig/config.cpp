@@ -20,6 +20,7 @@
 #include <mconfig/util.h>
 
 #include <mconfig/config.h>
+#include <mconfig/config_serializer.h>
 
 
 using namespace M;
@@ -30,32 +31,63 @@ namespace {
 LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
 }
 
-Result
-Value::getAsDouble (double * const ret_val)
+int
+Value::setCacheStateBits (int const bits)
 {
-    if (!value_str)
-	return Result::Failure;
+    for (;;) {
+	int const state = cache_state.get();
+	if ((state & bits) == bits)
+	    return state;
+
+	if (cache_state.compareAndExchange (state, state | bits))
+	    return state;
+    }
+}
 
-    if (cached_type == CachedType_Double) {
-	if (bad_value)
-	    return Result::Failure;
+bool
+Value::beginCacheUpdate (DecodedType const type)
+{
+    int const busy_bit = type << CacheState_BusyShift;
+    return !(setCacheStateBits (busy_bit) & busy_bit);
+}
+
+void
+Value::endCacheUpdate (DecodedType const type)
+{
+  // The busy bit stays set: the field is written once per setValue().
+    setCacheStateBits (type << CacheState_DecodedShift);
+}
 
+Result
+Value::getAsDouble (double * const ret_val)
+{
+    int const state = cache_state.get();
+    if (state & (DecodedType_Double << CacheState_DecodedShift)) {
 	if (ret_val)
-	    *ret_val = cached_value.cached_double;
+	    *ret_val = cached_double;
 
 	return Result::Success;
     }
 
-    cached_type = CachedType_Double;
+    if (state & (DecodedType_Double << CacheState_InvalidShift))
+	return Result::Failure;
+
+    double val;
+    if (!strToDouble_safe (value_mem, &val)) {
+	int const invalid_bit = DecodedType_Double << CacheState_InvalidShift;
+	if (!(setCacheStateBits (invalid_bit) & invalid_bit))
+	    logE_ (_func, exc->toString());
 
-    if (!strToDouble_safe (value_str->mem(), &cached_value.cached_double)) {
-	logE_ (_func, exc->toString());
-	bad_value = true;
 	return Result::Failure;
     }
 
+    if (beginCacheUpdate (DecodedType_Double)) {
+	cached_double = val;
+	endCacheUpdate (DecodedType_Double);
+    }
+
     if (ret_val)
-	*ret_val = cached_value.cached_double;
+	*ret_val = val;
 
     return Result::Success;
 }
@@ -63,29 +95,33 @@ Value::getAsDouble (double * const ret_val)
 Result
 Value::getAsInt64 (Int64 * const ret_val)
 {
-    if (!value_str)
-	return Result::Failure;
-
-    if (cached_type == CachedType_Int64) {
-	if (bad_value)
-	    return Result::Failure;
-
+    int const state = cache_state.get();
+    if (state & (DecodedType_Int64 << CacheState_DecodedShift)) {
 	if (ret_val)
-	    *ret_val = cached_value.cached_int64;
+	    *ret_val = cached_int64;
 
 	return Result::Success;
     }
 
-    cached_type = CachedType_Int64;
+    if (state & (DecodedType_Int64 << CacheState_InvalidShift))
+	return Result::Failure;
+
+    Int64 val;
+    if (!strToInt64_safe (value_mem, &val)) {
+	int const invalid_bit = DecodedType_Int64 << CacheState_InvalidShift;
+	if (!(setCacheStateBits (invalid_bit) & invalid_bit))
+	    logE_ (_func, exc->toString());
 
-    if (!strToInt64_safe (value_str->mem(), &cached_value.cached_int64)) {
-	logE_ (_func, exc->toString());
-	bad_value = true;
 	return Result::Failure;
     }
 
+    if (beginCacheUpdate (DecodedType_Int64)) {
+	cached_int64 = val;
+	endCacheUpdate (DecodedType_Int64);
+    }
+
     if (ret_val)
-	*ret_val = cached_value.cached_int64;
+	*ret_val = val;
 
     return Result::Success;
 }
@@ -93,41 +129,430 @@ Value::getAsInt64 (Int64 * const ret_val)
 Result
 Value::getAsUint64 (Uint64 * const ret_val)
 {
-    if (!value_str)
-	return Result::Failure;
-
-    if (cached_type == CachedType_Uint64) {
-	if (bad_value)
-	    return Result::Failure;
-
+    int const state = cache_state.get();
+    if (state & (DecodedType_Uint64 << CacheState_DecodedShift)) {
 	if (ret_val)
-	    *ret_val = cached_value.cached_uint64;
+	    *ret_val = cached_uint64;
 
 	return Result::Success;
     }
 
-    cached_type = CachedType_Uint64;
+    if (state & (DecodedType_Uint64 << CacheState_InvalidShift))
+	return Result::Failure;
+
+    Uint64 val;
+    if (!strToUint64_safe (value_mem, &val)) {
+	int const invalid_bit = DecodedType_Uint64 << CacheState_InvalidShift;
+	if (!(setCacheStateBits (invalid_bit) & invalid_bit))
+	    logE_ (_func, exc->toString());
 
-    if (!strToUint64_safe (value_str->mem(), &cached_value.cached_uint64)) {
-	logE_ (_func, exc->toString());
-	bad_value = true;
 	return Result::Failure;
     }
 
+    if (beginCacheUpdate (DecodedType_Uint64)) {
+	cached_uint64 = val;
+	endCacheUpdate (DecodedType_Uint64);
+    }
+
     if (ret_val)
-	*ret_val = cached_value.cached_uint64;
+	*ret_val = val;
 
     return Result::Success;
 }
 
+BooleanValue
+Value::getAsBoolean ()
+{
+    if (cache_state.get() & (DecodedType_Boolean << CacheState_DecodedShift))
+	return cached_boolean;
+
+    BooleanValue const val = strToBoolean (value_mem);
+    if (val == Boolean_Invalid)
+	setCacheStateBits (DecodedType_Boolean << CacheState_InvalidShift);
+
+    if (beginCacheUpdate (DecodedType_Boolean)) {
+	cached_boolean = val;
+	endCacheUpdate (DecodedType_Boolean);
+    }
+
+    return val;
+}
+
 BooleanValue
 Option::getBoolean ()
 {
-    ConstMemory value_mem;
-    if (getValue())
-        value_mem = getValue()->mem();
+    Value * const value = getValue();
+    if (!value)
+        return strToBoolean (ConstMemory());
+
+    return value->getAsBoolean ();
+}
+
+namespace {
+
+// Plain decimal numbers, which make up most of numeric lists, are decoded
+// inline. Anything else goes through libmary's parsers, which define what
+// a valid value is. Numbers with leading zeros are left to the parsers as well,
+// so that both paths always agree.
+
+// At most 18 digits, which cannot overflow Int64.
+inline bool decodeDecimal (ConstMemory const mem,
+			   Uint64      * const ret_val)
+{
+    Size const len = mem.len();
+    Byte const * const buf = mem.mem();
+    if (len == 0 || len > 18 || (buf [0] == '0' && len > 1))
+	return false;
+
+    Uint64 val = 0;
+    for (Size i = 0; i < len; ++i) {
+	unsigned const digit = (unsigned) buf [i] - '0';
+	if (digit > 9)
+	    return false;
+
+	val = val * 10 + digit;
+    }
+
+    *ret_val = val;
+    return true;
+}
+
+struct Int64Decoder
+{
+    static bool decode (ConstMemory const mem,
+			Int64       * const ret_val)
+    {
+	Uint64 val;
+	if (mem.len() > 1 && mem.mem() [0] == '-') {
+	    if (decodeDecimal (mem.region (1), &val)) {
+		*ret_val = -(Int64) val;
+		return true;
+	    }
+	} else
+	if (decodeDecimal (mem, &val)) {
+	    *ret_val = (Int64) val;
+	    return true;
+	}
+
+	return strToInt64_safe (mem, ret_val);
+    }
+};
+
+struct Uint64Decoder
+{
+    static bool decode (ConstMemory const mem,
+			Uint64      * const ret_val)
+    {
+	if (decodeDecimal (mem, ret_val))
+	    return true;
+
+	return strToUint64_safe (mem, ret_val);
+    }
+};
+
+struct DoubleDecoder
+{
+    static bool decode (ConstMemory const mem,
+			double      * const ret_val)
+    {
+	Uint64 val;
+	if (decodeDecimal (mem, &val)) {
+	    *ret_val = (double) val;
+	    return true;
+	}
+
+	return strToDouble_safe (mem, ret_val);
+    }
+};
+
+}
+
+template <class T, class Decoder>
+Result
+Option::getArray (ArrayType   const type,
+		  T const   ** const ret_elems,
+		  Count      * const ret_num_elems,
+		  Count      * const ret_bad_index)
+{
+    ArrayCache *cache = static_cast <ArrayCache*> (array_cache.get());
+    if (!cache) {
+	ArrayCache * const new_cache = new (std::nothrow) ArrayCache;
+	assert (new_cache);
+
+	if (array_cache.compareAndExchange (NULL, new_cache)) {
+	    cache = new_cache;
+	} else {
+	    delete new_cache;
+	    cache = static_cast <ArrayCache*> (array_cache.get());
+	}
+    }
+
+    DecodedArray *array = static_cast <DecodedArray*> (cache->arrays [type].get());
+    if (!array) {
+	Byte * const buf = new (std::nothrow) Byte [DecodedArray::header_len + num_values * sizeof (T)];
+	assert (buf);
+
+	DecodedArray * const new_array = reinterpret_cast <DecodedArray*> (buf);
+	new_array->num_elems = num_values;
+	new_array->bad_index = (Count) -1;
+
+	T * const elems = reinterpret_cast <T*> (buf + DecodedArray::header_len);
+	for (Count i = 0; i < num_values; ++i) {
+	    if (!Decoder::decode (values [i].mem(), &elems [i])) {
+		new_array->num_elems = 0;
+		new_array->bad_index = i;
+		break;
+	    }
+	}
+
+	if (cache->arrays [type].compareAndExchange (NULL, new_array)) {
+	    array = new_array;
+	} else {
+	    delete[] buf;
+	    array = static_cast <DecodedArray*> (cache->arrays [type].get());
+	}
+    }
+
+    if (array->bad_index != (Count) -1) {
+	if (ret_elems)
+	    *ret_elems = NULL;
+	if (ret_num_elems)
+	    *ret_num_elems = 0;
+	if (ret_bad_index)
+	    *ret_bad_index = array->bad_index;
+
+	return Result::Failure;
+    }
+
+    if (ret_elems)
+	*ret_elems = reinterpret_cast <T const *> (reinterpret_cast <Byte const *> (array) + DecodedArray::header_len);
+    if (ret_num_elems)
+	*ret_num_elems = array->num_elems;
+
+    return Result::Success;
+}
+
+Result
+Option::getInt64Array (Int64 const ** const ret_elems,
+		       Count        * const ret_num_elems,
+		       Count        * const ret_bad_index)
+{
+    return getArray<Int64, Int64Decoder> (ArrayType_Int64, ret_elems, ret_num_elems, ret_bad_index);
+}
+
+Result
+Option::getUint64Array (Uint64 const ** const ret_elems,
+			Count         * const ret_num_elems,
+			Count         * const ret_bad_index)
+{
+    return getArray<Uint64, Uint64Decoder> (ArrayType_Uint64, ret_elems, ret_num_elems, ret_bad_index);
+}
+
+Result
+Option::getDoubleArray (double const ** const ret_elems,
+			Count         * const ret_num_elems,
+			Count         * const ret_bad_index)
+{
+    return getArray<double, DoubleDecoder> (ArrayType_Double, ret_elems, ret_num_elems, ret_bad_index);
+}
+
+void
+Option::releaseArrays ()
+{
+    ArrayCache * const cache = static_cast <ArrayCache*> (array_cache.get());
+    if (!cache)
+	return;
+
+    for (unsigned i = 0; i < ArrayType_Num; ++i)
+	delete[] static_cast <Byte*> (cache->arrays [i].get());
+
+    delete cache;
+    array_cache.set (NULL);
+}
+
+Ref<String>
+Value::getAsString ()
+{
+    String *str = static_cast <String*> (cached_string.get());
+    if (!str) {
+	String * const new_str = new (std::nothrow) String (value_mem);
+	assert (new_str);
+
+	if (cached_string.compareAndExchange (NULL, new_str)) {
+	    str = new_str;
+	} else {
+	    new_str->unref ();
+	    str = static_cast <String*> (cached_string.get());
+	}
+    }
+
+    return str;
+}
+
+void
+Value::releaseString ()
+{
+    String * const str = static_cast <String*> (cached_string.get());
+    if (str) {
+	str->unref ();
+	cached_string.set (NULL);
+    }
+}
+
+void
+Value::moveFrom (Value &value)
+{
+    releaseMem ();
+
+    value_mem = value.value_mem;
+    owns_mem  = value.owns_mem;
+
+    cached_string.set (value.cached_string.get());
+    value.cached_string.set (NULL);
+
+    cache_state.set (value.cache_state.get());
+    cached_double  = value.cached_double;
+    cached_int64   = value.cached_int64;
+    cached_uint64  = value.cached_uint64;
+    cached_boolean = value.cached_boolean;
+
+    value.value_mem = Memory();
+    value.owns_mem  = false;
+    value.resetCache ();
+}
+
+void
+Option::growValues (Count const min_values)
+{
+    Count new_max_values = max_values * 2;
+    if (new_max_values < min_values)
+	new_max_values = min_values;
+
+    Value *new_values;
+    if (arena) {
+	new_values = static_cast <Value*> (arena->alloc (sizeof (Value) * new_max_values));
+	for (Count i = 0; i < new_max_values; ++i)
+	    new (new_values + i) Value (arena);
+    } else {
+	new_values = new (std::nothrow) Value [new_max_values];
+	assert (new_values);
+    }
+
+    for (Count i = 0; i < num_values; ++i)
+	new_values [i].moveFrom (values [i]);
+
+    if (values != &inline_value) {
+	if (arena) {
+	    for (Count i = 0; i < max_values; ++i)
+		values [i].~Value ();
+	} else {
+	    delete[] values;
+	}
+    }
+
+    values = new_values;
+    max_values = new_max_values;
+}
+
+void
+Option::growStrings (Size const min_size)
+{
+    Size new_size = str_size * 2;
+    if (new_size < min_size)
+	new_size = min_size;
+
+    Byte *new_buf;
+    if (arena) {
+	new_buf = static_cast <Byte*> (arena->alloc (new_size));
+    } else {
+	new_buf = new (std::nothrow) Byte [new_size];
+	assert (new_buf);
+    }
+
+    if (str_len) {
+	memcpy (new_buf, str_buf, str_len);
+
+	for (Count i = 0; i < num_values; ++i) {
+	    Value &value = values [i];
+	    if (!value.owns_mem && value.value_mem.len())
+		value.value_mem = Memory (new_buf + (value.value_mem.mem() - str_buf), value.value_mem.len());
+	}
+    }
+
+    if (!arena)
+	delete[] str_buf;
 
-    return strToBoolean (value_mem);
+    str_buf  = new_buf;
+    str_size = new_size;
+}
+
+void
+Option::addValue (ConstMemory mem)
+{
+    releaseArrays ();
+
+    if (num_values == max_values)
+	growValues (num_values + 1);
+
+    Value * const value = &values [num_values];
+    if (mem.len()) {
+	if (str_size - str_len < mem.len()) {
+	  // @mem may be a value of this option.
+	    if (mem.mem() >= str_buf && mem.mem() < str_buf + str_len) {
+		Size const offs = mem.mem() - str_buf;
+		growStrings (str_len + mem.len());
+		mem = ConstMemory (str_buf + offs, mem.len());
+	    } else {
+		growStrings (str_len + mem.len());
+	    }
+	}
+
+	memcpy (str_buf + str_len, mem.mem(), mem.len());
+	value->value_mem = Memory (str_buf + str_len, mem.len());
+	str_len += mem.len();
+    }
+
+    ++num_values;
+}
+
+void
+Option::removeValues ()
+{
+    releaseArrays ();
+
+    if (values == &inline_value) {
+	inline_value.releaseMem ();
+	inline_value.resetCache ();
+    } else {
+	if (arena) {
+	    for (Count i = 0; i < max_values; ++i)
+		values [i].~Value ();
+	} else {
+	    delete[] values;
+	}
+
+	values = &inline_value;
+	max_values = 1;
+    }
+    num_values = 0;
+
+    if (!arena)
+	delete[] str_buf;
+
+    str_buf  = NULL;
+    str_len  = 0;
+    str_size = 0;
+}
+
+void
+Option::reserveValues (Count const num_values_,
+		       Size  const num_bytes)
+{
+    if (max_values - num_values < num_values_)
+	growValues (num_values + num_values_);
+
+    if (str_size - str_len < num_bytes)
+	growStrings (str_len + num_bytes);
 }
 
 SectionEntry*
@@ -141,8 +566,17 @@ Section::getSectionEntry (ConstMemory const path_,
 
     Byte const *delim = (Byte const *) memchr (path.mem(), '/', path.len());
     if (!delim) {
-	if (!create)
-	    return getSectionEntry_nopath (path);
+	if (!create) {
+	    SectionEntry * const section_entry = getSectionEntry_nopath (path);
+	    if (lookupStatsEnabled ()) {
+		if (section_entry)
+		    section_entry->num_lookups.inc ();
+		else
+		    num_misses.inc ();
+	    }
+
+	    return section_entry;
+	}
 
 	switch (section_entry_type) {
 	    case SectionEntry::Type_Option:
@@ -155,8 +589,12 @@ Section::getSectionEntry (ConstMemory const path_,
     }
 
     Section *section = getSection_nopath (path.region (0, delim - path.mem()), create);
-    if (!section)
+    if (!section) {
+	if (!create && lookupStatsEnabled ())
+	    num_misses.inc ();
+
 	return NULL;
+    }
 
     return section->getSectionEntry (path.region (delim - path.mem() + 1), create, section_entry_type);
 }
@@ -164,7 +602,7 @@ Section::getSectionEntry (ConstMemory const path_,
 Attribute*
 Section::getAttribute (ConstMemory const attr_name)
 {
-    return attribute_hash.lookup (attr_name);
+    return attribute_hash.lookup (ConfigNameKey (attr_name));
 }
 
 Option*
@@ -198,27 +636,75 @@ Section::getSection (ConstMemory const path,
 SectionEntry*
 Section::getSectionEntry_nopath (ConstMemory const section_entry_name)
 {
-    return section_entry_hash.lookup (section_entry_name);
+    return getSectionEntry_nopath (ConfigNameKey (section_entry_name));
+}
+
+SectionEntry*
+Section::getSectionEntry_nopath (ConfigNameKey const &section_entry_name)
+{
+    SectionEntry * const section_entry = section_entry_hash.lookup (section_entry_name);
+    if (!section_entry
+	|| section_entry->getType() != SectionEntry::Type_Section
+	|| !static_cast <Section*> (section_entry)->prev_sibling)
+    {
+	return section_entry;
+    }
+
+    SectionGroup * const group = section_group_hash.lookup (section_entry_name);
+    assert (group);
+    return group->first;
+}
+
+Count
+Section::getNumSections (ConstMemory const path_)
+{
+    ConstMemory path = path_;
+    while (path.len() > 0 && path.mem() [0] == '/')
+	path = path.region (1);
+
+    Size delim_pos = path.len();
+    while (delim_pos > 0 && path.mem() [delim_pos - 1] != '/')
+	--delim_pos;
+
+    if (delim_pos == 0)
+	return getNumSections_nopath (path);
+
+    Section * const parent = getSection (path.region (0, delim_pos - 1));
+    if (!parent)
+	return 0;
+
+    return parent->getNumSections_nopath (path.region (delim_pos));
+}
+
+Count
+Section::getNumSections_nopath (ConstMemory const section_name)
+{
+    SectionGroup * const group = section_group_hash.lookup (ConfigNameKey (section_name));
+    if (!group)
+	return 0;
+
+    return group->num_sections;
 }
 
 Option*
 Section::getOption_nopath (ConstMemory const option_name,
 			   bool        const create)
 {
-    SectionEntry * const section_entry = section_entry_hash.lookup (option_name);
+    SectionEntry * const section_entry = getSectionEntry_nopath (option_name);
     if (!section_entry ||
 	section_entry->getType() != SectionEntry::Type_Option)
     {
+	if (!create)
+	    return NULL;
+
+      // An entry of a different type is replaced. Never done on plain
+      // lookups, which must not modify the tree.
 	if (section_entry)
 	    removeSectionEntry (section_entry);
 
-	if (create) {
-	    Option * const option = new Option (option_name);
-	    addOption (option);
-	    return option;
-	}
-
-	return NULL;
+	Option * const option = createOption (option_name);
+	addOption (option);
+	return option;
     }
 
     return static_cast <Option*> (section_entry);
@@ -228,25 +714,97 @@ Section*
 Section::getSection_nopath (ConstMemory const section_name,
 			    bool        const create)
 {
-    SectionEntry * const section_entry = section_entry_hash.lookup (section_name);
+    SectionEntry * const section_entry = getSectionEntry_nopath (section_name);
     if (!section_entry ||
 	section_entry->getType() != SectionEntry::Type_Section)
     {
+	if (!create)
+	    return NULL;
+
+      // An entry of a different type is replaced. Never done on plain
+      // lookups, which must not modify the tree.
 	if (section_entry)
 	    removeSectionEntry (section_entry);
 
-	if (create) {
-	    Section * const section = new Section (section_name);
-	    addSection (section);
-	    return section;
-	}
-
-	return NULL;
+	Section * const section = createSection (section_name);
+	addSection (section);
+	return section;
     }
 
     return static_cast <Section*> (section_entry);
 }
 
+Attribute*
+Section::createAttribute (ConstMemory const attr_name,
+			  bool        const has_value,
+			  ConstMemory const attr_value)
+{
+    ConfigNameTable * const name_table = (config ? config->getNameTable() : NULL);
+
+    Attribute *attr;
+    if (name_table) {
+	ConfigNameKey const name = name_table->intern (attr_name);
+	if (arena)
+	    attr = new (arena->alloc (sizeof (Attribute))) Attribute (name, has_value, attr_value, arena);
+	else
+	    attr = new (std::nothrow) Attribute (name, has_value, attr_value);
+    } else {
+	if (arena)
+	    attr = new (arena->alloc (sizeof (Attribute))) Attribute (attr_name, has_value, attr_value, arena);
+	else
+	    attr = new (std::nothrow) Attribute (attr_name, has_value, attr_value);
+    }
+    assert (attr);
+
+    return attr;
+}
+
+Option*
+Section::createOption (ConstMemory const option_name)
+{
+    ConfigNameTable * const name_table = (config ? config->getNameTable() : NULL);
+
+    Option *option;
+    if (name_table) {
+	ConfigNameKey const name = name_table->intern (option_name);
+	if (arena)
+	    option = new (arena->alloc (sizeof (Option))) Option (name, arena);
+	else
+	    option = new (std::nothrow) Option (name);
+    } else {
+	if (arena)
+	    option = new (arena->alloc (sizeof (Option))) Option (option_name, arena);
+	else
+	    option = new (std::nothrow) Option (option_name);
+    }
+    assert (option);
+
+    return option;
+}
+
+Section*
+Section::createSection (ConstMemory const section_name)
+{
+    ConfigNameTable * const name_table = (config ? config->getNameTable() : NULL);
+
+    Section *section;
+    if (name_table) {
+	ConfigNameKey const name = name_table->intern (section_name);
+	if (arena)
+	    section = new (arena->alloc (sizeof (Section))) Section (name, arena, config);
+	else
+	    section = new (std::nothrow) Section (name, arena, config);
+    } else {
+	if (arena)
+	    section = new (arena->alloc (sizeof (Section))) Section (section_name, arena, config);
+	else
+	    section = new (std::nothrow) Section (section_name, NULL /* arena */, config);
+    }
+    assert (section);
+
+    return section;
+}
+
 void
 Section::addAttribute (Attribute * const attr)
 {
@@ -257,30 +815,316 @@ void
 Section::addOption (Option * const option)
 {
     section_entry_hash.add (option);
+    treeChanged ();
 }
 
 void
 Section::addSection (Section * const section)
 {
+    if (section->config != config)
+	section->setConfig (config);
+
     section_entry_hash.add (section);
+    linkSibling (section);
+    treeChanged ();
+}
+
+void
+Section::linkSibling (Section * const mt_nonnull section)
+{
+    SectionGroup *group = section_group_hash.lookup (section->getNameKey());
+    if (!group) {
+	if (arena)
+	    group = new (arena->alloc (sizeof (SectionGroup))) SectionGroup;
+	else
+	    group = new (std::nothrow) SectionGroup;
+	assert (group);
+
+	group->name_key = section->getNameKey();
+	group->first = NULL;
+	group->last = NULL;
+	group->num_sections = 0;
+
+	section_group_hash.add (group);
+    }
+
+    section->prev_sibling = group->last;
+    section->next_sibling = NULL;
+    if (group->last)
+	group->last->next_sibling = section;
+    else
+	group->first = section;
+
+    group->last = section;
+    ++group->num_sections;
+}
+
+void
+Section::unlinkSibling (Section * const mt_nonnull section)
+{
+    SectionGroup * const group = section_group_hash.lookup (section->getNameKey());
+    assert (group);
+
+    if (section->prev_sibling)
+	section->prev_sibling->next_sibling = section->next_sibling;
+    else
+	group->first = section->next_sibling;
+
+    if (section->next_sibling)
+	section->next_sibling->prev_sibling = section->prev_sibling;
+    else
+	group->last = section->prev_sibling;
+
+    section->prev_sibling = NULL;
+    section->next_sibling = NULL;
+
+    --group->num_sections;
+    if (group->num_sections == 0) {
+	section_group_hash.remove (group);
+	if (!arena)
+	    delete group;
+    } else {
+      // The key may refer to the name of the section being removed.
+	group->name_key = group->first->getNameKey();
+    }
+}
+
+void
+Section::setConfig (Config * const config)
+{
+    this->config = config;
+
+    SectionEntryHash::iter iter (section_entry_hash);
+    while (!section_entry_hash.iter_done (iter)) {
+	SectionEntry * const section_entry = section_entry_hash.iter_next (iter);
+	if (section_entry->getType() == SectionEntry::Type_Section)
+	    static_cast <Section*> (section_entry)->setConfig (config);
+    }
+}
+
+void
+Section::treeChanged ()
+{
+    if (config)
+	++config->generation;
+}
+
+// Memory of entries allocated from an arena is left to the arena, but their
+// destructors still have to run: sections release their hash tables, options
+// release decoded arrays, which are allocated on the heap because concurrent
+// readers cannot allocate from the arena.
+static void
+deleteSectionEntry (SectionEntry * const section_entry)
+{
+    if (!section_entry->getArena()) {
+	delete section_entry;
+	return;
+    }
+
+    if (section_entry->getType() == SectionEntry::Type_Section)
+	static_cast <Section*> (section_entry)->~Section ();
+    else
+	static_cast <Option*> (section_entry)->~Option ();
 }
 
 void
 Section::removeSectionEntry (SectionEntry * const section_entry)
 {
+    if (section_entry->getType() == SectionEntry::Type_Section)
+	unlinkSibling (static_cast <Section*> (section_entry));
+
     section_entry_hash.remove (section_entry);
-    delete section_entry;
+    deleteSectionEntry (section_entry);
+    treeChanged ();
+}
+
+void
+Section::detachSectionEntry (SectionEntry * const section_entry)
+{
+    if (section_entry->getType() == SectionEntry::Type_Section)
+	unlinkSibling (static_cast <Section*> (section_entry));
+
+    section_entry_hash.remove (section_entry);
+    treeChanged ();
 }
 
 Section::~Section ()
 {
+    {
+	SectionEntryHash::iter iter (section_entry_hash);
+	while (!section_entry_hash.iter_done (iter)) {
+	    SectionEntry * const section_entry = section_entry_hash.iter_next (iter);
+	    deleteSectionEntry (section_entry);
+	}
+    }
+
+    {
+	AttributeHash::iter iter (attribute_hash);
+	while (!attribute_hash.iter_done (iter)) {
+	    Attribute * const attr = attribute_hash.iter_next (iter);
+	    if (!attr->getArena())
+		delete attr;
+	}
+    }
+
+    if (!arena) {
+	SectionGroupHash::iter iter (section_group_hash);
+	while (!section_group_hash.iter_done (iter))
+	    delete section_group_hash.iter_next (iter);
+    }
+}
+
+// Owned strings are separate heap allocations unless the node lives in an arena.
+static void
+addStringMemoryStats (ConfigMemoryStats * const mt_nonnull stats,
+		      ConfigArena       * const arena,
+		      ConstMemory         const mem)
+{
+    stats->string_bytes += mem.len();
+    if (!arena && mem.len())
+	++stats->num_allocs;
+}
+
+void
+Section::getMemoryStats (ConfigMemoryStats          * const mt_nonnull stats,
+			 SectionMemoryStatsCallback   const subsection_cb,
+			 void                       * const cb_data)
+{
+    ++stats->num_sections;
+    stats->node_bytes += sizeof (Section);
+    if (!arena)
+	++stats->num_allocs;
+
+    if (!name_interned)
+	addStringMemoryStats (stats, arena, getName());
+
+    stats->num_hashes += 3;
+
+    {
+	SectionGroupHash::iter iter (section_group_hash);
+	while (!section_group_hash.iter_done (iter)) {
+	    section_group_hash.iter_next (iter);
+
+	    stats->node_bytes += sizeof (SectionGroup);
+	    stats->hash_bytes += sizeof (void*);
+	    if (!arena)
+		++stats->num_allocs;
+	}
+    }
+
+    {
+	AttributeHash::iter iter (attribute_hash);
+	while (!attribute_hash.iter_done (iter)) {
+	    Attribute * const attr = attribute_hash.iter_next (iter);
+
+	    ++stats->num_attributes;
+	    stats->node_bytes += sizeof (Attribute);
+	    stats->hash_bytes += sizeof (void*);
+	    if (!attr->arena)
+		++stats->num_allocs;
+
+	    if (!attr->name_interned)
+		addStringMemoryStats (stats, attr->arena, attr->getName());
+
+	    addStringMemoryStats (stats, attr->arena, attr->getValue());
+	}
+    }
+
+    {
+	SectionEntryHash::iter iter (section_entry_hash);
+	while (!section_entry_hash.iter_done (iter)) {
+	    SectionEntry * const section_entry = section_entry_hash.iter_next (iter);
+	    stats->hash_bytes += sizeof (void*);
+
+	    if (section_entry->getType() == SectionEntry::Type_Section) {
+		Section * const section = static_cast <Section*> (section_entry);
+		if (subsection_cb) {
+		    ConfigMemoryStats section_stats;
+		    section->getMemoryStats (&section_stats);
+		    subsection_cb (section, &section_stats, cb_data);
+		    stats->add (section_stats);
+		} else {
+		    section->getMemoryStats (stats);
+		}
+
+		continue;
+	    }
+
+	    Option * const option = static_cast <Option*> (section_entry);
+
+	    ++stats->num_options;
+	    stats->node_bytes += sizeof (Option);
+	    if (!option->arena)
+		++stats->num_allocs;
+
+	    if (!option->name_interned)
+		addStringMemoryStats (stats, option->arena, option->getName());
+
+	    stats->num_values += option->num_values;
+	  // The inline value is a part of the Option.
+	    if (option->values != &option->inline_value) {
+		stats->node_bytes += sizeof (Value) * option->max_values;
+		if (!option->arena)
+		    ++stats->num_allocs;
+	    }
+
+	    stats->string_bytes += option->str_size;
+	    if (!option->arena && option->str_size)
+		++stats->num_allocs;
+
+	    for (Count i = 0; i < option->num_values; ++i) {
+		Value * const value = &option->values [i];
+		if (value->owns_mem)
+		    addStringMemoryStats (stats, option->arena, value->mem());
+	    }
+	}
+    }
+}
+
+void
+Config::getMemoryStats (ConfigMemoryStats          * const mt_nonnull ret_stats,
+			SectionMemoryStatsCallback   const cb,
+			void                       * const cb_data)
+{
+    ret_stats->reset ();
+
+    root_section.getMemoryStats (ret_stats, cb, cb_data);
+  // The root section is a member of the Config rather than a separate
+  // allocation.
+    if (!usesArena ())
+	--ret_stats->num_allocs;
+
+    arena.getMemoryStats (ret_stats);
+    if (name_table)
+	name_table->getMemoryStats (ret_stats);
+}
+
+void
+Section::resetLookupStats ()
+{
+    num_lookups.reset ();
+    num_misses.reset ();
+
     SectionEntryHash::iter iter (section_entry_hash);
     while (!section_entry_hash.iter_done (iter)) {
 	SectionEntry * const section_entry = section_entry_hash.iter_next (iter);
-	delete section_entry;
+	if (section_entry->getType() == SectionEntry::Type_Section) {
+	    static_cast <Section*> (section_entry)->resetLookupStats ();
+	} else {
+	    Option * const option = static_cast <Option*> (section_entry);
+	    option->num_lookups.reset ();
+	    option->num_bad_values.reset ();
+	}
     }
 }
 
+Uint32
+Config::newConfigId ()
+{
+    static AtomicInt config_id_counter;
+    return (Uint32) config_id_counter.fetchAdd (1);
+}
+
 Option*
 Config::setOption (ConstMemory const path,
 		   ConstMemory const value)
@@ -324,16 +1168,59 @@ Config::getString_default (ConstMemory const path,
 }
 
 GetResult
-Config::getUint64 (ConstMemory   const path,
-		   Uint64      * const ret_value)
+Config::getOptionInt64 (Option      * const option,
+			ConstMemory   const path,
+			Int64       * const ret_value)
+{
+    Value * const value = (option ? option->getValue() : NULL);
+    if (!value || value->mem().len() == 0)
+	return GetResult::Default;
+
+    if (!value->getAsInt64 (ret_value)) {
+	if (value->reportInvalid (Value::DecodedType_Int64))
+	    logE_ (_func, "Bad value \"", value->mem(), "\" for option \"", path, "\" (integer expected)");
+
+	option->num_bad_values.inc ();
+	return GetResult::Invalid;
+    }
+
+    return GetResult::Success;
+}
+
+GetResult
+Config::getOptionUint64 (Option      * const option,
+			 ConstMemory   const path,
+			 Uint64      * const ret_value)
+{
+    Value * const value = (option ? option->getValue() : NULL);
+    if (!value || value->mem().len() == 0)
+	return GetResult::Default;
+
+    if (!value->getAsUint64 (ret_value)) {
+	if (value->reportInvalid (Value::DecodedType_Uint64))
+	    logE_ (_func, "Bad value \"", value->mem(), "\" for option \"", path, "\" (unsigned integer expected)");
+
+	option->num_bad_values.inc ();
+	return GetResult::Invalid;
+    }
+
+    return GetResult::Success;
+}
+
+GetResult
+Config::getOptionDouble (Option      * const option,
+			 ConstMemory   const path,
+			 double      * const ret_value)
 {
-    ConstMemory const value_mem = getString (path);
-    if (value_mem.len() == 0)
+    Value * const value = (option ? option->getValue() : NULL);
+    if (!value || value->mem().len() == 0)
 	return GetResult::Default;
 
-    Result const res = strToUint64_safe (value_mem, ret_value);
-    if (!res) {
-	logE_ (_func, "Bad value \"", value_mem, "\" for option \"", path, "\" (unsigned integer expected): ", exc->toString());
+    if (!value->getAsDouble (ret_value)) {
+	if (value->reportInvalid (Value::DecodedType_Double))
+	    logE_ (_func, "Bad value \"", value->mem(), "\" for option \"", path, "\" (number expected)");
+
+	option->num_bad_values.inc ();
 	return GetResult::Invalid;
     }
 
@@ -341,101 +1228,65 @@ Config::getUint64 (ConstMemory   const path,
 }
 
 BooleanValue
-Config::getBoolean (ConstMemory const path)
+Config::getOptionBoolean (Option      * const option,
+			  ConstMemory   const path)
 {
-    Option * const option = getOption (path, false /* create */);
     if (!option)
 	return Boolean_Default;
 
-    return option->getBoolean ();
+    Value * const value = option->getValue();
+    if (!value)
+	return option->getBoolean ();
+
+    BooleanValue const res = value->getAsBoolean ();
+    if (res == Boolean_Invalid) {
+	option->num_bad_values.inc ();
+	if (value->reportInvalid (Value::DecodedType_Boolean))
+	    logE_ (_func, "Bad value \"", value->mem(), "\" for option \"", path, "\" (boolean expected)");
+    }
+
+    return res;
 }
 
 
 // ________________________________ Dump methods _______________________________
 
-static void
-dumpTab (OutputStream * const outs,
-	 unsigned       const nest_level)
-{
-    for (unsigned i = 0; i < nest_level; ++i)
-	outs->print ("    ");
-}
+// Dumps are rendered into a single buffer and written out at once.
 
 void
 Option::dump (OutputStream * const outs,
 	      unsigned       const nest_level)
 {
-    Option * const option = this;
-
-    dumpTab (outs, nest_level);
-    outs->print (option->getName (), " = ");
-
-    Option::iter iter (*option);
-    while (!option->iter_done (iter)) {
-	Value * const value = option->iter_next (iter);
-	outs->print ("\"", value->getAsString(), "\"");
-	if (!option->iter_done (iter))
-	    outs->print (", ");
-    }
-
-    outs->print (";");
+    ConfigSerializer serializer;
+    serializer.addOption (this, nest_level);
+    serializer.write (outs);
 }
 
 void
 Section::dump (OutputStream * const outs,
 	       unsigned       const nest_level)
 {
-    Section * const section = this;
-
-    dumpTab (outs, nest_level);
-    if (section->getName().len())
-        outs->print (section->getName(), " {\n");
-    else
-        outs->print ("{\n");
-
-    dumpBody (outs, nest_level + 1);
-
-    dumpTab (outs, nest_level);
-    outs->print ("}\n");
+    ConfigSerializer serializer;
+    serializer.addSection (this, nest_level);
+    serializer.write (outs);
 }
 
 void
 Section::dumpBody (OutputStream * const outs,
 		   unsigned       const nest_level)
 {
-    Section * const section = this;
-
-    Section::iter iter (*section);
-    bool first_entry = true;
-    while (!section->iter_done (iter)) {
-	SectionEntry * const section_entry = section->iter_next (iter);
-	switch (section_entry->type) {
-	    case SectionEntry::Type_Option: {
-		Option * const option = static_cast <Option*> (section_entry);
-		option->dump (outs, nest_level);
-		outs->print ("\n");
-	    } break;
-	    case SectionEntry::Type_Section: {
-		Section * const subsection = static_cast <Section*> (section_entry);
-
-		if (!first_entry)
-		    outs->print ("\n");
-
-		subsection->dump (outs, nest_level);
-	    } break;
-	    default:
-		unreachable ();
-	}
-
-	first_entry = false;
-    }
+    ConfigSerializer serializer;
+    serializer.addSectionBody (this, nest_level);
+    serializer.write (outs);
 }
 
 void
 Config::dump (OutputStream * const outs,
 	      unsigned       const nest_level)
 {
-    root_section.dumpBody (outs, nest_level);
+    ConfigSerializer serializer;
+    serializer.addConfig (this, nest_level);
+    serializer.write (outs);
     outs->flush ();
 }
 
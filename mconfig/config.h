@@ -22,12 +22,19 @@
 
 
 #include <libmary/libmary.h>
+#include <new>
+
+#include <mconfig/config_arena.h>
+#include <mconfig/config_name_table.h>
+#include <mconfig/config_memory_stats.h>
 
 
 namespace MConfig {
 
 using namespace M;
 
+class Config;
+
 enum BooleanValue {
     Boolean_Invalid,
     Boolean_Default,
@@ -35,53 +42,116 @@ enum BooleanValue {
     Boolean_False
 };
 
+// Lookup statistics counter. Saturates at Max instead of wrapping around, so
+// that busy entries don't drop to the bottom of the rankings. inc() is a load
+// and an atomic increment; Max leaves headroom below INT_MAX for concurrent
+// increments which get past the check at the same time.
+class StatCounter
+{
+private:
+    AtomicInt value;
+
+public:
+    enum { Max = 0x7fff0000 };
+
+    void inc ()
+    {
+	if (value.get() < Max)
+	    value.inc ();
+    }
+
+    Uint32 get () const
+    {
+	int const res = value.get();
+	return (Uint32) (res < Max ? res : Max);
+    }
+
+    void reset ()
+    {
+	value.set (0);
+    }
+};
+
 class Attribute : public HashEntry<>
 {
     friend class Section;
     friend class Config;
 
 private:
-    Ref<String> name_str;
-    Ref<String> value_str;
+    // NULL if the attribute is allocated on the heap.
+    ConfigArena * const arena;
+
+    ConfigNameKey name_key;
+    // True if name_key refers to a ConfigNameTable.
+    bool name_interned;
+
+    Memory value_mem;
+    bool has_value;
 
 public:
     bool hasValue () const
     {
-        return value_str != NULL;
+        return has_value;
     }
 
     ConstMemory getName () const
     {
-        if (!name_str)
-            return ConstMemory();
+        return name_key.mem;
+    }
 
-        return name_str->mem();
+    ConfigNameKey const & getNameKey () const
+    {
+        return name_key;
     }
 
     ConstMemory getValue () const
     {
-        if (!value_str)
-            return ConstMemory();
+        return value_mem;
+    }
 
-        return value_str->mem();
+    ConfigArena* getArena () const
+    {
+        return arena;
     }
 
     void setValue (bool        const has_value,
                    ConstMemory const value)
     {
-        if (has_value)
-            value_str = grab (new String (value));
-        else
-            value_str = NULL;
+        ConfigArena::freeMem (arena, value_mem);
+        value_mem = (has_value ? ConfigArena::copyMem (arena, value) : Memory());
+        this->has_value = has_value;
+    }
+
+    Attribute (ConstMemory   const name,
+               bool          const has_value,
+               ConstMemory   const value,
+               ConfigArena * const arena = NULL)
+        : arena         (arena),
+          name_key      (ConfigArena::copyMem (arena, name)),
+          name_interned (false),
+          value_mem     (has_value ? ConfigArena::copyMem (arena, value) : Memory()),
+          has_value     (has_value)
+    {
+    }
+
+    // @interned_name must be returned by ConfigNameTable::intern().
+    Attribute (ConfigNameKey const &interned_name,
+               bool                 const has_value,
+               ConstMemory          const value,
+               ConfigArena        * const arena = NULL)
+        : arena         (arena),
+          name_key      (interned_name),
+          name_interned (true),
+          value_mem     (has_value ? ConfigArena::copyMem (arena, value) : Memory()),
+          has_value     (has_value)
+    {
     }
 
-    Attribute (ConstMemory const name,
-               bool        const has_value,
-               ConstMemory const value)
-        : name_str  (grab (new String (name)))
+    ~Attribute ()
     {
-        if (has_value)
-            value_str = grab (new String (value));
+        if (!name_interned)
+            ConfigArena::freeMem (arena, name_key.mem);
+        ConfigArena::freeMem (arena, value_mem);
     }
 };
 
@@ -89,6 +159,7 @@ class SectionEntry : public HashEntry<>
 {
     friend class Section;
     friend class Config;
+    friend class ConfigPath;
 
 public:
     enum Type
@@ -99,104 +170,309 @@ public:
     };
 
 private:
-    Ref<String> name_str;
+    ConfigNameKey name_key;
+    // True if name_key refers to a ConfigNameTable.
+    bool name_interned;
+
     Type const type;
 
+protected:
+    // NULL if the entry is allocated on the heap.
+    ConfigArena * const arena;
+
+    // Number of path lookups which resolved to the entry. Maintained only
+    // while lookup stats are enabled for the Config.
+    StatCounter num_lookups;
+
 public:
     Type        getType () const { return type; }
-    ConstMemory getName () const { return name_str->mem(); }
 
-    SectionEntry (Type        const type,
-		  ConstMemory const entry_name)
-	: type (type)
+    Uint32 getNumLookups () const { return num_lookups.get(); }
+    ConstMemory getName () const { return name_key.mem; }
+
+    ConfigNameKey const & getNameKey () const { return name_key; }
+
+    ConfigArena* getArena () const { return arena; }
+
+    SectionEntry (Type          const type,
+		  ConstMemory   const entry_name,
+		  ConfigArena * const arena = NULL)
+	: name_key      (ConfigArena::copyMem (arena, entry_name)),
+	  name_interned (false),
+	  type          (type),
+	  arena         (arena)
     {
-	name_str = grab (new String (entry_name));
     }
 
-    virtual ~SectionEntry () {}
+    // @interned_name must be returned by ConfigNameTable::intern().
+    SectionEntry (Type                  const type,
+		  ConfigNameKey const &interned_name,
+		  ConfigArena         * const arena = NULL)
+	: name_key      (interned_name),
+	  name_interned (true),
+	  type          (type),
+	  arena         (arena)
+    {
+    }
+
+    virtual ~SectionEntry ()
+    {
+	if (!name_interned)
+	    ConfigArena::freeMem (arena, name_key.mem);
+    }
 };
 
-class Value : public IntrusiveListElement<>
+class Value
 {
+    friend class Option;
+    friend class Section;
+
 private:
-    Ref<String> value_str;
+    // NULL if the value is allocated on the heap.
+    ConfigArena *arena;
+
+    // Points into the string buffer of the option which holds the value,
+    // or to a separate copy owned by the value after setValue().
+    Memory value_mem;
+    bool   owns_mem;
 
-    enum CachedType {
-	CachedType_None,
-	CachedType_Double,
-	CachedType_Int64,
-	CachedType_Uint64
+public:
+    // Bit flags for decoded representations of the value.
+    enum DecodedType {
+	DecodedType_Double  = 0x1,
+	DecodedType_Int64   = 0x2,
+	DecodedType_Uint64  = 0x4,
+	DecodedType_Boolean = 0x8
     };
 
-    CachedType cached_type;
-    bool bad_value;
+private:
+    // All representations decoded so far are cached at the same time.
+    // Values which fail to decode are remembered as well, so that they're
+    // not parsed again on every lookup.
+    //
+    // The cache is filled lazily by concurrent readers without locking.
+    // cache_state holds four groups of DecodedType bits: decoded, invalid,
+    // reported and busy. A reader which has decoded a value claims the busy
+    // bit, stores the cached_* field and only then sets the decoded bit, so
+    // cached_* fields are never read while being written. Readers which lose
+    // the race for the busy bit return their own decoded copy.
+    enum {
+	CacheState_DecodedShift  = 0,
+	CacheState_InvalidShift  = 4,
+	CacheState_ReportedShift = 8,
+	CacheState_BusyShift     = 12
+    };
+
+    AtomicInt cache_state;
+
+    double       cached_double;
+    Int64        cached_int64;
+    Uint64       cached_uint64;
+    BooleanValue cached_boolean;
+
+    // String copy of the value for getAsString(), created on first use and
+    // published with compareAndExchange(). Holds a reference.
+    AtomicPointer cached_string;
+
+    void releaseString ();
+
+    // Sets @bits in cache_state. Returns the previous state.
+    int setCacheStateBits (int bits);
 
-    union {
-	double cached_double;
-	Int64  cached_int64;
-	Uint64 cached_uint64;
-    } cached_value;
+    // Returns true if the caller may store the cached field for @type.
+    bool beginCacheUpdate (DecodedType type);
+
+    void endCacheUpdate (DecodedType type);
+
+    void resetCache ()
+    {
+	cache_state.set (0);
+    }
+
+    void releaseMem ()
+    {
+	if (owns_mem) {
+	    ConfigArena::freeMem (arena, value_mem);
+	    owns_mem = false;
+	}
+
+	value_mem = Memory();
+	releaseString ();
+    }
+
+    // Takes over the string and the cache of @value, which is left empty.
+    void moveFrom (Value &value);
 
 public:
+    // Not thread-safe, the value must not be read concurrently.
     void setValue (ConstMemory const mem)
     {
-	value_str = grab (new String (mem));
+	Memory const new_mem = ConfigArena::copyMem (arena, mem);
+	releaseMem ();
+	value_mem = new_mem;
+	owns_mem = true;
+	resetCache ();
     }
 
+    // getAs*() methods are thread-safe and lock-free.
+
     Result getAsDouble (double *ret_val);
 
     Result getAsInt64 (Int64 *ret_val);
 
     Result getAsUint64 (Uint64 *ret_val);
 
-    Ref<String> getAsString ()
+    // Same as strToBoolean (mem()).
+    BooleanValue getAsBoolean ();
+
+    // Returns true if the value has failed to decode as @type.
+    bool isInvalid (DecodedType const type) const
     {
-	return value_str;
+	return cache_state.get() & (type << CacheState_InvalidShift);
     }
 
+    // Returns true the first time it is called for @type after the value has
+    // failed to decode as @type. Allows to report bad values once rather than
+    // on every lookup. Thread-safe: only one caller gets true.
+    bool reportInvalid (DecodedType const type)
+    {
+	if (!isInvalid (type))
+	    return false;
+
+	int const reported_bit = type << CacheState_ReportedShift;
+	return !(setCacheStateBits (reported_bit) & reported_bit);
+    }
+
+    // Returns the value as a String, which is allocated on the first call
+    // only and shared by subsequent calls. Prefer mem(), which never
+    // allocates. Thread-safe.
+    Ref<String> getAsString ();
+
     ConstMemory mem ()
     {
-	return value_str->mem();
+	return value_mem;
     }
 
-    Value ()
-	: cached_type (CachedType_None),
-	  bad_value (false)
+    Value (ConfigArena * const arena = NULL)
+	: arena    (arena),
+	  owns_mem (false)
     {
+	resetCache ();
+    }
+
+    ~Value ()
+    {
+	releaseMem ();
     }
 };
 
 class Option : public SectionEntry
 {
+    friend class Section;
+    friend class Config;
+
 private:
-    typedef IntrusiveList<Value> ValueList;
+    // Values are kept in one array. Options with a single value, which are
+    // the common case, use inline_value and need no separate allocation.
+    // Strings of all values are stored back to back in str_buf. Both grow
+    // geometrically; reserveValues() allows to allocate them once.
+    Value  inline_value;
+    Value *values;
+    Count  num_values;
+    Count  max_values;
+
+    Byte *str_buf;
+    Size  str_len;
+    Size  str_size;
+
+    void growValues (Count min_values);
+
+    void growStrings (Size min_size);
+
+    // Number of times the value has failed to convert in Config's typed
+    // getters. Counted whether or not lookup stats are enabled.
+    StatCounter num_bad_values;
+
+    enum ArrayType {
+	ArrayType_Int64,
+	ArrayType_Uint64,
+	ArrayType_Double,
+	ArrayType_Num
+    };
+
+    // All values decoded as one type. Elements follow the header.
+    struct DecodedArray
+    {
+	Count num_elems;
+	// Index of the first value which failed to decode, or (Count) -1.
+	Count bad_index;
+
+	static Size const header_len = (sizeof (Count) * 2 + 7) & ~(Size) 7;
+    };
+
+    // Decoded arrays are published lock-free, like Value caches: the first
+    // reader to finish decoding wins, others free their copies.
+    struct ArrayCache
+    {
+	AtomicPointer arrays [ArrayType_Num];
+    };
+
+    // Allocated on first use of get*Array(), NULL until then.
+    AtomicPointer array_cache;
+
+    template <class T, class Decoder>
+    Result getArray (ArrayType   type,
+		     T const   **ret_elems,
+		     Count      *ret_num_elems,
+		     Count      *ret_bad_index);
 
-    ValueList value_list;
+    void releaseArrays ();
 
 public:
-    void addValue (ConstMemory const mem)
+    Uint32 getNumBadValues () const
     {
-	Value * const value = new Value;
-	value->setValue (mem);
-	value_list.append (value);
+	return num_bad_values.get();
     }
 
-    void removeValues ()
-    {
-	{
-	    ValueList::iter iter (value_list);
-	    while (!value_list.iter_done (iter)) {
-		Value * const value = value_list.iter_next (iter);
-		delete value;
-	    }
-	}
+    // Decode all values of the option into a contiguous array. The array is
+    // decoded once and is valid until values are added or removed; changes
+    // made directly with Value::setValue() are not tracked. An option without
+    // values gives an empty array. If a value fails to decode, Failure is
+    // returned and *ret_bad_index is set to its position.
+    //
+    // Thread-safe and lock-free, like Value::getAs*().
+
+    Result getInt64Array (Int64 const **ret_elems,
+			  Count        *ret_num_elems,
+			  Count        *ret_bad_index = NULL);
+
+    Result getUint64Array (Uint64 const **ret_elems,
+			   Count         *ret_num_elems,
+			   Count         *ret_bad_index = NULL);
+
+    Result getDoubleArray (double const **ret_elems,
+			   Count         *ret_num_elems,
+			   Count         *ret_bad_index = NULL);
+
+    // Adding values invalidates Value pointers previously obtained from
+    // the option.
+    void addValue (ConstMemory mem);
+
+    void removeValues ();
+
+    // Preallocates room for @num_values more values with @num_bytes of
+    // string data in total.
+    void reserveValues (Count num_values,
+			Size  num_bytes);
 
-	value_list.clear ();
+    Count getNumValues () const
+    {
+	return num_values;
     }
 
     Value* getValue ()
     {
-	return value_list.getFirst();
+	return num_values ? &values [0] : NULL;
     }
 
     BooleanValue getBoolean ();
@@ -204,8 +480,29 @@ public:
     void dump (OutputStream *outs,
 	       unsigned      nest_level);
 
-    Option (ConstMemory const option_name)
-	: SectionEntry (SectionEntry::Type_Option, option_name)
+    Option (ConstMemory   const option_name,
+	    ConfigArena * const arena = NULL)
+	: SectionEntry (SectionEntry::Type_Option, option_name, arena),
+	  inline_value (arena),
+	  values       (&inline_value),
+	  num_values   (0),
+	  max_values   (1),
+	  str_buf      (NULL),
+	  str_len      (0),
+	  str_size     (0)
+    {
+    }
+
+    Option (ConfigNameKey const &interned_name,
+	    ConfigArena         * const arena = NULL)
+	: SectionEntry (SectionEntry::Type_Option, interned_name, arena),
+	  inline_value (arena),
+	  values       (&inline_value),
+	  num_values   (0),
+	  max_values   (1),
+	  str_buf      (NULL),
+	  str_len      (0),
+	  str_size     (0)
     {
     }
 
@@ -221,68 +518,122 @@ public:
 	friend class Option;
 
     private:
-	ValueList::iter iter_;
+	Count idx;
 
     public:
 	iter ()
+	    : idx (0)
 	{
 	}
 
-	iter (Option &option)
-	    : iter_ (option.value_list)
+	iter (Option & /* option */)
+	    : idx (0)
 	{
 	}
     };
 
     void iter_begin (iter &iter)
     {
-	value_list.iter_begin (iter.iter_);
+	iter.idx = 0;
     }
 
     Value* iter_next (iter &iter)
     {
-	return value_list.iter_next (iter.iter_);
+	return &values [iter.idx++];
     }
 
     bool iter_done (iter &iter)
     {
-	return value_list.iter_done (iter.iter_);
+	return iter.idx >= num_values;
     }
 };
 
+class Section;
+
+typedef void (*SectionMemoryStatsCallback) (Section                 *section,
+					    ConfigMemoryStats const *stats,
+					    void                    *cb_data);
+
 class Section : public SectionEntry
 {
+    friend class ConfigPath;
+
 private:
     typedef Hash< Attribute,
-                  Memory,
+                  ConfigNameKey,
                   MemberExtractor< Attribute,
-                                   Ref<String>,
-                                   &Attribute::name_str,
-                                   Memory,
-                                   AccessorExtractor< String,
-                                                      Memory,
-                                                      &String::mem > >,
-                  MemoryComparator<> >
+                                   ConfigNameKey,
+                                   &Attribute::name_key >,
+                  ConfigNameKeyComparator,
+                  ConfigNameKeyHasher >
             AttributeHash;
 
     typedef Hash< SectionEntry,
-		  Memory,
+		  ConfigNameKey,
 		  MemberExtractor< SectionEntry,
-				   Ref<String>,
-				   &SectionEntry::name_str,
-				   Memory,
-				   AccessorExtractor< String,
-						      Memory,
-						      &String::mem > >,
-		  MemoryComparator<> >
+				   ConfigNameKey,
+				   &SectionEntry::name_key >,
+		  ConfigNameKeyComparator,
+		  ConfigNameKeyHasher >
 	    SectionEntryHash;
 
+    // Sections with the same name in this section, in the order in which they
+    // have been added (file order for parsed configs).
+    class SectionGroup : public HashEntry<>
+    {
+    public:
+	ConfigNameKey name_key;
+
+	Section *first;
+	Section *last;
+	Count    num_sections;
+    };
+
+    typedef Hash< SectionGroup,
+		  ConfigNameKey,
+		  MemberExtractor< SectionGroup,
+				   ConfigNameKey,
+				   &SectionGroup::name_key >,
+		  ConfigNameKeyComparator,
+		  ConfigNameKeyHasher >
+	    SectionGroupHash;
+
+    // Config which the section belongs to. Names of entries created with
+    // create*() methods are interned in the Config's name table, and changes
+    // of the section bump the Config's generation. NULL for sections which are
+    // not part of a Config.
+    Config *config;
+
     AttributeHash    attribute_hash;
     SectionEntryHash section_entry_hash;
+    SectionGroupHash section_group_hash;
+
+    // Neighbours with the same name in the parent section.
+    Section *prev_sibling;
+    Section *next_sibling;
+
+    // Number of path lookups of missing entries in this section. Maintained
+    // only while lookup stats are enabled for the Config.
+    StatCounter num_misses;
+
+    bool lookupStatsEnabled () const;
+
+    void linkSibling (Section * mt_nonnull section);
+
+    void unlinkSibling (Section * mt_nonnull section);
+
+    void setConfig (Config *config);
+
+    void treeChanged ();
 
 public:
     Attribute* getAttribute (ConstMemory attr_name);
 
+    // Lookups with @create == false never modify the tree and may run
+    // concurrently. If an entry of the requested type is not found, including
+    // when the name is taken by an entry of another type, NULL is returned.
+    // With @create == true, an entry of another type is replaced.
+
     SectionEntry* getSectionEntry (ConstMemory path,
 				   bool create = false,
 				   SectionEntry::Type section_entry_type = SectionEntry::Type_Invalid);
@@ -295,12 +646,54 @@ public:
 
     SectionEntry* getSectionEntry_nopath (ConstMemory section_entry_name);
 
+    SectionEntry* getSectionEntry_nopath (ConfigNameKey const &section_entry_name);
+
     Option* getOption_nopath (ConstMemory option_name,
 			      bool create = false);
 
     Section* getSection_nopath (ConstMemory section_name,
 				bool create = false);
 
+    // Sections with the same name may be repeated. Lookups return the first
+    // of them, the rest are reachable with getNextSibling() in O(1) each.
+    // Sibling order is the order of addition, which is file order for parsed
+    // configs.
+
+    Count getNumSections (ConstMemory path);
+
+    Count getNumSections_nopath (ConstMemory section_name);
+
+    Section* getPrevSibling () const
+    {
+	return prev_sibling;
+    }
+
+    Section* getNextSibling () const
+    {
+	return next_sibling;
+    }
+
+    Uint32 getNumMisses () const
+    {
+	return num_misses.get();
+    }
+
+    // Resets lookup counters of the section's subtree.
+    void resetLookupStats ();
+
+    // The following methods create entries which are allocated the same way
+    // as the section itself: either from the Config's arena or on the heap.
+    // Entry names are interned in the section's name table.
+    // The entry is not added to the section.
+
+    Attribute* createAttribute (ConstMemory attr_name,
+				bool        has_value,
+				ConstMemory attr_value);
+
+    Option* createOption (ConstMemory option_name);
+
+    Section* createSection (ConstMemory section_name);
+
     // Takes ownership of @attribute.
     void addAttribute (Attribute *attr);
 
@@ -312,14 +705,48 @@ public:
 
     void removeSectionEntry (SectionEntry *section_entry);
 
+    // Removes @section_entry from the section without deleting it.
+    // The caller takes ownership of the entry. Entries allocated from an arena
+    // must not outlive the Config which owns the arena, and entries with
+    // interned names must not outlive the name table.
+    void detachSectionEntry (SectionEntry *section_entry);
+
     void dump (OutputStream *outs,
 	       unsigned      nest_level = 0);
 
     void dumpBody (OutputStream *outs,
 		   unsigned      nest_level = 0);
 
-    Section (ConstMemory const section_name)
-	: SectionEntry (SectionEntry::Type_Section, section_name)
+    // Adds the footprint of the section and of its subtree to @stats.
+    // Arena and name table fields are not touched. If @subsection_cb is
+    // non-NULL, it is called for every immediate subsection with the stats of
+    // the subsection's subtree.
+    void getMemoryStats (ConfigMemoryStats          * mt_nonnull stats,
+			 SectionMemoryStatsCallback   subsection_cb = NULL,
+			 void                       *cb_data = NULL);
+
+    Config* getConfig () const
+    {
+	return config;
+    }
+
+    Section (ConstMemory   const section_name,
+	     ConfigArena * const arena = NULL,
+	     Config      * const config = NULL)
+	: SectionEntry (SectionEntry::Type_Section, section_name, arena),
+	  config       (config),
+	  prev_sibling (NULL),
+	  next_sibling (NULL)
+    {
+    }
+
+    Section (ConfigNameKey const &interned_name,
+	     ConfigArena         * const arena,
+	     Config              * const config)
+	: SectionEntry (SectionEntry::Type_Section, interned_name, arena),
+	  config       (config),
+	  prev_sibling (NULL),
+	  next_sibling (NULL)
     {
     }
 
@@ -415,69 +842,30 @@ private:
     Value value;
 };
 
+// Configs which are shared between threads should be published through
+// ConfigHolder, which provides snapshots for hot reloading.
 class Config : public Object
 {
-#if 0
-private:
-    StateMutex mutex;
-
-
-  // _____________________________ event_informer ______________________________
-
-public:
-    typedef Uint32 update_key;
-
-    struct Events
-    {
-        void (*configReload) (Config    *config,
-                              UpdateKey  update_key,
-                              void      *cb_data);
-    };
-
-private:
-    Informer_<Events> event_informer;
-
-    struct InformConfigReload_Data
-    {
-        Config *config;
-        UpdateKey update_key;
-    };
-
-    static void informConfigReload (Events * const events,
-                                    void   * const cb_data,
-                                    void   * const _config)
-    {
-        Config * const config = static_cast <Config*> (_config);
-        if (events->configReload)
-            events->configReload (config, cb_data);
-    }
-
-    void fireConfigReload () { event_informer.informAll (informConfigReload, /* data */); }
-
-public:
-    Informer_<Events>* getEventInformer () { return &event_informer; }
-
-
-  // ____________________________ config reloading _____________________________
+    friend class Section;
 
 private:
-    Uint32 next_update_key;
+    // Declared before root_section so that the root section is destroyed first.
+    Ref<ConfigNameTable> name_table;
 
-public:
-    // All nodes are marked as "not changed" (update key  increment).
-    // Original values are preserved for later comparison (copy-on-write).
-    mt_locks (update_mutex) void beginUpdate ();
-
-    // Update notification.
-    mt_unlocks (update_mutex) void endUpdate ();
+    // Unique for every Config in the process.
+    mt_const Uint32 config_id;
 
-    mt_locks (update_mutex) void updateLock ();
+    // Incremented on every structural change of the tree: when section entries
+    // are added, removed or replaced.
+    Uint64 generation;
 
-    mt_unlocks (update_mutex) void updateUnlock ();
+    AtomicInt lookup_stats_enabled;
 
-  // ___________________________________________________________________________
-#endif
+    static Uint32 newConfigId ();
 
+    // Owns all nodes of the tree in arena mode. Declared before root_section
+    // so that the root section is destroyed first.
+    ConfigArena arena;
 
     Section root_section;
 
@@ -497,6 +885,11 @@ public:
 	return root_section.getSection (path, create);
     }
 
+    Count getNumSections (ConstMemory const path)
+    {
+	return root_section.getNumSections (path);
+    }
+
     Option* setOption (ConstMemory path,
 		       ConstMemory value);
 
@@ -506,8 +899,70 @@ public:
     ConstMemory getString_default (ConstMemory path,
 				   ConstMemory default_value);
 
+    // Typed getters for @option. GetResult::Default is returned if @option is
+    // NULL or has an empty value. Bad values are reported once per value.
+    // @path is used for error messages only.
+
+    static GetResult getOptionInt64 (Option      *option,
+				     ConstMemory  path,
+				     Int64       *ret_value);
+
+    static GetResult getOptionUint64 (Option      *option,
+				      ConstMemory  path,
+				      Uint64      *ret_value);
+
+    static GetResult getOptionDouble (Option      *option,
+				      ConstMemory  path,
+				      double      *ret_value);
+
+    static BooleanValue getOptionBoolean (Option      *option,
+					  ConstMemory  path);
+
+    GetResult getInt64 (ConstMemory  path,
+			Int64       *ret_value)
+    {
+	return getOptionInt64 (getOption (path), path, ret_value);
+    }
+
+    GetResult getInt64_default (ConstMemory   const path,
+				Int64       * const ret_value,
+				Int64         const default_value)
+    {
+	GetResult const res = getInt64 (path, ret_value);
+	if (res == GetResult::Default) {
+	    if (ret_value) {
+		*ret_value = default_value;
+	    }
+	    return GetResult::Default;
+	}
+	return res;
+    }
+
+    GetResult getDouble (ConstMemory  path,
+			 double      *ret_value)
+    {
+	return getOptionDouble (getOption (path), path, ret_value);
+    }
+
+    GetResult getDouble_default (ConstMemory   const path,
+				 double      * const ret_value,
+				 double        const default_value)
+    {
+	GetResult const res = getDouble (path, ret_value);
+	if (res == GetResult::Default) {
+	    if (ret_value) {
+		*ret_value = default_value;
+	    }
+	    return GetResult::Default;
+	}
+	return res;
+    }
+
     GetResult getUint64 (ConstMemory  path,
-			 Uint64      *ret_value);
+			 Uint64      *ret_value)
+    {
+	return getOptionUint64 (getOption (path), path, ret_value);
+    }
 
     GetResult getUint64_default (ConstMemory   const path,
 				 Uint64      * const ret_value,
@@ -523,7 +978,24 @@ public:
 	return res;
     }
 
-    BooleanValue getBoolean (ConstMemory path);
+    BooleanValue getBoolean (ConstMemory const path)
+    {
+	return getOptionBoolean (getOption (path), path);
+    }
+
+    // Returns @default_value if the option is not set or has a bad value.
+    bool getBoolean_default (ConstMemory const path,
+			     bool        const default_value)
+    {
+	switch (getBoolean (path)) {
+	    case Boolean_True:
+		return true;
+	    case Boolean_False:
+		return false;
+	    default:
+		return default_value;
+	}
+    }
 
     Section* getRootSection ()
     {
@@ -533,13 +1005,76 @@ public:
     void dump (OutputStream *outs,
 	       unsigned      nest_level = 0);
 
-    Config ()
+    // Fills @ret_stats with the footprint of the whole Config, including its
+    // arena and name table. If @cb is non-NULL, it is called with the subtree
+    // stats of every top-level section, repeated sections included.
+    // Not thread-safe: the tree must not be modified concurrently.
+    void getMemoryStats (ConfigMemoryStats          * mt_nonnull ret_stats,
+			 SectionMemoryStatsCallback   cb = NULL,
+			 void                       *cb_data = NULL);
+
+    bool usesArena () const
+    {
+	return root_section.getArena() != NULL;
+    }
+
+    ConfigNameTable* getNameTable () const
+    {
+	return name_table;
+    }
+
+    Uint32 getConfigId () const
+    {
+	return config_id;
+    }
+
+    // When enabled, path lookups through Section::getSectionEntry() and
+    // the getters built on it count hits on the resolved entries and misses on
+    // the deepest section reached (see config_lookup_stats.h). Counters are
+    // not reset when stats are disabled. Thread-safe.
+    void setLookupStatsEnabled (bool const enabled)
+    {
+	lookup_stats_enabled.set (enabled ? 1 : 0);
+    }
+
+    bool isLookupStatsEnabled () const
+    {
+	return lookup_stats_enabled.get();
+    }
+
+    // Pointers to section entries obtained from the Config remain valid until
+    // the generation changes.
+    Uint64 getGeneration () const
+    {
+	return generation;
+    }
+
+    // If @use_arena is true, then all entries and strings of the tree are
+    // allocated from an arena owned by the Config and are released all at once
+    // when the Config is destroyed. Memory of removed entries and replaced values
+    // is not reused until then.
+    //
+    // Names of entries are interned in @name_table. A new table is created for
+    // the Config if @name_table is NULL. Sharing a table between Configs allows
+    // to move entries from one Config to another.
+    Config (bool              const use_arena = false,
+	    ConfigNameTable * const name_table = NULL)
         : // event_informer (this /* coderef_container */, &mutex),
-	  root_section ("root") 
+	  name_table (name_table ? Ref<ConfigNameTable> (name_table)
+				 : grab (new (std::nothrow) ConfigNameTable)),
+	  config_id (newConfigId ()),
+	  generation (0),
+	  root_section ("root", use_arena ? &arena : NULL, this)
     {
     }
 };
 
+inline bool
+Section::lookupStatsEnabled () const
+{
+    return config && config->isLookupStatsEnabled ();
+}
+
 }
 
 
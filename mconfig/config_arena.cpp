@@ -0,0 +1,126 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <mconfig/config_arena.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+ConfigArena::Chunk*
+ConfigArena::allocChunk (Size const data_len)
+{
+    Byte * const buf = new (std::nothrow) Byte [chunk_header_len + data_len];
+    assert (buf);
+
+    Chunk * const chunk = reinterpret_cast <Chunk*> (buf);
+    chunk->next = NULL;
+    chunk->size = data_len;
+    chunk->pos  = 0;
+
+    return chunk;
+}
+
+void*
+ConfigArena::alloc (Size len)
+{
+    len = (len + 7) & ~(Size) 7;
+
+    if (!chunks || chunks->size - chunks->pos < len) {
+        if (len > chunk_size / 4) {
+          // Large allocations get a chunk of their own, which is linked behind
+          // the current chunk so that the current chunk's free space is not lost.
+            Chunk * const chunk = allocChunk (len);
+            chunk->pos = len;
+            if (chunks) {
+                chunk->next = chunks->next;
+                chunks->next = chunk;
+            } else {
+                chunks = chunk;
+            }
+
+            return reinterpret_cast <Byte*> (chunk) + chunk_header_len;
+        }
+
+        Chunk * const chunk = allocChunk (chunk_size);
+        chunk->next = chunks;
+        chunks = chunk;
+    }
+
+    void * const ptr = reinterpret_cast <Byte*> (chunks) + chunk_header_len + chunks->pos;
+    chunks->pos += len;
+    return ptr;
+}
+
+Memory
+ConfigArena::copy (ConstMemory const mem)
+{
+    if (mem.len() == 0)
+        return Memory();
+
+    Byte * const buf = static_cast <Byte*> (alloc (mem.len()));
+    memcpy (buf, mem.mem(), mem.len());
+    return Memory (buf, mem.len());
+}
+
+Memory
+ConfigArena::copyMem (ConfigArena * const arena,
+                      ConstMemory   const mem)
+{
+    if (arena)
+        return arena->copy (mem);
+
+    if (mem.len() == 0)
+        return Memory();
+
+    Byte * const buf = new (std::nothrow) Byte [mem.len()];
+    assert (buf);
+    memcpy (buf, mem.mem(), mem.len());
+    return Memory (buf, mem.len());
+}
+
+void
+ConfigArena::getMemoryStats (ConfigMemoryStats * const mt_nonnull stats) const
+{
+    for (Chunk *chunk = chunks; chunk; chunk = chunk->next) {
+        ++stats->arena_chunks;
+        stats->arena_bytes      += chunk_header_len + chunk->size;
+        stats->arena_used_bytes += chunk->pos;
+    }
+}
+
+ConfigArena::ConfigArena (Size const chunk_size)
+    : chunks     (NULL),
+      chunk_size (chunk_size)
+{
+}
+
+ConfigArena::~ConfigArena ()
+{
+    Chunk *chunk = chunks;
+    while (chunk) {
+        Chunk * const next_chunk = chunk->next;
+        delete[] reinterpret_cast <Byte*> (chunk);
+        chunk = next_chunk;
+    }
+}
+
+}
+
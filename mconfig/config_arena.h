@@ -0,0 +1,86 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MCONFIG__CONFIG_ARENA__H__
+#define MCONFIG__CONFIG_ARENA__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config_memory_stats.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Bump allocator for Config trees. Memory is released all at once when the
+// arena is destroyed. Not thread-safe.
+class ConfigArena
+{
+private:
+    struct Chunk
+    {
+        Chunk *next;
+        Size   size;
+        Size   pos;
+    };
+
+    // Chunk data starts at this offset from the chunk header.
+    static Size const chunk_header_len = (sizeof (Chunk) + 15) & ~(Size) 15;
+
+    Chunk *chunks;
+    Size const chunk_size;
+
+    Chunk* allocChunk (Size data_len);
+
+public:
+    // Returned memory is aligned to 8 bytes.
+    void* alloc (Size len);
+
+    // Returns a copy of @mem allocated from the arena.
+    Memory copy (ConstMemory mem);
+
+  // Helpers for nodes which may live either in an arena or on the heap.
+
+    // Allocates a copy of @mem from @arena, or with new[] if @arena is NULL.
+    static Memory copyMem (ConfigArena *arena,
+                           ConstMemory  mem);
+
+    // Releases memory allocated with copyMem().
+    static void freeMem (ConfigArena * const arena,
+                         ConstMemory   const mem)
+    {
+        if (!arena)
+            delete[] const_cast <Byte*> (mem.mem());
+    }
+
+    // Adds the arena's chunks to @stats (arena_* fields).
+    void getMemoryStats (ConfigMemoryStats * mt_nonnull stats) const;
+
+    ConfigArena (Size chunk_size = (1 << 16));
+
+    ~ConfigArena ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_ARENA__H__ */
+
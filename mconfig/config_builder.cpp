@@ -0,0 +1,173 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <cstring>
+
+#include <mconfig/config_builder.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+ConfigEvents const ConfigBuilder::events = {
+    beginSection,
+    option,
+    endSection,
+    cancelSection
+};
+
+void
+ConfigBuilder::pushBegunSection (Section * const section,
+                                 Section * const parent)
+{
+    if (num_begun_sections == begun_sections_size) {
+        Count const new_size = (begun_sections_size ? 2 * begun_sections_size : 16);
+        BegunSection * const new_begun_sections = new (std::nothrow) BegunSection [new_size];
+        assert (new_begun_sections);
+        if (num_begun_sections)
+            memcpy (new_begun_sections, begun_sections, num_begun_sections * sizeof (BegunSection));
+
+        delete[] begun_sections;
+        begun_sections = new_begun_sections;
+        begun_sections_size = new_size;
+    }
+
+    BegunSection * const begun_section = &begun_sections [num_begun_sections];
+    begun_section->section = section;
+    begun_section->parent  = parent;
+    ++num_begun_sections;
+}
+
+bool
+ConfigBuilder::beginSection (ConstMemory                 const section_name,
+                             ConfigAttributeDesc const * const attrs,
+                             Count                       const num_attrs,
+                             void                      * const _self)
+{
+    ConfigBuilder * const self = static_cast <ConfigBuilder*> (_self);
+
+// Section value replacement was disabled to allow lists of sections
+// with the same name (for Moment's mod_file).
+    Section * const parent_section = self->sections.getLast();
+    Section * const section = parent_section->createSection (section_name);
+    parent_section->addSection (section);
+    self->alloc_bytes += sizeof (Section);
+
+    self->pushBegunSection (section, parent_section);
+
+    for (Count i = 0; i < num_attrs; ++i) {
+        ConfigAttributeDesc const &attr_desc = attrs [i];
+
+        ConstMemory attr_value = attr_desc.value;
+        if (self->var_expander
+            && attr_desc.has_value
+            && !self->var_expander->expand (attr_desc.value, &attr_value))
+        {
+            return false;
+        }
+
+        Attribute *attr = section->getAttribute (attr_desc.name);
+        if (attr) {
+            attr->setValue (attr_desc.has_value, attr_value);
+        } else {
+            attr = section->createAttribute (attr_desc.name, attr_desc.has_value, attr_value);
+            section->addAttribute (attr);
+            self->alloc_bytes += sizeof (Attribute);
+        }
+
+        if (attr_desc.has_value)
+            self->alloc_bytes += attr_value.len();
+    }
+
+    self->sections.append (section);
+    return true;
+}
+
+bool
+ConfigBuilder::option (ConstMemory         const key,
+                       ConstMemory const * const values,
+                       Count               const num_values,
+                       void              * const _self)
+{
+    ConfigBuilder * const self = static_cast <ConfigBuilder*> (_self);
+
+    Section * const section = self->sections.getLast();
+
+  // Last option wins.
+    Option *option = section->getOption (key);
+    if (option) {
+        option->removeValues ();
+    } else {
+        option = section->createOption (key);
+        section->addOption (option);
+        self->alloc_bytes += sizeof (Option);
+    }
+
+    {
+        Size num_bytes = 0;
+        for (Count i = 0; i < num_values; ++i)
+            num_bytes += values [i].len();
+
+      // Exact unless ${name} expansion changes the length.
+        option->reserveValues (num_values, num_bytes);
+    }
+
+    for (Count i = 0; i < num_values; ++i) {
+        ConstMemory value = values [i];
+        if (self->var_expander && !self->var_expander->expand (values [i], &value))
+            return false;
+
+        option->addValue (value);
+        self->alloc_bytes += sizeof (Value) + value.len();
+    }
+
+    return true;
+}
+
+bool
+ConfigBuilder::endSection (void * const _self)
+{
+    ConfigBuilder * const self = static_cast <ConfigBuilder*> (_self);
+
+    if (self->sections.first == self->sections.last) {
+        logE_ (_func, "unbalanced section end");
+        return false;
+    }
+
+    self->sections.remove (self->sections.last);
+    return true;
+}
+
+void
+ConfigBuilder::cancelSection (void * const _self)
+{
+    ConfigBuilder * const self = static_cast <ConfigBuilder*> (_self);
+
+    assert (self->num_begun_sections > 0);
+    BegunSection const &begun_section = self->begun_sections [self->num_begun_sections - 1];
+  // The section has been closed with endSection.
+    assert (self->sections.getLast() != begun_section.section);
+
+    begun_section.parent->removeSectionEntry (begun_section.section);
+    --self->num_begun_sections;
+}
+
+}
+
@@ -0,0 +1,144 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MCONFIG__CONFIG_BUILDER__H__
+#define MCONFIG__CONFIG_BUILDER__H__
+
+
+#include <libmary/libmary.h>
+#include <cctype>
+
+#include <mconfig/config.h>
+#include <mconfig/config_parser.h>
+#include <mconfig/var_expander.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Words of keys and values are glued together without whitespace unless both
+// adjacent characters are alphanumeric: "1.2.3.4:80" stays intact,
+// "multi line value" keeps its spaces.
+static inline bool whitespaceBetweenWordsNeeded (ConstMemory const &left,
+                                                 ConstMemory const &right)
+{
+    if (left .len() == 0 ||
+        right.len() == 0)
+    {
+        return false;
+    }
+
+    if (isalnum (left.mem() [left.len() - 1]) &&
+        isalnum (right.mem() [0]))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// Strips quotes from string literals.
+static inline ConstMemory unquoteWord (ConstMemory const word)
+{
+    if (word.len() && word.mem() [0] == '"') {
+        assert (word.len() >= 2);
+        return word.region (1, word.len() - 2);
+    }
+
+    return word;
+}
+
+// Builds a Config tree from parser events. Used by parseConfig() for both
+// the native and the pargen-based parser so that they produce identical trees.
+class ConfigBuilder
+{
+private:
+    // Stack of currently open sections. The root section is at the bottom.
+    List<Section*> sections;
+
+    struct BegunSection
+    {
+        Section *section;
+        Section *parent;
+    };
+
+    // All sections in the order in which they have begun, minus cancelled
+    // ones. cancelSection always applies to the last of them. A growable
+    // array rather than a list, so that tracking sections costs no allocation
+    // per section; only pargen ever cancels them.
+    BegunSection *begun_sections;
+    Count num_begun_sections;
+    Count begun_sections_size;
+
+    void pushBegunSection (Section *section,
+                           Section *parent);
+
+    // Expands ${name} in option and attribute values. NULL if no varlist has
+    // been given.
+    VarExpander *var_expander;
+
+    // Bytes allocated for nodes and strings of the tree so far.
+    Size alloc_bytes;
+
+    static bool beginSection (ConstMemory                section_name,
+                              ConfigAttributeDesc const *attrs,
+                              Count                      num_attrs,
+                              void                      *_self);
+
+    static bool option (ConstMemory        key,
+                        ConstMemory const *values,
+                        Count              num_values,
+                        void              *_self);
+
+    static bool endSection (void *_self);
+
+    static void cancelSection (void *_self);
+
+public:
+    static ConfigEvents const events;
+
+    ConfigBuilder (Config  * const mt_nonnull config,
+                   Varlist * const varlist = NULL)
+        : begun_sections      (NULL),
+          num_begun_sections  (0),
+          begun_sections_size (0),
+          var_expander (varlist ? new (std::nothrow) VarExpander (varlist) : NULL),
+          alloc_bytes  (0)
+    {
+        sections.append (config->getRootSection());
+    }
+
+    Size getAllocBytes () const
+    {
+        return alloc_bytes;
+    }
+
+    ~ConfigBuilder ()
+    {
+        delete[] begun_sections;
+        delete var_expander;
+    }
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_BUILDER__H__ */
+
@@ -0,0 +1,569 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <cstring>
+#include <algorithm>
+
+#include <mconfig/config_diff.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+bool
+configPathsOverlap (ConstMemory const prefix,
+                    ConstMemory const path)
+{
+    Size const len = (prefix.len() < path.len() ? prefix.len() : path.len());
+    if (len && memcmp (prefix.mem(), path.mem(), len))
+        return false;
+
+    if (prefix.len() == path.len() || len == 0)
+        return true;
+
+    ConstMemory const &longer = (prefix.len() > path.len() ? prefix : path);
+    return longer.mem() [len] == '/';
+}
+
+namespace {
+
+struct EntryRef
+{
+    SectionEntry *entry;
+    // Position in the section, file order for repeated sections.
+    Count order;
+};
+
+int
+compareNames (ConstMemory const left,
+              ConstMemory const right)
+{
+    Size const len = (left.len() < right.len() ? left.len() : right.len());
+    if (len) {
+        int const res = memcmp (left.mem(), right.mem(), len);
+        if (res)
+            return res;
+    }
+
+    if (left.len() == right.len())
+        return 0;
+
+    return (left.len() < right.len() ? -1 : 1);
+}
+
+bool
+entryRefLess (EntryRef const &left,
+              EntryRef const &right)
+{
+    int const res = compareNames (left.entry->getName(), right.entry->getName());
+    if (res)
+        return res < 0;
+
+    return left.order < right.order;
+}
+
+bool
+optionValuesEqual (Option * const mt_nonnull left,
+                   Option * const mt_nonnull right)
+{
+    Option::iter left_iter  (*left);
+    Option::iter right_iter (*right);
+    for (;;) {
+        bool const left_done  = left ->iter_done (left_iter);
+        bool const right_done = right->iter_done (right_iter);
+        if (left_done || right_done)
+            return left_done && right_done;
+
+        if (!equal (left->iter_next (left_iter)->mem(), right->iter_next (right_iter)->mem()))
+            return false;
+    }
+}
+
+class ConfigDiffer
+{
+private:
+    ConfigChangeCallback const cb;
+    void * const cb_data;
+
+    ConstMemory const * const prefixes;
+    Count const num_prefixes;
+
+    Byte *path_buf;
+    Size  path_len;
+    Size  path_buf_size;
+
+    Count num_changes;
+
+    bool isPathWatched (ConstMemory const path)
+    {
+        if (!prefixes)
+            return true;
+
+        for (Count i = 0; i < num_prefixes; ++i) {
+            if (configPathsOverlap (prefixes [i], path))
+                return true;
+        }
+
+        return false;
+    }
+
+    // Returns the previous path length to be passed to popPath().
+    Size pushPath (ConstMemory const name)
+    {
+        Size const prv_len = path_len;
+        Size const new_len = path_len + (path_len ? 1 : 0) + name.len();
+        if (new_len > path_buf_size) {
+            Size new_size = (path_buf_size ? path_buf_size * 2 : 256);
+            while (new_size < new_len)
+                new_size *= 2;
+
+            Byte * const new_buf = new (std::nothrow) Byte [new_size];
+            assert (new_buf);
+            if (path_len)
+                memcpy (new_buf, path_buf, path_len);
+
+            delete[] path_buf;
+            path_buf = new_buf;
+            path_buf_size = new_size;
+        }
+
+        if (path_len) {
+            path_buf [path_len] = '/';
+            ++path_len;
+        }
+
+        if (name.len())
+            memcpy (path_buf + path_len, name.mem(), name.len());
+        path_len += name.len();
+
+        return prv_len;
+    }
+
+    void popPath (Size const prv_len)
+    {
+        path_len = prv_len;
+    }
+
+    ConstMemory getPath () const
+    {
+        return ConstMemory (path_buf, path_len);
+    }
+
+    void report (ConfigChange::Type       const type,
+                 ConfigChange::EntryType  const entry_type,
+                 Count                    const index,
+                 SectionEntry           * const old_entry,
+                 SectionEntry           * const new_entry,
+                 Attribute              * const old_attr = NULL,
+                 Attribute              * const new_attr = NULL)
+    {
+        ConfigChange change;
+        change.type       = type;
+        change.entry_type = entry_type;
+        change.path       = getPath();
+        change.index      = index;
+        change.old_entry  = old_entry;
+        change.new_entry  = new_entry;
+        change.old_attr   = old_attr;
+        change.new_attr   = new_attr;
+
+        ++num_changes;
+        cb (&change, cb_data);
+    }
+
+    static void collectEntries (Section  * const section,
+                                EntryRef * const refs,
+                                Count    * const ret_num_refs)
+    {
+        Count num_refs = 0;
+        if (section) {
+            Section::iter iter (*section);
+            while (!section->iter_done (iter)) {
+                SectionEntry * const section_entry = section->iter_next (iter);
+                if (section_entry->getType() == SectionEntry::Type_Section) {
+                  // Repeated sections are paired in file order.
+                    Section *sibling = static_cast <Section*> (section_entry);
+                    if (sibling->getPrevSibling())
+                        continue;
+
+                    for (; sibling; sibling = sibling->getNextSibling()) {
+                        refs [num_refs].entry = sibling;
+                        refs [num_refs].order = num_refs;
+                        ++num_refs;
+                    }
+
+                    continue;
+                }
+
+                refs [num_refs].entry = section_entry;
+                refs [num_refs].order = num_refs;
+                ++num_refs;
+            }
+        }
+
+        std::sort (refs, refs + num_refs, entryRefLess);
+        *ret_num_refs = num_refs;
+    }
+
+    static Count countEntries (Section * const section)
+    {
+        Count num_entries = 0;
+        if (section) {
+            Section::iter iter (*section);
+            while (!section->iter_done (iter)) {
+                section->iter_next (iter);
+                ++num_entries;
+            }
+        }
+
+        return num_entries;
+    }
+
+    void diffAttributes (Section * const mt_nonnull old_section,
+                         Section * const mt_nonnull new_section,
+                         Count     const index)
+    {
+        {
+            Section::attribute_iterator iter (*new_section);
+            while (!iter.done()) {
+                Attribute * const new_attr = iter.next ();
+                Attribute * const old_attr = old_section->getAttribute (new_attr->getName());
+                if (!old_attr) {
+                    report (ConfigChange::Type_Added, ConfigChange::EntryType_Attribute, index,
+                            old_section, new_section, NULL, new_attr);
+                } else
+                if (old_attr->hasValue() != new_attr->hasValue()
+                    || !equal (old_attr->getValue(), new_attr->getValue()))
+                {
+                    report (ConfigChange::Type_Modified, ConfigChange::EntryType_Attribute, index,
+                            old_section, new_section, old_attr, new_attr);
+                }
+            }
+        }
+
+        {
+            Section::attribute_iterator iter (*old_section);
+            while (!iter.done()) {
+                Attribute * const old_attr = iter.next ();
+                if (!new_section->getAttribute (old_attr->getName())) {
+                    report (ConfigChange::Type_Removed, ConfigChange::EntryType_Attribute, index,
+                            old_section, new_section, old_attr, NULL);
+                }
+            }
+        }
+    }
+
+    void diffEntries (SectionEntry * const mt_nonnull old_entry,
+                      SectionEntry * const mt_nonnull new_entry,
+                      Count          const index)
+    {
+        if (old_entry->getType() != new_entry->getType()) {
+            ConfigChange::EntryType const old_type =
+                    (old_entry->getType() == SectionEntry::Type_Option ?
+                             ConfigChange::EntryType_Option : ConfigChange::EntryType_Section);
+            ConfigChange::EntryType const new_type =
+                    (new_entry->getType() == SectionEntry::Type_Option ?
+                             ConfigChange::EntryType_Option : ConfigChange::EntryType_Section);
+
+            report (ConfigChange::Type_Removed, old_type, index, old_entry, NULL);
+            report (ConfigChange::Type_Added,   new_type, index, NULL, new_entry);
+            return;
+        }
+
+        if (old_entry->getType() == SectionEntry::Type_Option) {
+            if (!optionValuesEqual (static_cast <Option*> (old_entry), static_cast <Option*> (new_entry)))
+                report (ConfigChange::Type_Modified, ConfigChange::EntryType_Option, index, old_entry, new_entry);
+
+            return;
+        }
+
+        Section * const old_section = static_cast <Section*> (old_entry);
+        Section * const new_section = static_cast <Section*> (new_entry);
+        diffAttributes (old_section, new_section, index);
+        diffSections (old_section, new_section);
+    }
+
+public:
+    // Compares the contents of two sections at the current path.
+    void diffSections (Section * const old_section,
+                       Section * const new_section)
+    {
+        if (old_section == new_section)
+            return;
+
+        Count const num_old = countEntries (old_section);
+        Count const num_new = countEntries (new_section);
+
+        EntryRef * const old_refs = new (std::nothrow) EntryRef [num_old + num_new];
+        assert (old_refs);
+        EntryRef * const new_refs = old_refs + num_old;
+
+        Count num_old_refs;
+        Count num_new_refs;
+        collectEntries (old_section, old_refs, &num_old_refs);
+        collectEntries (new_section, new_refs, &num_new_refs);
+
+      // Both arrays are sorted by name. Entries with the same name are paired
+      // in order; extra ones are reported as added or removed.
+        Count old_pos = 0;
+        Count new_pos = 0;
+        while (old_pos < num_old_refs || new_pos < num_new_refs) {
+            int res;
+            if (old_pos == num_old_refs)
+                res = 1;
+            else
+            if (new_pos == num_new_refs)
+                res = -1;
+            else
+                res = compareNames (old_refs [old_pos].entry->getName(),
+                                    new_refs [new_pos].entry->getName());
+
+            ConstMemory const name = (res <= 0 ? old_refs [old_pos].entry->getName()
+                                               : new_refs [new_pos].entry->getName());
+
+            Size const prv_len = pushPath (name);
+            if (!isPathWatched (getPath())) {
+                while (old_pos < num_old_refs && !compareNames (old_refs [old_pos].entry->getName(), name))
+                    ++old_pos;
+                while (new_pos < num_new_refs && !compareNames (new_refs [new_pos].entry->getName(), name))
+                    ++new_pos;
+
+                popPath (prv_len);
+                continue;
+            }
+
+            for (Count index = 0; ; ++index) {
+                SectionEntry *old_entry = NULL;
+                if (old_pos < num_old_refs && !compareNames (old_refs [old_pos].entry->getName(), name))
+                    old_entry = old_refs [old_pos++].entry;
+
+                SectionEntry *new_entry = NULL;
+                if (new_pos < num_new_refs && !compareNames (new_refs [new_pos].entry->getName(), name))
+                    new_entry = new_refs [new_pos++].entry;
+
+                if (old_entry && new_entry) {
+                    diffEntries (old_entry, new_entry, index);
+                } else
+                if (old_entry) {
+                    report (ConfigChange::Type_Removed,
+                            (old_entry->getType() == SectionEntry::Type_Option ?
+                                     ConfigChange::EntryType_Option : ConfigChange::EntryType_Section),
+                            index, old_entry, NULL);
+                } else
+                if (new_entry) {
+                    report (ConfigChange::Type_Added,
+                            (new_entry->getType() == SectionEntry::Type_Option ?
+                                     ConfigChange::EntryType_Option : ConfigChange::EntryType_Section),
+                            index, NULL, new_entry);
+                } else {
+                    break;
+                }
+            }
+
+            popPath (prv_len);
+        }
+
+        delete[] old_refs;
+    }
+
+    Count getNumChanges () const
+    {
+        return num_changes;
+    }
+
+    ConfigDiffer (ConfigChangeCallback   const cb,
+                  void                 * const cb_data,
+                  ConstMemory const    * const prefixes,
+                  Count                  const num_prefixes)
+        : cb            (cb),
+          cb_data       (cb_data),
+          prefixes      (prefixes),
+          num_prefixes  (num_prefixes),
+          path_buf      (NULL),
+          path_len      (0),
+          path_buf_size (0),
+          num_changes   (0)
+    {
+    }
+
+    ~ConfigDiffer ()
+    {
+        delete[] path_buf;
+    }
+};
+
+}
+
+Count
+diffConfigs (Config               * const old_config,
+             Config               * const new_config,
+             ConfigChangeCallback   const cb,
+             void                 * const cb_data,
+             ConstMemory const    * const prefixes,
+             Count                  const num_prefixes)
+{
+    if (old_config == new_config)
+        return 0;
+
+    ConfigDiffer differ (cb, cb_data, prefixes, num_prefixes);
+    differ.diffSections (old_config ? old_config->getRootSection() : NULL,
+                         new_config ? new_config->getRootSection() : NULL);
+    return differ.getNumChanges();
+}
+
+namespace {
+
+struct DispatchEntry
+{
+    Ref<String>          prefix;
+    ConfigChangeCallback cb;
+    void                *cb_data;
+};
+
+struct DispatchList
+{
+    DispatchEntry *entries;
+    Count          num_entries;
+    Count          num_delivered;
+};
+
+}
+
+void
+ConfigDiffNotifier::dispatchChange (ConfigChange const * const change,
+                                    void               * const _list)
+{
+    DispatchList * const list = static_cast <DispatchList*> (_list);
+
+    bool delivered = false;
+    for (Count i = 0; i < list->num_entries; ++i) {
+        DispatchEntry * const entry = &list->entries [i];
+        if (configPathsOverlap (entry->prefix->mem(), change->path)) {
+            entry->cb (change, entry->cb_data);
+            delivered = true;
+        }
+    }
+
+    if (delivered)
+        ++list->num_delivered;
+}
+
+ConfigDiffNotifier::SubscriptionKey
+ConfigDiffNotifier::subscribe (ConstMemory          const path_prefix,
+                               ConfigChangeCallback const cb,
+                               void               * const cb_data)
+{
+    Subscription * const sbn = new (std::nothrow) Subscription;
+    assert (sbn);
+
+  // Subscriptions are matched against paths without a leading slash.
+    ConstMemory prefix = path_prefix;
+    while (prefix.len() && prefix.mem() [0] == '/')
+        prefix = prefix.region (1);
+
+    sbn->prefix = grab (new (std::nothrow) String (prefix));
+    sbn->cb = cb;
+    sbn->cb_data = cb_data;
+
+    mutex.lock ();
+    SubscriptionKey const sbn_key = subscription_list.append (sbn);
+    mutex.unlock ();
+
+    return sbn_key;
+}
+
+void
+ConfigDiffNotifier::unsubscribe (SubscriptionKey const sbn_key)
+{
+    mutex.lock ();
+    Subscription * const sbn = sbn_key->data;
+    subscription_list.remove (sbn_key);
+    mutex.unlock ();
+
+    delete sbn;
+}
+
+bool
+ConfigDiffNotifier::hasSubscriptions ()
+{
+    mutex.lock ();
+    bool const res = !subscription_list.isEmpty();
+    mutex.unlock ();
+
+    return res;
+}
+
+Count
+ConfigDiffNotifier::notify (Config * const old_config,
+                            Config * const new_config)
+{
+  // Subscriptions are copied so that callbacks may subscribe and unsubscribe.
+    mutex.lock ();
+
+    Count const num_entries = subscription_list.getNumElements();
+
+    if (num_entries == 0) {
+        mutex.unlock ();
+        return 0;
+    }
+
+    DispatchEntry * const entries = new (std::nothrow) DispatchEntry [num_entries];
+    assert (entries);
+    ConstMemory * const prefixes = new (std::nothrow) ConstMemory [num_entries];
+    assert (prefixes);
+
+    {
+        Count i = 0;
+        SubscriptionList::iterator iter (subscription_list);
+        while (!iter.done()) {
+            Subscription * const sbn = iter.next()->data;
+            entries [i].prefix  = sbn->prefix;
+            entries [i].cb      = sbn->cb;
+            entries [i].cb_data = sbn->cb_data;
+            prefixes [i] = sbn->prefix->mem();
+            ++i;
+        }
+    }
+
+    mutex.unlock ();
+
+    DispatchList list;
+    list.entries = entries;
+    list.num_entries = num_entries;
+    list.num_delivered = 0;
+
+    diffConfigs (old_config, new_config, dispatchChange, &list, prefixes, num_entries);
+
+    delete[] prefixes;
+    delete[] entries;
+
+    return list.num_delivered;
+}
+
+ConfigDiffNotifier::~ConfigDiffNotifier ()
+{
+    SubscriptionList::iterator iter (subscription_list);
+    while (!iter.done())
+        delete iter.next()->data;
+}
+
+}
+
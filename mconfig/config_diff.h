@@ -0,0 +1,140 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__CONFIG_DIFF__H__
+#define MCONFIG__CONFIG_DIFF__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+struct ConfigChange
+{
+    enum Type {
+        Type_Added,
+        Type_Removed,
+        Type_Modified
+    };
+
+    enum EntryType {
+        EntryType_Option,
+        EntryType_Section,
+        EntryType_Attribute
+    };
+
+    Type      type;
+    EntryType entry_type;
+
+    // Path of the option or of the section, without a leading slash.
+    // For attributes, this is the path of the section which the attribute
+    // belongs to. Valid only for the duration of the callback.
+    ConstMemory path;
+
+    // Index among sections with the same name, in file order.
+    // Non-zero only for repeated sections.
+    Count index;
+
+    // NULL for added entries.
+    SectionEntry *old_entry;
+    // NULL for removed entries.
+    SectionEntry *new_entry;
+
+    // Set for EntryType_Attribute only, NULL for the missing side.
+    Attribute *old_attr;
+    Attribute *new_attr;
+};
+
+typedef void (*ConfigChangeCallback) (ConfigChange const *change,
+                                      void               *cb_data);
+
+// Returns true if changes at @path are relevant to @prefix: either path lies
+// under prefix, or the change affects a section which contains prefix.
+// Both are compared component-wise.
+bool configPathsOverlap (ConstMemory prefix,
+                         ConstMemory path);
+
+// Reports differences between two trees. Options are modified when their value
+// lists differ. Added and removed sections are reported as a whole, without
+// their contents. Repeated sections are compared pairwise in file order.
+// Either config may be NULL, which stands for an empty tree.
+//
+// If @prefixes is non-NULL, then only subtrees which overlap one of
+// @prefixes are compared. Returns the number of reported changes.
+Count diffConfigs (Config               *old_config,
+                   Config               *new_config,
+                   ConfigChangeCallback  cb,
+                   void                 *cb_data,
+                   ConstMemory const    *prefixes = NULL,
+                   Count                 num_prefixes = 0);
+
+// Delivers differences between configs to subscribers of path prefixes.
+// Only the subtrees covered by some subscription are compared.
+class ConfigDiffNotifier
+{
+private:
+    struct Subscription
+    {
+        Ref<String>          prefix;
+        ConfigChangeCallback cb;
+        void                *cb_data;
+    };
+
+    typedef List<Subscription*> SubscriptionList;
+
+    Mutex mutex;
+
+    mt_mutex (mutex) SubscriptionList subscription_list;
+
+    static void dispatchChange (ConfigChange const *change,
+                                void               *_subscriptions);
+
+public:
+    typedef SubscriptionList::Element* SubscriptionKey;
+
+    // @cb is called for changes which overlap @path_prefix. An empty prefix
+    // subscribes to all changes.
+    SubscriptionKey subscribe (ConstMemory          path_prefix,
+                               ConfigChangeCallback cb,
+                               void                *cb_data);
+
+    // Callbacks for the subscription may still be in progress when this method
+    // returns.
+    void unsubscribe (SubscriptionKey sbn_key);
+
+    bool hasSubscriptions ();
+
+    // Returns the number of changes which have been delivered to subscribers.
+    Count notify (Config *old_config,
+                  Config *new_config);
+
+    ~ConfigDiffNotifier ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_DIFF__H__ */
+
@@ -0,0 +1,133 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <mconfig/config_holder.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
+
+Ref<Config>
+ConfigHolder::getConfig ()
+{
+    for (;;) {
+        int const epoch = read_epoch.get();
+        AtomicInt * const readers = &num_readers [epoch & 1];
+
+        readers->inc ();
+        if (read_epoch.get() != epoch) {
+          // A publisher has flipped the epoch and may be waiting for the other
+          // counter already.
+            readers->fetchAdd (-1);
+            continue;
+        }
+
+        Ref<Config> const config = static_cast <Config*> (cur_config.get());
+
+        readers->fetchAdd (-1);
+        return config;
+    }
+}
+
+void
+ConfigHolder::setConfig (Config * const config)
+{
+    update_mutex.lock ();
+
+    if (config)
+        config->ref ();
+
+    Config * const old_config = static_cast <Config*> (cur_config.get());
+    cur_config.set (config);
+
+    int const epoch = read_epoch.get();
+    read_epoch.set (epoch + 1);
+
+  // Readers which may have loaded old_config have announced themselves in
+  // the previous epoch. Their read-side sections consist of a pointer load and
+  // a reference increment, hence busy waiting.
+    while (num_readers [epoch & 1].get() != 0);
+
+  // Both snapshots are immutable, and old_config is still referenced.
+    if (diff_notifier.hasSubscriptions())
+        diff_notifier.notify (old_config, config);
+
+    if (old_config)
+        old_config->unref ();
+
+    ++update_key;
+    UpdateKey const new_update_key = update_key;
+
+    update_mutex.unlock ();
+
+    logD (mconfig, _func, "published config, update key ", new_update_key);
+
+    fireConfigReload (config, new_update_key);
+}
+
+Ref<Config>
+ConfigHolder::createConfig ()
+{
+    mutex.lock ();
+    if (name_table_num_configs >= NameTableLifetime) {
+        name_table = grab (new (std::nothrow) ConfigNameTable);
+        name_table_num_configs = 0;
+    }
+    ++name_table_num_configs;
+    Ref<ConfigNameTable> const cur_name_table = name_table;
+    mutex.unlock ();
+
+    return grab (new (std::nothrow) Config (true /* use_arena */, cur_name_table));
+}
+
+Result
+ConfigHolder::reload (ConstMemory      const filename,
+                      ConfigParserMode const mode)
+{
+    Ref<Config> const config = createConfig ();
+    if (!parseConfig (filename, config, mode)) {
+        logE_ (_func, "Could not parse ", filename, ", keeping the current config");
+        return Result::Failure;
+    }
+
+    setConfig (config);
+    return Result::Success;
+}
+
+ConfigHolder::ConfigHolder ()
+    : event_informer (this /* coderef_container */, &mutex),
+      update_key (0),
+      name_table (grab (new (std::nothrow) ConfigNameTable)),
+      name_table_num_configs (0)
+{
+}
+
+ConfigHolder::~ConfigHolder ()
+{
+    Config * const config = static_cast <Config*> (cur_config.get());
+    if (config)
+        config->unref ();
+}
+
+}
+
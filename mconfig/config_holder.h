@@ -0,0 +1,173 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__CONFIG_HOLDER__H__
+#define MCONFIG__CONFIG_HOLDER__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config.h>
+#include <mconfig/config_parser.h>
+#include <mconfig/config_diff.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Publishes immutable Config snapshots for hot reloading.
+//
+// Readers call getConfig() to pin the current snapshot for the duration of
+// a request. Everything obtained from the snapshot, including ConstMemory
+// returned by getString(), stays valid while the reference is held.
+// getConfig() never blocks: it takes a reference within an RCU-style read-side
+// section, which costs two atomic counter updates.
+//
+// Published snapshots must only be accessed through non-creating lookups
+// (getOption() and getSection() with create == false, typed getters,
+// ConfigPath) and other read-only methods. Those may run concurrently: they
+// never add, replace or remove entries, and lazily filled caches such as
+// decoded values are published lock-free. Creating lookups, setOption(),
+// Option::addValue()/removeValues() and Value::setValue() modify the tree and
+// would race with other readers of the snapshot.
+//
+// A reload builds a new Config and publishes it with a single pointer store.
+// The previous snapshot is released once all readers which could have seen it
+// have taken their references, and is destroyed when the last one is dropped.
+class ConfigHolder : public Object
+{
+public:
+    typedef Uint32 UpdateKey;
+
+    struct Events
+    {
+        // Called from the thread which has published @config. @update_key is
+        // incremented with every published snapshot.
+        void (*configReload) (Config    *config,
+                              UpdateKey  update_key,
+                              void      *cb_data);
+    };
+
+private:
+    StateMutex mutex;
+
+
+  // _____________________________ event_informer ______________________________
+
+private:
+    Informer_<Events> event_informer;
+
+    struct InformConfigReload_Data
+    {
+        Config    *config;
+        UpdateKey  update_key;
+    };
+
+    static void informConfigReload (Events * const events,
+                                    void   * const cb_data,
+                                    void   * const _data)
+    {
+        InformConfigReload_Data * const data = static_cast <InformConfigReload_Data*> (_data);
+        if (events->configReload)
+            events->configReload (data->config, data->update_key, cb_data);
+    }
+
+    void fireConfigReload (Config    * const config,
+                           UpdateKey   const update_key)
+    {
+        InformConfigReload_Data data = { config, update_key };
+        event_informer.informAll (informConfigReload, &data);
+    }
+
+public:
+    Informer_<Events>* getEventInformer ()
+    {
+        return &event_informer;
+    }
+
+
+  // _________________________________ snapshots _______________________________
+
+private:
+    // Serializes publishers.
+    Mutex update_mutex;
+
+    // Current snapshot. Holds a reference.
+    AtomicPointer cur_config;
+
+    // Readers announce themselves in num_readers [read_epoch & 1] for the time
+    // between loading cur_config and taking a reference to it.
+    AtomicInt read_epoch;
+    AtomicInt num_readers [2];
+
+    mt_mutex (update_mutex) UpdateKey update_key;
+
+    ConfigDiffNotifier diff_notifier;
+
+    // Shared by consecutive snapshots so that names are stored once across
+    // reloads. Names are never removed from a table, so names which have been
+    // dropped from the config would accumulate forever. The holder therefore
+    // starts a new table every NameTableLifetime configs: the snapshot created
+    // then interns all of its names again, and until the older snapshots are
+    // released both tables are kept in memory. Stale names are bounded by
+    // what NameTableLifetime reloads have introduced.
+    enum { NameTableLifetime = 64 };
+
+    mt_mutex (mutex) Ref<ConfigNameTable> name_table;
+    mt_mutex (mutex) Count name_table_num_configs;
+
+public:
+    // Returns the current snapshot, or NULL if nothing has been published yet.
+    // Lock-free. The snapshot must not be modified, see above.
+    Ref<Config> getConfig ();
+
+    // Publishes @config as the new snapshot. @config must not be modified
+    // afterwards. Delivers changes to diff notifier subscribers, then fires
+    // configReload.
+    void setConfig (Config *config);
+
+    // Parses @filename into a new snapshot and publishes it. The current
+    // snapshot is kept if parsing fails.
+    Result reload (ConstMemory      filename,
+                   ConfigParserMode mode = ConfigParserMode_Auto);
+
+    // Creates an empty Config suitable for publishing: arena-backed and using
+    // the holder's current name table.
+    Ref<Config> createConfig ();
+
+    // Subscribers receive only the changes under their path prefixes,
+    // in the thread which publishes the snapshot. Publishing is serialized, so
+    // change callbacks must not call setConfig() or reload().
+    ConfigDiffNotifier* getDiffNotifier ()
+    {
+        return &diff_notifier;
+    }
+
+    ConfigHolder ();
+
+    ~ConfigHolder ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_HOLDER__H__ */
+
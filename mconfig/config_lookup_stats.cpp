@@ -0,0 +1,332 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+
+#include <cstdio>
+#include <cstring>
+
+#include <mconfig/config_lookup_stats.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+namespace {
+
+// Returns false to skip the subtree of a section.
+typedef bool (*LookupStatVisitFunc) (ConfigLookupStat const *stat,
+                                     void                   *cb_data);
+
+class LookupStatsWalker
+{
+private:
+    LookupStatVisitFunc const visit_func;
+    void * const cb_data;
+
+    Byte *path_buf;
+    Size  path_len;
+    Size  path_size;
+
+    void appendPath (ConstMemory const mem)
+    {
+        if (path_size - path_len < mem.len()) {
+            Size new_size = (path_size ? path_size * 2 : 256);
+            while (new_size - path_len < mem.len())
+                new_size *= 2;
+
+            Byte * const new_buf = new (std::nothrow) Byte [new_size];
+            assert (new_buf);
+            if (path_len)
+                memcpy (new_buf, path_buf, path_len);
+
+            delete[] path_buf;
+            path_buf = new_buf;
+            path_size = new_size;
+        }
+
+        memcpy (path_buf + path_len, mem.mem(), mem.len());
+        path_len += mem.len();
+    }
+
+    // @index is -1 for sections which are not repeated.
+    void visitEntry (SectionEntry * const mt_nonnull entry,
+                     long           const index)
+    {
+        Size const parent_path_len = path_len;
+        if (path_len)
+            appendPath ("/");
+
+        appendPath (entry->getName());
+
+        if (index >= 0) {
+            char index_buf [32];
+            int const index_len = snprintf (index_buf, sizeof (index_buf), "[%ld]", index);
+            appendPath (ConstMemory (index_buf, (Size) index_len));
+        }
+
+        ConfigLookupStat stat;
+        stat.path = ConstMemory (path_buf, path_len);
+        stat.entry = entry;
+        stat.num_lookups = entry->getNumLookups ();
+        stat.num_misses = 0;
+        stat.num_bad_values = 0;
+
+        if (entry->getType() == SectionEntry::Type_Section) {
+            Section * const section = static_cast <Section*> (entry);
+            stat.num_misses = section->getNumMisses ();
+
+            if (visit_func (&stat, cb_data))
+                visitSectionBody (section);
+        } else {
+            stat.num_bad_values = static_cast <Option*> (entry)->getNumBadValues ();
+            visit_func (&stat, cb_data);
+        }
+
+        path_len = parent_path_len;
+    }
+
+public:
+    void visitSectionBody (Section * const mt_nonnull section)
+    {
+        Section::iterator iter (*section);
+        while (!iter.done()) {
+            SectionEntry * const entry = iter.next ();
+            if (entry->getType() != SectionEntry::Type_Section) {
+                visitEntry (entry, -1);
+                continue;
+            }
+
+          // Repeated sections are visited in order, starting from the first one.
+            Section *sibling = static_cast <Section*> (entry);
+            if (sibling->getPrevSibling())
+                continue;
+
+            if (!sibling->getNextSibling()) {
+                visitEntry (sibling, -1);
+                continue;
+            }
+
+            for (long index = 0; sibling; sibling = sibling->getNextSibling(), ++index)
+                visitEntry (sibling, index);
+        }
+    }
+
+    LookupStatsWalker (LookupStatVisitFunc   const visit_func,
+                       void                * const cb_data)
+        : visit_func (visit_func),
+          cb_data    (cb_data),
+          path_buf   (NULL),
+          path_len   (0),
+          path_size  (0)
+    {
+    }
+
+    ~LookupStatsWalker ()
+    {
+        delete[] path_buf;
+    }
+};
+
+struct CallbackVisitData
+{
+    ConfigLookupStatCallback cb;
+    void *cb_data;
+};
+
+bool callbackVisit (ConfigLookupStat const * const stat,
+                    void                   * const _data)
+{
+    CallbackVisitData * const data = static_cast <CallbackVisitData*> (_data);
+    data->cb (stat, data->cb_data);
+    return true;
+}
+
+Uint64 getSubtreeLookups (Section * const mt_nonnull section)
+{
+    Uint64 num_lookups = section->getNumLookups ();
+
+    Section::iterator iter (*section);
+    while (!iter.done()) {
+        SectionEntry * const entry = iter.next ();
+        if (entry->getType() == SectionEntry::Type_Section)
+            num_lookups += getSubtreeLookups (static_cast <Section*> (entry));
+        else
+            num_lookups += entry->getNumLookups ();
+    }
+
+    return num_lookups;
+}
+
+// Keeps the @max_hot entries with the most lookups, sorted by the number of
+// lookups in descending order.
+struct HotList
+{
+    struct HotEntry
+    {
+        Uint32 num_lookups;
+        Byte  *path_buf;
+        Size   path_len;
+        bool   is_section;
+    };
+
+    HotEntry *entries;
+    Count     num_entries;
+    Count     max_entries;
+
+    HotList (Count const max_entries)
+        : entries     (max_entries ? new (std::nothrow) HotEntry [max_entries] : NULL),
+          num_entries (0),
+          max_entries (max_entries)
+    {
+    }
+
+    ~HotList ()
+    {
+        for (Count i = 0; i < num_entries; ++i)
+            delete[] entries [i].path_buf;
+
+        delete[] entries;
+    }
+};
+
+bool hotVisit (ConfigLookupStat const * const stat,
+               void                   * const _hot_list)
+{
+    HotList * const hot_list = static_cast <HotList*> (_hot_list);
+
+    if (stat->num_lookups == 0)
+        return true;
+
+    Count pos = hot_list->num_entries;
+    while (pos > 0 && hot_list->entries [pos - 1].num_lookups < stat->num_lookups)
+        --pos;
+
+    if (pos >= hot_list->max_entries)
+        return true;
+
+    if (hot_list->num_entries == hot_list->max_entries) {
+        --hot_list->num_entries;
+        delete[] hot_list->entries [hot_list->num_entries].path_buf;
+    }
+
+    memmove (hot_list->entries + pos + 1,
+             hot_list->entries + pos,
+             (hot_list->num_entries - pos) * sizeof (HotList::HotEntry));
+    ++hot_list->num_entries;
+
+    HotList::HotEntry &hot_entry = hot_list->entries [pos];
+    hot_entry.num_lookups = stat->num_lookups;
+    hot_entry.is_section = (stat->entry->getType() == SectionEntry::Type_Section);
+    hot_entry.path_len = stat->path.len();
+    hot_entry.path_buf = new (std::nothrow) Byte [stat->path.len()];
+    assert (hot_entry.path_buf);
+    memcpy (hot_entry.path_buf, stat->path.mem(), stat->path.len());
+
+    return true;
+}
+
+bool problemVisit (ConfigLookupStat const * const stat,
+                   void                   * const _outs)
+{
+    OutputStream * const outs = static_cast <OutputStream*> (_outs);
+
+    if (stat->num_misses)
+        outs->print ("miss ", stat->num_misses, " ", stat->path, "/\n");
+
+    if (stat->num_bad_values)
+        outs->print ("bad ", stat->num_bad_values, " ", stat->path, "\n");
+
+    return true;
+}
+
+bool deadVisit (ConfigLookupStat const * const stat,
+                void                   * const _outs)
+{
+    OutputStream * const outs = static_cast <OutputStream*> (_outs);
+
+    if (stat->entry->getType() == SectionEntry::Type_Section) {
+        if (getSubtreeLookups (static_cast <Section*> (stat->entry)) == 0) {
+            outs->print ("dead ", stat->path, "/\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    if (stat->num_lookups == 0)
+        outs->print ("dead ", stat->path, "\n");
+
+    return true;
+}
+
+}
+
+void getConfigLookupStats (Config                   * const mt_nonnull config,
+                           ConfigLookupStatCallback   const cb,
+                           void                     * const cb_data)
+{
+    CallbackVisitData data;
+    data.cb = cb;
+    data.cb_data = cb_data;
+
+    LookupStatsWalker walker (callbackVisit, &data);
+    walker.visitSectionBody (config->getRootSection());
+}
+
+void dumpConfigLookupStats (Config       * const mt_nonnull config,
+                            OutputStream * const mt_nonnull outs,
+                            Count          const max_hot)
+{
+    Section * const root_section = config->getRootSection();
+
+    {
+        HotList hot_list (max_hot);
+        {
+            LookupStatsWalker walker (hotVisit, &hot_list);
+            walker.visitSectionBody (root_section);
+        }
+
+        for (Count i = 0; i < hot_list.num_entries; ++i) {
+            HotList::HotEntry const &hot_entry = hot_list.entries [i];
+            outs->print ("hot ", hot_entry.num_lookups, " ",
+                         ConstMemory (hot_entry.path_buf, hot_entry.path_len),
+                         (hot_entry.is_section ? "/\n" : "\n"));
+        }
+    }
+
+    if (root_section->getNumMisses())
+        outs->print ("miss ", root_section->getNumMisses(), " /\n");
+
+    {
+        LookupStatsWalker walker (problemVisit, outs);
+        walker.visitSectionBody (root_section);
+    }
+
+    {
+        LookupStatsWalker walker (deadVisit, outs);
+        walker.visitSectionBody (root_section);
+    }
+
+    outs->flush ();
+}
+
+}
+
@@ -0,0 +1,82 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+
+#ifndef MCONFIG__CONFIG_LOOKUP_STATS__H__
+#define MCONFIG__CONFIG_LOOKUP_STATS__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Lookup counters are collected while Config::setLookupStatsEnabled (true) is
+// in effect. Hits are counted on the entry which a path resolves to, misses on
+// the deepest section which the lookup has reached. Lookups through
+// Section::getSectionEntry(), Config's getters and ConfigPath are counted.
+// Counters are updated with atomic increments without locking. They saturate
+// at StatCounter::Max rather than wrap around.
+
+struct ConfigLookupStat
+{
+    // Full path of the entry. Repeated sections have their zero-based position
+    // appended, e.g. "mod_file/dir[1]" for the second "dir" section.
+    ConstMemory   path;
+    SectionEntry *entry;
+
+    Uint32 num_lookups;
+    // Sections only: lookups of missing entries in the section.
+    Uint32 num_misses;
+    // Options only: failed conversions in Config's typed getters.
+    Uint32 num_bad_values;
+};
+
+// stat->path is only valid for the duration of the call.
+typedef void (*ConfigLookupStatCallback) (ConfigLookupStat const *stat,
+                                          void                   *cb_data);
+
+// Calls @cb for every section and option of @config, parents before children.
+// The tree must not be modified concurrently.
+void getConfigLookupStats (Config                   * mt_nonnull config,
+                           ConfigLookupStatCallback   cb,
+                           void                     *cb_data);
+
+// Writes a report to @outs, one entry per line:
+//
+//     hot <lookups> <path>    - up to @max_hot most looked-up entries, options
+//     hot <lookups> <path>/     and sections ranked together;
+//     miss <misses> <path>/   - sections with lookups of missing entries;
+//     bad <count> <path>      - options with values of a wrong type;
+//     dead <path>             - options which have never been looked up;
+//     dead <path>/            - sections with no lookups in their subtree.
+void dumpConfigLookupStats (Config       * mt_nonnull config,
+                            OutputStream * mt_nonnull outs,
+                            Count         max_hot = 32);
+
+}
+
+
+#endif /* MCONFIG__CONFIG_LOOKUP_STATS__H__ */
+
@@ -0,0 +1,135 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+
+#ifndef MCONFIG__CONFIG_MEMORY_STATS__H__
+#define MCONFIG__CONFIG_MEMORY_STATS__H__
+
+
+#include <libmary/libmary.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Memory footprint of a Config, of a part of it, or of a Varlist.
+// See Config::getMemoryStats() and Varlist::getMemoryStats().
+struct ConfigMemoryStats
+{
+  // Node counts.
+
+    Count num_sections;
+    Count num_options;
+    Count num_values;
+    Count num_attributes;
+    // Varlist only.
+    Count num_vars;
+    Count num_section_specs;
+
+  // Byte counts.
+
+    // Node objects, including hash tables embedded into them.
+    Size node_bytes;
+    // Names and values owned by the nodes. Names interned in a ConfigNameTable
+    // are accounted in name_table_bytes.
+    Size string_bytes;
+    // Estimated bucket storage of hash tables: one pointer per entry.
+    // Per-table overhead is part of node_bytes.
+    Size hash_bytes;
+    Count num_hashes;
+
+    // Separate heap allocations made for nodes and strings. Nodes and strings
+    // allocated from an arena are accounted in arena_* fields instead.
+    Count num_allocs;
+
+  // Filled for totals only.
+
+    Count arena_chunks;
+    // Memory reserved by the arena, including unused tails of chunks.
+    Size  arena_bytes;
+    // Part of arena_bytes taken by nodes and strings.
+    Size  arena_used_bytes;
+
+    Count num_names;
+    Size  name_table_bytes;
+
+    // Heap memory held by the nodes.
+    Size getTotalBytes () const
+    {
+        return (arena_chunks ? arena_bytes : node_bytes + string_bytes)
+               + hash_bytes
+               + name_table_bytes;
+    }
+
+    void add (ConfigMemoryStats const &stats)
+    {
+        num_sections      += stats.num_sections;
+        num_options       += stats.num_options;
+        num_values        += stats.num_values;
+        num_attributes    += stats.num_attributes;
+        num_vars          += stats.num_vars;
+        num_section_specs += stats.num_section_specs;
+
+        node_bytes   += stats.node_bytes;
+        string_bytes += stats.string_bytes;
+        hash_bytes   += stats.hash_bytes;
+        num_hashes   += stats.num_hashes;
+        num_allocs   += stats.num_allocs;
+
+        arena_chunks     += stats.arena_chunks;
+        arena_bytes      += stats.arena_bytes;
+        arena_used_bytes += stats.arena_used_bytes;
+
+        num_names        += stats.num_names;
+        name_table_bytes += stats.name_table_bytes;
+    }
+
+    void reset ()
+    {
+        *this = ConfigMemoryStats ();
+    }
+
+    ConfigMemoryStats ()
+        : num_sections      (0),
+          num_options       (0),
+          num_values        (0),
+          num_attributes    (0),
+          num_vars          (0),
+          num_section_specs (0),
+          node_bytes        (0),
+          string_bytes      (0),
+          hash_bytes        (0),
+          num_hashes        (0),
+          num_allocs        (0),
+          arena_chunks      (0),
+          arena_bytes       (0),
+          arena_used_bytes  (0),
+          num_names         (0),
+          name_table_bytes  (0)
+    {
+    }
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_MEMORY_STATS__H__ */
+
@@ -0,0 +1,93 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <new>
+
+#include <mconfig/config_name_table.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+ConfigNameKey
+ConfigNameTable::intern (ConfigNameKey const &name)
+{
+    if (thread_safe)
+        mutex.lock ();
+
+    Name *entry = name_hash.lookup (name);
+    if (!entry) {
+        entry = new (arena.alloc (sizeof (Name))) Name;
+        entry->key = ConfigNameKey (arena.copy (name.mem), name.hash);
+        name_hash.add (entry);
+        ++num_names;
+    }
+
+    ConfigNameKey const key = entry->key;
+
+    if (thread_safe)
+        mutex.unlock ();
+
+    return key;
+}
+
+Count
+ConfigNameTable::getNumNames ()
+{
+    if (thread_safe)
+        mutex.lock ();
+    Count const res = num_names;
+    if (thread_safe)
+        mutex.unlock ();
+
+    return res;
+}
+
+void
+ConfigNameTable::getMemoryStats (ConfigMemoryStats * const mt_nonnull stats)
+{
+    ConfigMemoryStats arena_stats;
+
+    if (thread_safe)
+        mutex.lock ();
+    arena.getMemoryStats (&arena_stats);
+    Count const cur_num_names = num_names;
+    if (thread_safe)
+        mutex.unlock ();
+
+    stats->num_names += cur_num_names;
+    stats->name_table_bytes += arena_stats.arena_bytes + cur_num_names * sizeof (void*);
+}
+
+ConfigNameTable::ConfigNameTable (bool const thread_safe)
+    : thread_safe (thread_safe),
+      num_names   (0)
+{
+}
+
+ConfigNameTable::~ConfigNameTable ()
+{
+  // Names are allocated from the arena, which is freed as a whole.
+    name_hash.clear ();
+}
+
+}
+
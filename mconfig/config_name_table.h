@@ -0,0 +1,158 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__CONFIG_NAME_TABLE__H__
+#define MCONFIG__CONFIG_NAME_TABLE__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config_arena.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Name of a section entry or of an attribute together with its hash.
+struct ConfigNameKey
+{
+    ConstMemory mem;
+    Uint32      hash;
+
+    // FNV-1a
+    static Uint32 computeHash (ConstMemory const mem)
+    {
+        Uint32 hash = 2166136261U;
+        for (Size i = 0; i < mem.len(); ++i) {
+            hash ^= (Uint32) mem.mem() [i];
+            hash *= 16777619U;
+        }
+
+        return hash;
+    }
+
+    explicit ConfigNameKey (ConstMemory const mem)
+        : mem  (mem),
+          hash (computeHash (mem))
+    {
+    }
+
+    ConfigNameKey (ConstMemory const mem,
+                   Uint32      const hash)
+        : mem  (mem),
+          hash (hash)
+    {
+    }
+
+    ConfigNameKey ()
+        : hash (computeHash (ConstMemory()))
+    {
+    }
+};
+
+// Interned names are compared by identity first.
+class ConfigNameKeyComparator
+{
+public:
+    static bool equals (ConfigNameKey const &left,
+                        ConfigNameKey const &right)
+    {
+        if (left.hash != right.hash ||
+            left.mem.len() != right.mem.len())
+        {
+            return false;
+        }
+
+        if (left.mem.mem() == right.mem.mem())
+            return true;
+
+        return memcmp (left.mem.mem(), right.mem.mem(), left.mem.len()) == 0;
+    }
+};
+
+class ConfigNameKeyHasher
+{
+public:
+    static Uint32 hash (ConfigNameKey const &key)
+    {
+        return key.hash;
+    }
+};
+
+// Table of unique section, option and attribute names. Every Config has one,
+// and a table may be shared between several Configs. Entries of a Config
+// refer to the names in the table, so they must not outlive it.
+//
+// Names are never removed from the table.
+class ConfigNameTable : public Object
+{
+private:
+    Mutex mutex;
+
+    // The mutex is not taken if false.
+    mt_const bool thread_safe;
+
+    struct Name : public HashEntry<>
+    {
+        ConfigNameKey key;
+    };
+
+    typedef Hash< Name,
+                  ConfigNameKey,
+                  MemberExtractor< Name,
+                                   ConfigNameKey,
+                                   &Name::key >,
+                  ConfigNameKeyComparator,
+                  ConfigNameKeyHasher >
+            NameHash;
+
+    mt_mutex (mutex) ConfigArena arena;
+    mt_mutex (mutex) NameHash name_hash;
+    mt_mutex (mutex) Count num_names;
+
+public:
+    // Returns the interned copy of @name, which stays valid for the lifetime
+    // of the table. Thread-safe if the table is.
+    ConfigNameKey intern (ConfigNameKey const &name);
+
+    ConfigNameKey intern (ConstMemory const name)
+    {
+        return intern (ConfigNameKey (name));
+    }
+
+    Count getNumNames ();
+
+    // Adds the number of names and the table's memory to @stats
+    // (num_names and name_table_bytes). Thread-safe if the table is.
+    void getMemoryStats (ConfigMemoryStats * mt_nonnull stats);
+
+    // A table which is not @thread_safe may only be used by one thread at
+    // a time, which saves locking for Configs which are private to a thread.
+    ConfigNameTable (bool thread_safe = true);
+
+    ~ConfigNameTable ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_NAME_TABLE__H__ */
+
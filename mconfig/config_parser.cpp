@@ -18,7 +18,6 @@
 
 
 #include <libmary/libmary.h>
-#include <cctype>
 
 #include <pargen/parser.h>
 
@@ -28,6 +27,9 @@
 #include <scruffy/checkpoint_tracker.h>
 
 #include <mconfig/mconfig_pargen.h>
+#include <mconfig/mapped_file.h>
+#include <mconfig/config_builder.h>
+#include <mconfig/native_config_parser.h>
 #include <mconfig/config_parser.h>
 
 
@@ -37,16 +39,77 @@ namespace MConfig {
 
 static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
 
-class ConfigParser
+// Counts checkpoints for ParseStats. A cancelled checkpoint means that pargen
+// backtracks to try another alternative.
+class CountingCheckpointTracker : public Scruffy::CheckpointTracker
 {
 public:
-    List<Section*> sections;
+    Count num_checkpoints;
+    Count num_backtracks;
 
-    Scruffy::CheckpointTracker checkpoint_tracker;
+  // Pargen::LookupData interface
 
-    ConfigParser (Config * const config)
+    void newCheckpoint ()
     {
-	sections.append (config->getRootSection());
+	++num_checkpoints;
+	Scruffy::CheckpointTracker::newCheckpoint ();
+    }
+
+    void cancelCheckpoint ()
+    {
+	++num_backtracks;
+	Scruffy::CheckpointTracker::cancelCheckpoint ();
+    }
+
+    CountingCheckpointTracker ()
+	: num_checkpoints (0),
+	  num_backtracks  (0)
+    {
+    }
+};
+
+// Pargen callback data.
+class ConfigParserContext
+{
+public:
+    ConfigEvents const *events;
+    void *cb_data;
+
+    CountingCheckpointTracker checkpoint_tracker;
+
+    // Sections for which beginSection has been reported and endSection has not.
+    Count num_open_sections;
+
+    // Holds the key and the values of the current option, so that they're
+    // passed to the events without allocating a string for each of them.
+    Byte *words_buf;
+    Size  words_buf_size;
+
+    Byte* getWordsBuf (Size const len)
+    {
+	if (words_buf_size < len) {
+	    delete[] words_buf;
+	    words_buf_size = (len > 2 * words_buf_size ? len : 2 * words_buf_size);
+	    words_buf = new (std::nothrow) Byte [words_buf_size];
+	    assert (words_buf);
+	}
+
+	return words_buf;
+    }
+
+    ConfigParserContext (ConfigEvents const * const events,
+			 void               * const cb_data)
+	: events  (events),
+	  cb_data (cb_data),
+	  num_open_sections (0),
+	  words_buf (NULL),
+	  words_buf_size (0)
+    {
+    }
+
+    ~ConfigParserContext ()
+    {
+	delete[] words_buf;
     }
 };
 
@@ -86,163 +149,174 @@ mconfig_word_token_match_func (ConstMemory const &token_mem,
     return true;
 }
 
-static bool
-whitespaceBetweenWordsNeeded (ConstMemory const &left,
-			      ConstMemory const &right)
+static Size
+wordsLength (IntrusiveList<MConfig_Word> * const mt_nonnull words)
 {
-    if (left .len() == 0 ||
-	right.len() == 0)
-    {
-	return false;
-    }
+    Size str_len = 0;
+    ConstMemory prv_word;
+    IntrusiveList<MConfig_Word>::iterator iter (*words);
+    while (!iter.done ()) {
+	MConfig_Word * const word_ = iter.next();
 
-    if (isalnum (left.mem() [left.len() - 1]) &&
-	isalnum (right.mem() [0]))
-    {
-	return true;
+	ConstMemory const word = unquoteWord (word_->any_token->token);
+	str_len += word.len();
+
+	if (whitespaceBetweenWordsNeeded (prv_word, word))
+	    ++str_len;
+
+	prv_word = word;
     }
 
-    return false;
+    return str_len;
 }
 
-static Ref<String>
-wordsToString (IntrusiveList<MConfig_Word> * const mt_nonnull words)
+// Writes wordsLength (@words) bytes to @buf.
+static ConstMemory
+wordsToMem (IntrusiveList<MConfig_Word> * const mt_nonnull words,
+	    Byte                        * const buf)
 {
-    Size str_len = 0;
-    {
-	ConstMemory prv_word;
-	IntrusiveList<MConfig_Word>::iterator iter (*words);
-	while (!iter.done ()) {
-	    MConfig_Word * const word_ = iter.next();
-
-	    ConstMemory word = word_->any_token->token;
-	    // Stripping quotes from string literals.
-	    if (word.len() && word.mem() [0] == '"') {
-		assert (word.len() >= 2);
-		word = word.region (1, word.len() - 2);
-	    }
-
-	    str_len += word.len();
+    Size pos = 0;
+    ConstMemory prv_word;
+    IntrusiveList<MConfig_Word>::iterator iter (*words);
+    while (!iter.done ()) {
+	MConfig_Word * const word_ = iter.next();
+
+	ConstMemory const word = unquoteWord (word_->any_token->token);
+	logD (mconfig, _func, "word: ", word);
+
+	if (whitespaceBetweenWordsNeeded (prv_word, word)) {
+	    buf [pos] = ' ';
+	    ++pos;
+	}
 
-	    if (whitespaceBetweenWordsNeeded (prv_word, word))
-		++str_len;
+	memcpy (buf + pos, word.mem(), word.len());
+	pos += word.len();
 
-	    prv_word = word;
-	}
+	prv_word = word;
     }
 
-    logD (mconfig, _func, "str_len: ", str_len);
-
-    Ref<String> str = grab (new String (str_len));
+    logD (mconfig, _func, "str: ", ConstMemory (buf, pos));
 
-    {
-	Size pos = 0;
-	ConstMemory prv_word;
-	IntrusiveList<MConfig_Word>::iterator iter (*words);
-	while (!iter.done ()) {
-	    MConfig_Word * const word_ = iter.next();
-
-	    ConstMemory word = word_->any_token->token;
-	    logD (mconfig, _func, "word: ", word);
-	    // Stripping quotes from string literals.
-	    if (word.len() && word.mem() [0] == '"') {
-		assert (word.len() >= 2);
-		word = word.region (1, word.len() - 2);
-	    }
+    return ConstMemory (buf, pos);
+}
 
-	    if (whitespaceBetweenWordsNeeded (prv_word, word)) {
-		str->mem().mem() [pos] = ' ';
-		++pos;
-	    }
+// Undoes mconfig_begin_section() when pargen backtracks out of the section
+// rule. section-body is matched after the begin callback has fired, so the
+// rule may still fail.
+class Cancellable_BeginSection : public Scruffy::Cancellable
+{
+private:
+    ConfigParserContext * const ctx;
+    // Value of ctx->num_open_sections right after the section has begun.
+    Count const depth;
 
-	    memcpy (str->mem().mem() + pos, word.mem(), word.len());
-	    pos += word.len();
+public:
+    void cancel ()
+    {
+      // Sections which have begun later are cancelled first, so the section
+      // is still open if and only if it is the innermost open one.
+	if (ctx->num_open_sections == depth) {
+	    if (ctx->events->endSection)
+		ctx->events->endSection (ctx->cb_data);
 
-	    prv_word = word;
+	    --ctx->num_open_sections;
 	}
-    }
 
-    logD (mconfig, _func, "str: ", str);
-
-    return str;
-}
-
-static Ref<String>
-keyToString (MConfig_Key * const key)
-{
-    if (!key)
-	return grab (new String());
+	if (ctx->events->cancelSection)
+	    ctx->events->cancelSection (ctx->cb_data);
+    }
 
-    return wordsToString (&key->words);
-}
+    Cancellable_BeginSection (ConfigParserContext * const ctx,
+			      Count                 const depth)
+	: ctx   (ctx),
+	  depth (depth)
+    {
+    }
+};
 
 bool
 mconfig_begin_section (MConfig_Section       * const section,
 		       Pargen::ParserControl * const /* parser_control */,
 		       void                  * const _self)
 {
-    ConfigParser * const self = static_cast <ConfigParser*> (_self);
+    ConfigParserContext * const self = static_cast <ConfigParserContext*> (_self);
 
 //    Ref<String> const section_name = keyToString (section->name);
     ConstMemory const section_name = section->name ? ConstMemory (section->name->any_token->token) : ConstMemory();
 
     logD (mconfig, _func, "section: ", section_name);
 
-// Section value replacement was disabled to allow lists of sections
-// with the same name (for Moment's mod_file).
-//  Section *opts_section = self->sections.getLast()->getSection (section_name->mem());
-    Section *opts_section = NULL;
-    if (!opts_section) {
-//	opts_section = new Section (keyToString (section->name)->mem());
-	opts_section = new Section (section_name);
-	self->sections.getLast()->addSection (opts_section);
+    Count num_attrs = 0;
+    {
+        IntrusiveList<MConfig_Attribute>::iterator iter (section->attributes);
+        while (!iter.done()) {
+            iter.next();
+            ++num_attrs;
+        }
     }
 
+    ConfigAttributeDesc * const attrs = (num_attrs ? new (std::nothrow) ConfigAttributeDesc [num_attrs] : NULL);
     {
+        Count attr_idx = 0;
         IntrusiveList<MConfig_Attribute>::iterator iter (section->attributes);
         while (!iter.done()) {
             MConfig_Attribute * const attr = iter.next();
+            ConfigAttributeDesc &attr_desc = attrs [attr_idx];
+            ++attr_idx;
 
-            ConstMemory attr_name;
-            ConstMemory attr_value;
-            bool has_value = false;
+            attr_desc.name = ConstMemory();
+            attr_desc.value = ConstMemory();
+            attr_desc.has_value = false;
 
             switch (attr->attribute_type) {
                 case MConfig_Attribute::t_NameValue: {
                     MConfig_Attribute_NameValue * const attr__name_value =
                             static_cast <MConfig_Attribute_NameValue*> (attr);
-                    has_value = true;
+                    attr_desc.has_value = true;
                     if (attr__name_value->name)
-                        attr_name = attr__name_value->name->any_token->token;
+                        attr_desc.name = attr__name_value->name->any_token->token;
                     if (attr__name_value->value)
-                        attr_value = attr__name_value->value->any_token->token;
+                        attr_desc.value = attr__name_value->value->any_token->token;
                 } break;
                 case MConfig_Attribute::t_Name: {
                     MConfig_Attribute_Name * const attr__name =
                             static_cast <MConfig_Attribute_Name*> (attr);
                     if (attr__name->name)
-                        attr_name = attr__name->name->any_token->token;
+                        attr_desc.name = attr__name->name->any_token->token;
                 } break;
                 default:
                     unreachable ();
             }
-
-            Attribute *opts_attr = opts_section->getAttribute (attr_name);
-            if (opts_attr) {
-                opts_attr->setValue (has_value, attr_value);
-            } else {
-                opts_attr = new (std::nothrow) Attribute (attr_name, has_value, attr_value);
-                assert (opts_attr);
-                opts_section->addAttribute (opts_attr);
-            }
         }
     }
 
-    self->sections.append (opts_section);
-    self->checkpoint_tracker.addUnconditionalCancellable (
-	    st_grab (new (std::nothrow) Scruffy::Cancellable_ListElement<Section*> (
-		    self->sections,
-		    self->sections.last)));
+    bool res = true;
+    if (self->events->beginSection)
+        res = self->events->beginSection (section_name, attrs, num_attrs, self->cb_data);
+
+    delete[] attrs;
+
+    if (res) {
+	++self->num_open_sections;
+	self->checkpoint_tracker.addUnconditionalCancellable (
+		st_grab (new (std::nothrow) Cancellable_BeginSection (self, self->num_open_sections)));
+    }
+
+    return res;
+}
+
+bool
+mconfig_end_section (MConfig_Section       * const /* section */,
+		     Pargen::ParserControl * const /* parser_control */,
+		     void                  * const _self)
+{
+    ConfigParserContext * const self = static_cast <ConfigParserContext*> (_self);
+
+    assert (self->num_open_sections > 0);
+    --self->num_open_sections;
+
+    if (self->events->endSection)
+        return self->events->endSection (self->cb_data);
 
     return true;
 }
@@ -252,14 +326,7 @@ mconfig_accept_option (MConfig_Option         * const option,
 		       Pargen::ParserControl  * const /* parser_control */,
 		       void                   * const _self)
 {
-    ConfigParser * const self = static_cast <ConfigParser*> (_self);
-
-    if (self->sections.isEmpty()) {
-	logE_ (_func, "option not within a section");
-	return false;
-    }
-
-    Section * const section = self->sections.getLast();
+    ConfigParserContext * const self = static_cast <ConfigParserContext*> (_self);
 
     MConfig_Option_KeyValue *option__key_value = NULL;
 
@@ -277,66 +344,115 @@ mconfig_accept_option (MConfig_Option         * const option,
 	    unreachable ();
     }
 
-    Ref<String> key = keyToString (key_elem);
+    Count num_values = 0;
+    if (option__key_value) {
+	MConfig_Value *value = option__key_value->value;
+	while (value) {
+	    ++num_values;
+	    if (value->value_type == MConfig_Value::t_List)
+		value = static_cast <MConfig_Value_List*> (value)->value;
+	    else
+		value = NULL;
+	}
+    }
 
-    logD (mconfig, _func, "option: ", key);
+    typedef IntrusiveList<MConfig_Word> WordList;
 
-    Option *opts_option = section->getOption (key->mem());
-    if (opts_option) {
-	opts_option->removeValues ();
-    } else {
-	opts_option = new Option (key->mem());
-	self->sections.getLast()->addOption (opts_option);
-    }
+    WordList ** const value_words = (num_values ? new (std::nothrow) WordList* [num_values] : NULL);
+    ConstMemory * const values = (num_values ? new (std::nothrow) ConstMemory [num_values] : NULL);
 
     if (option__key_value) {
+	Count value_idx = 0;
 	MConfig_Value *value = option__key_value->value;
 	for (;;) {
 	    switch (value->value_type) {
 		case MConfig_Value::t_List: {
 		    MConfig_Value_List * const value__list = static_cast <MConfig_Value_List*> (value);
-		    logD (mconfig, _func, "value: ", wordsToString (&value__list->words));
-		    opts_option->addValue (wordsToString (&value__list->words)->mem());
+		    value_words [value_idx] = &value__list->words;
 		    value = value__list->value;
 		    logD (mconfig, _func, "new value: 0x", fmt_hex, (UintPtr) value);
 		} break;
 		case MConfig_Value::t_Word: {
 		    MConfig_Value_Word * const value__word = static_cast <MConfig_Value_Word*> (value);
-		    logD (mconfig, _func, "value: ", wordsToString (&value__word->words));
-		    opts_option->addValue (wordsToString (&value__word->words)->mem());
+		    value_words [value_idx] = &value__word->words;
 		    value = NULL;
 		} break;
 		default:
 		    unreachable ();
 	    }
 
+	    ++value_idx;
+
 	    if (!value)
 		break;
 	}
     }
 
+    Size total_len = (key_elem ? wordsLength (&key_elem->words) : 0);
+    for (Count i = 0; i < num_values; ++i)
+	total_len += wordsLength (value_words [i]);
+
+    Byte * const buf = self->getWordsBuf (total_len);
+    Size pos = 0;
+
+    ConstMemory key;
+    if (key_elem) {
+	key = wordsToMem (&key_elem->words, buf);
+	pos += key.len();
+    }
+
+    logD (mconfig, _func, "option: ", key);
+
+    for (Count i = 0; i < num_values; ++i) {
+	values [i] = wordsToMem (value_words [i], buf + pos);
+	pos += values [i].len();
+
+	logD (mconfig, _func, "value: ", values [i]);
+    }
+
+    bool res = true;
+    if (self->events->option)
+	res = self->events->option (key, values, num_values, self->cb_data);
+
+    delete[] values;
+    delete[] value_words;
+
     logD (mconfig, _func, "done");
 
-    return true;
+    return res;
 }
 
-Result parseConfig (ConstMemory   const filename,
-		    Config      * const config)
+// If @grammar is NULL, a one-off grammar is created and parsing is done in AST
+// mode, which allows to dump the parse tree for debugging.
+static Result parseConfig_pargen (File                 * const mt_nonnull file,
+				  ConstMemory            const filename,
+				  ConfigEvents   const * const events,
+				  void                 * const cb_data,
+				  Pargen::Grammar      *grammar,
+				  Pargen::ParserConfig *parser_config,
+				  ParseStats           * const stats)
 {
 //    logD_ (_func, "filename: ", filename);
 
 try {
-    StRef<Pargen::Grammar> const grammar = create_mconfig_grammar ();
+    bool const ast_mode = !grammar;
 
-    NativeFile file;
-    if (!file.open (filename, 0 /* open_flags */, FileAccessMode::ReadOnly)) {
-        logE_ (_func, "Could not open ", filename, ": ", exc->toString());
-        return Result::Failure;
+    StRef<Pargen::Grammar> tmp_grammar;
+    StRef<Pargen::ParserConfig> tmp_parser_config;
+    if (ast_mode) {
+	tmp_grammar = create_mconfig_grammar ();
+	tmp_parser_config = Pargen::createParserConfig (false /* upwards_jumps */);
+
+	grammar = tmp_grammar;
+	parser_config = tmp_parser_config;
     }
 
-//    file = MyCpp::grab (new MyCpp::CachedFile (file, (1 << 14) /* page_size */, 64 /* max_pages */));
+    if (stats)
+	stats->used_preprocessor = true;
+
+    ParsePhaseTimer pp_timer (stats, ParseStats::Phase_Preprocess);
 
-    StRef<Scruffy::CppPreprocessor> const preprocessor = st_grab (new (std::nothrow) Scruffy::CppPreprocessor (&file));
+    StRef<Scruffy::CppPreprocessor> const preprocessor = st_grab (new (std::nothrow) Scruffy::CppPreprocessor (file));
     if (!preprocessor->performPreprocessing ()) {
         logE_ (_func, "Preprocessing failed: ", exc->toString());
         return Result::Failure;
@@ -345,6 +461,15 @@ try {
     StRef< List_< StRef<Scruffy::PpItem>, StReferenced > > pp_items =
 	    preprocessor->getPpItems ();
 
+    pp_timer.stop ();
+
+    if (stats) {
+	for (List_< StRef<Scruffy::PpItem>, StReferenced >::Element *el = pp_items->first; el; el = el->next)
+	    ++stats->num_pp_items;
+    }
+
+    ParsePhaseTimer parse_timer (stats, ParseStats::Phase_Parse);
+
     StRef<Scruffy::PpItemStream> pp_stream =
 	    st_grab (static_cast <Scruffy::PpItemStream*> (
 		    new (std::nothrow) Scruffy::ListPpItemStream (pp_items->first, Pargen::FilePosition ())));
@@ -354,7 +479,7 @@ try {
 
     token_stream->setNewlineReplacement (";");
 
-    ConfigParser config_parser (config);
+    ConfigParserContext config_parser (events, cb_data);
 
     StRef<StReferenced> mconfig_elem_container;
     Pargen::ParserElement *mconfig_elem = NULL;
@@ -365,18 +490,22 @@ try {
 		   &mconfig_elem,
                    &mconfig_elem_container,
 		   "default",
-		   // TODO Set 'upwards_jumps' to true for non-AST mode.
-		   Pargen::createParserConfig (false /* upwards_jumps */),
+		   parser_config,
 		   false /* debug_dump */);
 
-    file.close (true /* flush_data */);
-
     ConstMemory token;
     if (!token_stream->getNextToken (&token)) {
         logE_ (_func, "Read error: ", exc->toString());
         return Result::Failure;
     }
 
+    parse_timer.stop ();
+
+    if (stats) {
+	stats->num_checkpoints = config_parser.checkpoint_tracker.num_checkpoints;
+	stats->num_backtracks  = config_parser.checkpoint_tracker.num_backtracks;
+    }
+
     if (mconfig_elem == NULL ||
 	token.len() > 0)
     {
@@ -384,7 +513,7 @@ try {
 	return Result::Failure;
     }
 
-    if (logLevelOn (mconfig, LogLevel::Debug)) {
+    if (ast_mode && logLevelOn (mconfig, LogLevel::Debug)) {
 	dump_mconfig_grammar (static_cast <MConfig_Grammar*> (mconfig_elem));
 	errs->flush ();
     }
@@ -396,5 +525,329 @@ try {
 }
 }
 
+// Forwards parser events to @events while counting them for ParseStats.
+// Every build_sample_period-th event is timed, which keeps the overhead low.
+class StatsEvents
+{
+private:
+    static Count const build_sample_period = 16;
+
+    ConfigEvents const * const events;
+    void * const cb_data;
+    ParseStats * const stats;
+
+    Count num_events;
+
+    Uint64 beginEvent ()
+    {
+	++num_events;
+	return (num_events % build_sample_period == 0 ? getParseWallNanosec () : 0);
+    }
+
+    void endEvent (Uint64 const start_time)
+    {
+	if (start_time)
+	    stats->build_wall_nanosec += (getParseWallNanosec () - start_time) * build_sample_period;
+    }
+
+    static bool beginSection (ConstMemory                 const section_name,
+			      ConfigAttributeDesc const * const attrs,
+			      Count                       const num_attrs,
+			      void                      * const _self)
+    {
+	StatsEvents * const self = static_cast <StatsEvents*> (_self);
+
+	++self->stats->num_sections;
+	self->stats->num_attributes += num_attrs;
+
+	if (!self->events->beginSection)
+	    return true;
+
+	Uint64 const start_time = self->beginEvent ();
+	bool const res = self->events->beginSection (section_name, attrs, num_attrs, self->cb_data);
+	self->endEvent (start_time);
+	return res;
+    }
+
+    static bool option (ConstMemory         const key,
+			ConstMemory const * const values,
+			Count               const num_values,
+			void              * const _self)
+    {
+	StatsEvents * const self = static_cast <StatsEvents*> (_self);
+
+	++self->stats->num_options;
+	self->stats->num_values += num_values;
+
+	if (!self->events->option)
+	    return true;
+
+	Uint64 const start_time = self->beginEvent ();
+	bool const res = self->events->option (key, values, num_values, self->cb_data);
+	self->endEvent (start_time);
+	return res;
+    }
+
+    static bool endSection (void * const _self)
+    {
+	StatsEvents * const self = static_cast <StatsEvents*> (_self);
+
+	if (!self->events->endSection)
+	    return true;
+
+	Uint64 const start_time = self->beginEvent ();
+	bool const res = self->events->endSection (self->cb_data);
+	self->endEvent (start_time);
+	return res;
+    }
+
+    static void cancelSection (void * const _self)
+    {
+	StatsEvents * const self = static_cast <StatsEvents*> (_self);
+
+	if (self->events->cancelSection)
+	    self->events->cancelSection (self->cb_data);
+    }
+
+    static ConfigEvents const stats_events;
+
+public:
+    // Events to be passed to the parser.
+    ConfigEvents const * getEvents () const
+    {
+	return stats ? &stats_events : events;
+    }
+
+    void* getCbData ()
+    {
+	return stats ? this : cb_data;
+    }
+
+    // Resets @stats. If @stats is NULL, events are passed through as is.
+    StatsEvents (ConfigEvents const * const events,
+		 void               * const cb_data,
+		 ParseStats         * const stats)
+	: events     (events),
+	  cb_data    (cb_data),
+	  stats      (stats),
+	  num_events (0)
+    {
+	if (stats)
+	    stats->reset ();
+    }
+};
+
+ConfigEvents const StatsEvents::stats_events = {
+    beginSection,
+    option,
+    endSection,
+    cancelSection
+};
+
+static Result parseConfig_data (ConstMemory            const mem,
+				ConstMemory            const filename,
+				ConfigEvents   const * const events,
+				void                 * const cb_data,
+				ConfigParserMode       const mode,
+				Pargen::Grammar      * const grammar,
+				Pargen::ParserConfig * const parser_config,
+				ParseStats           * const stats)
+{
+    if (stats)
+	stats->num_bytes = mem.len();
+
+    if (mode == ConfigParserMode_Pargen
+	|| (mode == ConfigParserMode_Auto && nativeConfigNeedsPreprocessing (mem)))
+    {
+	logD (mconfig, _func, filename, ": using preprocessor");
+
+	MemoryFile file (Memory ((Byte*) mem.mem(), mem.len()));
+	return parseConfig_pargen (&file, filename, events, cb_data, grammar, parser_config, stats);
+    }
+
+    ParsePhaseTimer parse_timer (stats, ParseStats::Phase_Parse);
+    return parseConfig_native (mem, filename, events, cb_data, (stats ? &stats->num_tokens : NULL));
+}
+
+static Result parseConfig_mem (ConstMemory            const mem,
+			       ConstMemory            const filename,
+			       ConfigEvents   const * const events,
+			       void                 * const cb_data,
+			       ConfigParserMode       const mode,
+			       Pargen::Grammar      * const grammar,
+			       Pargen::ParserConfig * const parser_config,
+			       ParseStats           * const stats)
+{
+    StatsEvents stats_events (events, cb_data, stats);
+    return parseConfig_data (mem, filename,
+			     stats_events.getEvents(), stats_events.getCbData(),
+			     mode, grammar, parser_config, stats);
+}
+
+static Result parseConfig_file (ConstMemory            const filename,
+				ConfigEvents   const * const events,
+				void                 * const cb_data,
+				ConfigParserMode       const mode,
+				Pargen::Grammar      * const grammar,
+				Pargen::ParserConfig * const parser_config,
+				ParseStats           * const stats,
+				bool                   const allow_mmap = false)
+{
+    StatsEvents stats_events (events, cb_data, stats);
+
+    ParsePhaseTimer read_timer (stats, ParseStats::Phase_Read);
+
+    if (mode == ConfigParserMode_Pargen) {
+	NativeFile file;
+	if (!file.open (filename, 0 /* open_flags */, FileAccessMode::ReadOnly)) {
+	    logE_ (_func, "Could not open ", filename, ": ", exc->toString());
+	    return Result::Failure;
+	}
+
+	read_timer.stop ();
+
+	Result const res = parseConfig_pargen (&file, filename,
+					       stats_events.getEvents(), stats_events.getCbData(),
+					       grammar, parser_config, stats);
+	file.close (false /* flush_data */);
+	return res;
+    }
+
+    MappedFile file;
+    if (!file.open (filename, true /* log_open_error */, allow_mmap))
+	return Result::Failure;
+
+    read_timer.stop ();
+
+    return parseConfig_data (file.getMem(), filename,
+			     stats_events.getEvents(), stats_events.getCbData(),
+			     mode, grammar, parser_config, stats);
+}
+
+Result parseConfigEvents (ConstMemory          const filename,
+			  ConfigEvents const * const events,
+			  void               * const cb_data,
+			  ConfigParserMode     const mode,
+			  ParseStats         * const stats)
+{
+    return parseConfig_file (filename, events, cb_data, mode, NULL /* grammar */, NULL /* parser_config */, stats);
+}
+
+Result parseConfigEventsFromMemory (ConstMemory          const mem,
+				    ConfigEvents const * const events,
+				    void               * const cb_data,
+				    ConfigParserMode     const mode,
+				    ParseStats         * const stats)
+{
+    return parseConfig_mem (mem, "<memory>", events, cb_data, mode, NULL /* grammar */, NULL /* parser_config */, stats);
+}
+
+Result parseConfig (ConstMemory        const filename,
+		    Config           * const config,
+		    ConfigParserMode   const mode,
+		    Varlist          * const varlist,
+		    ParseStats       * const stats)
+{
+    ConfigBuilder builder (config, varlist);
+    Result const res = parseConfigEvents (filename, &ConfigBuilder::events, &builder, mode, stats);
+    if (stats)
+	stats->alloc_bytes = builder.getAllocBytes ();
+
+    return res;
+}
+
+Result parseConfig_mapped (ConstMemory        const filename,
+			  Config           * const config,
+			  ConfigParserMode   const mode,
+			  Varlist          * const varlist,
+			  ParseStats       * const stats)
+{
+    ConfigBuilder builder (config, varlist);
+    Result const res = parseConfig_file (filename, &ConfigBuilder::events, &builder, mode,
+					 NULL /* grammar */, NULL /* parser_config */, stats,
+					 true /* allow_mmap */);
+    if (stats)
+	stats->alloc_bytes = builder.getAllocBytes ();
+
+    return res;
+}
+
+Result parseConfigFromMemory (ConstMemory        const mem,
+			      Config           * const config,
+			      ConfigParserMode   const mode,
+			      Varlist          * const varlist,
+			      ParseStats       * const stats)
+{
+    ConfigBuilder builder (config, varlist);
+    Result const res = parseConfigEventsFromMemory (mem, &ConfigBuilder::events, &builder, mode, stats);
+    if (stats)
+	stats->alloc_bytes = builder.getAllocBytes ();
+
+    return res;
+}
+
+Result
+ConfigParser::parseConfig (ConstMemory        const filename,
+			   Config           * const config,
+			   ConfigParserMode   const mode,
+			   Varlist          * const varlist,
+			   ParseStats       * const stats)
+{
+    ConfigBuilder builder (config, varlist);
+    Result const res = parseConfig_file (filename, &ConfigBuilder::events, &builder, mode, grammar, parser_config, stats);
+    if (stats)
+	stats->alloc_bytes = builder.getAllocBytes ();
+
+    return res;
+}
+
+Result
+ConfigParser::parseConfigFromMemory (ConstMemory        const mem,
+				     Config           * const config,
+				     ConfigParserMode   const mode,
+				     Varlist          * const varlist,
+				     ParseStats       * const stats)
+{
+    ConfigBuilder builder (config, varlist);
+    Result const res = parseConfig_mem (mem, "<memory>", &ConfigBuilder::events, &builder, mode, grammar, parser_config, stats);
+    if (stats)
+	stats->alloc_bytes = builder.getAllocBytes ();
+
+    return res;
+}
+
+Result
+ConfigParser::parseConfigEvents (ConstMemory          const filename,
+				 ConfigEvents const * const events,
+				 void               * const cb_data,
+				 ConfigParserMode     const mode,
+				 ParseStats         * const stats)
+{
+    return parseConfig_file (filename, events, cb_data, mode, grammar, parser_config, stats);
+}
+
+Result
+ConfigParser::parseConfigEventsFromMemory (ConstMemory          const mem,
+					   ConfigEvents const * const events,
+					   void               * const cb_data,
+					   ConfigParserMode     const mode,
+					   ParseStats         * const stats)
+{
+    return parseConfig_mem (mem, "<memory>", events, cb_data, mode, grammar, parser_config, stats);
+}
+
+ConfigParser::ConfigParser ()
+{
+ try {
+    grammar = create_mconfig_grammar ();
+    Pargen::optimizeGrammar (grammar);
+    // Non-AST mode: all the work is done in accept callbacks, the element
+    // tree is not kept until the end of the parse.
+    parser_config = Pargen::createParserConfig (true /* upwards_jumps */);
+ } catch (...) {
+    logE_ (_func, "exception");
+ }
+}
+
 }
 
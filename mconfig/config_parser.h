@@ -21,15 +21,144 @@
 #define MCONFIG__CONFIG_PARSER__H__
 
 
+#include <pargen/parser.h>
+
 #include <mconfig/config.h>
+#include <mconfig/varlist.h>
+#include <mconfig/parse_stats.h>
 
 
 namespace MConfig {
 
 using namespace M;
 
-Result parseConfig (ConstMemory  filename,
-		    Config      *config);
+enum ConfigParserMode {
+    // Native parser, or the preprocessor + pargen pipeline if the file
+    // contains preprocessor directives.
+    ConfigParserMode_Auto,
+    // Native parser only. Preprocessor directives are reported as errors.
+    ConfigParserMode_Native,
+    // Scruffy preprocessor + pargen-generated parser.
+    ConfigParserMode_Pargen
+};
+
+struct ConfigAttributeDesc
+{
+    ConstMemory name;
+    ConstMemory value;
+    bool has_value;
+};
+
+// Parser events, for processing configuration files without building a Config
+// tree. Memory passed to the callbacks is only valid for the duration of the
+// call. Every occurrence of an option is reported, including repeated options
+// which replace each other in a Config tree. Any callback may be NULL.
+// Returning false from a callback stops parsing with an error.
+struct ConfigEvents
+{
+    bool (*beginSection) (ConstMemory                section_name,
+                          ConfigAttributeDesc const *attrs,
+                          Count                      num_attrs,
+                          void                      *cb_data);
+
+    // @num_values is 0 for options without '='.
+    bool (*option) (ConstMemory        key,
+                    ConstMemory const *values,
+                    Count              num_values,
+                    void              *cb_data);
+
+    bool (*endSection) (void *cb_data);
+
+    // Discards the most recently begun section which has not been discarded
+    // yet, together with everything reported within it. Sent only by the
+    // preprocessor + pargen pipeline when it backtracks out of a section after
+    // beginSection has been reported. If the section is still open, endSection
+    // is called for it first, so that begin and end events stay balanced.
+    void (*cancelSection) (void *cb_data);
+};
+
+// The file is read into memory and parsed in place unless
+// ConfigParserMode_Pargen is requested, in which case it is streamed through
+// the preprocessor.
+//
+// If @varlist is non-NULL, ${name} references in option and attribute values
+// are replaced with values of variables from @varlist while the tree is built
+// (see VarExpander). References to undefined variables are parse errors.
+//
+// If @stats is non-NULL, it is reset and filled with timings and counters
+// of the parse, on failure as well.
+Result parseConfig (ConstMemory       filename,
+		    Config           *config,
+		    ConfigParserMode  mode = ConfigParserMode_Auto,
+		    Varlist          *varlist = NULL,
+		    ParseStats       *stats = NULL);
+
+// Same as parseConfig(), but regular files are mmap'ed rather than read,
+// which saves a copy for large files. Only for files which are never truncated
+// while being parsed, like files replaced with rename(): reading past the new
+// end of a truncated mapping raises SIGBUS.
+Result parseConfig_mapped (ConstMemory       filename,
+			   Config           *config,
+			   ConfigParserMode  mode = ConfigParserMode_Auto,
+			   Varlist          *varlist = NULL,
+			   ParseStats       *stats = NULL);
+
+// Parses configuration text held in memory. The data is not copied and has
+// to stay valid for the duration of the call only.
+Result parseConfigFromMemory (ConstMemory       mem,
+			      Config           *config,
+			      ConfigParserMode  mode = ConfigParserMode_Auto,
+			      Varlist          *varlist = NULL,
+			      ParseStats       *stats = NULL);
+
+Result parseConfigEvents (ConstMemory         filename,
+			  ConfigEvents const *events,
+			  void               *cb_data,
+			  ConfigParserMode    mode = ConfigParserMode_Auto,
+			  ParseStats         *stats = NULL);
+
+Result parseConfigEventsFromMemory (ConstMemory         mem,
+				    ConfigEvents const *events,
+				    void               *cb_data,
+				    ConfigParserMode    mode = ConfigParserMode_Auto,
+				    ParseStats         *stats = NULL);
+
+// Long-lived parser which keeps an optimized grammar for the preprocessor +
+// pargen pipeline, so that it's not rebuilt for every file. parseConfig*()
+// methods may be called concurrently.
+class ConfigParser
+{
+private:
+    mt_const StRef<Pargen::Grammar> grammar;
+    mt_const StRef<Pargen::ParserConfig> parser_config;
+
+public:
+    Result parseConfig (ConstMemory       filename,
+			Config           *config,
+			ConfigParserMode  mode = ConfigParserMode_Auto,
+			Varlist          *varlist = NULL,
+			ParseStats       *stats = NULL);
+
+    Result parseConfigFromMemory (ConstMemory       mem,
+				  Config           *config,
+				  ConfigParserMode  mode = ConfigParserMode_Auto,
+				  Varlist          *varlist = NULL,
+				  ParseStats       *stats = NULL);
+
+    Result parseConfigEvents (ConstMemory         filename,
+			      ConfigEvents const *events,
+			      void               *cb_data,
+			      ConfigParserMode    mode = ConfigParserMode_Auto,
+			      ParseStats         *stats = NULL);
+
+    Result parseConfigEventsFromMemory (ConstMemory         mem,
+					ConfigEvents const *events,
+					void               *cb_data,
+					ConfigParserMode    mode = ConfigParserMode_Auto,
+					ParseStats         *stats = NULL);
+
+    ConfigParser ();
+};
 
 }
 
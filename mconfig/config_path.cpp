@@ -0,0 +1,167 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <mconfig/config_path.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+Option*
+ConfigPath::resolve (Config   * const mt_nonnull config,
+                     Section ** const ret_miss_section)
+{
+    Section *section = config->getRootSection();
+    *ret_miss_section = section;
+
+    for (Count i = 0; i + 1 < num_components; ++i) {
+        SectionEntry * const section_entry = section->getSectionEntry_nopath (components [i]);
+        if (!section_entry ||
+            section_entry->getType() != SectionEntry::Type_Section)
+        {
+            return NULL;
+        }
+
+        section = static_cast <Section*> (section_entry);
+        *ret_miss_section = section;
+    }
+
+    SectionEntry * const section_entry = section->getSectionEntry_nopath (components [num_components - 1]);
+    if (!section_entry ||
+        section_entry->getType() != SectionEntry::Type_Option)
+    {
+        return NULL;
+    }
+
+    return static_cast <Option*> (section_entry);
+}
+
+ConstMemory
+ConfigPath::getString (Config * const mt_nonnull config,
+                       bool   * const ret_is_set)
+{
+    Option * const option = getOption (config);
+    if (!option
+        || !option->getValue())
+    {
+        if (ret_is_set)
+            *ret_is_set = false;
+
+        return ConstMemory ();
+    }
+
+    if (ret_is_set)
+        *ret_is_set = true;
+
+    return option->getValue()->mem();
+}
+
+ConstMemory
+ConfigPath::getString_default (Config      * const mt_nonnull config,
+                               ConstMemory   const default_value)
+{
+    bool is_set;
+    ConstMemory const str = getString (config, &is_set);
+    if (is_set)
+        return str;
+
+    return default_value;
+}
+
+GetResult
+ConfigPath::getInt64 (Config * const mt_nonnull config,
+                      Int64  * const ret_value)
+{
+    return Config::getOptionInt64 (getOption (config), getPath(), ret_value);
+}
+
+GetResult
+ConfigPath::getUint64 (Config * const mt_nonnull config,
+                       Uint64 * const ret_value)
+{
+    return Config::getOptionUint64 (getOption (config), getPath(), ret_value);
+}
+
+GetResult
+ConfigPath::getDouble (Config * const mt_nonnull config,
+                       double * const ret_value)
+{
+    return Config::getOptionDouble (getOption (config), getPath(), ret_value);
+}
+
+BooleanValue
+ConfigPath::getBoolean (Config * const mt_nonnull config)
+{
+    return Config::getOptionBoolean (getOption (config), getPath());
+}
+
+// Splits the path the same way as Section::getSectionEntry() does: leading
+// slashes of every component are skipped, the last component may be empty.
+ConfigPath::ConfigPath (ConstMemory const path)
+    : path_buf            (NULL),
+      path_len            (path.len()),
+      components          (NULL),
+      num_components      (0),
+      cached_config       (NULL),
+      cached_config_id    (0),
+      cached_generation   (0),
+      cached_option       (NULL),
+      cached_miss_section (NULL)
+{
+    if (path_len) {
+        path_buf = new (std::nothrow) Byte [path_len];
+        assert (path_buf);
+        memcpy (path_buf, path.mem(), path_len);
+    }
+
+    Count const max_components = 1 + (path_len + 1) / 2;
+    components = new (std::nothrow) ConfigNameKey [max_components];
+    assert (components);
+
+    ConstMemory left (path_buf, path_len);
+    for (;;) {
+        while (left.len() > 0 && left.mem() [0] == '/')
+            left = left.region (1);
+
+        Byte const * const delim = (Byte const *) memchr (left.mem(), '/', left.len());
+        if (!delim) {
+            components [num_components] = ConfigNameKey (left);
+            ++num_components;
+            break;
+        }
+
+        components [num_components] = ConfigNameKey (left.region (0, delim - left.mem()));
+        ++num_components;
+
+        left = left.region (delim - left.mem() + 1);
+    }
+
+    assert (num_components <= max_components);
+}
+
+ConfigPath::~ConfigPath ()
+{
+    delete[] components;
+    delete[] path_buf;
+}
+
+}
+
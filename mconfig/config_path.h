@@ -0,0 +1,115 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__CONFIG_PATH__H__
+#define MCONFIG__CONFIG_PATH__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Precompiled path for repeated lookups of the same option. The path is split
+// into components and the components are hashed once, in the constructor.
+// The resolved option is remembered together with the Config's generation,
+// so that repeated lookups do not touch the tree until it changes.
+//
+// ConfigPath is not thread-safe: concurrent lookups require separate objects.
+class ConfigPath
+{
+private:
+    Byte *path_buf;
+    Size  path_len;
+
+    ConfigNameKey *components;
+    Count num_components;
+
+    Config  *cached_config;
+    Uint32   cached_config_id;
+    Uint64   cached_generation;
+    Option  *cached_option;
+    // Section in which the lookup has failed if cached_option is NULL.
+    Section *cached_miss_section;
+
+    Option* resolve (Config  * mt_nonnull config,
+                     Section **ret_miss_section);
+
+public:
+    ConstMemory getPath () const
+    {
+        return ConstMemory (path_buf, path_len);
+    }
+
+    // Same as Config::getOption (path).
+    Option* getOption (Config * const mt_nonnull config)
+    {
+        if (config != cached_config
+            || config->getConfigId() != cached_config_id
+            || config->getGeneration() != cached_generation)
+        {
+            cached_option = resolve (config, &cached_miss_section);
+            cached_config = config;
+            cached_config_id = config->getConfigId();
+            cached_generation = config->getGeneration();
+        }
+
+        if (config->isLookupStatsEnabled ()) {
+            if (cached_option)
+                cached_option->num_lookups.inc ();
+            else
+            if (cached_miss_section)
+                cached_miss_section->num_misses.inc ();
+        }
+
+        return cached_option;
+    }
+
+    ConstMemory getString (Config *config,
+                           bool   *ret_is_set = NULL);
+
+    ConstMemory getString_default (Config      *config,
+                                   ConstMemory  default_value);
+
+    GetResult getInt64 (Config *config,
+                        Int64  *ret_value);
+
+    GetResult getUint64 (Config *config,
+                         Uint64 *ret_value);
+
+    GetResult getDouble (Config *config,
+                         double *ret_value);
+
+    BooleanValue getBoolean (Config *config);
+
+    ConfigPath (ConstMemory path);
+
+    ~ConfigPath ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_PATH__H__ */
+
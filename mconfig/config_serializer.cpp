@@ -0,0 +1,406 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <mconfig/config_serializer.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+namespace {
+
+char const indent_spaces [] =
+        "                                                                "
+        "                                                                ";
+
+Size const indent_width = 4;
+
+bool
+isBareName (ConstMemory const name)
+{
+    if (name.len() == 0)
+        return false;
+
+    for (Size i = 0; i < name.len(); ++i) {
+        Byte const c = name.mem() [i];
+        if (!((c >= 'a' && c <= 'z') ||
+              (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') ||
+              c == '_'))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
+
+void
+ConfigSerializer::grow (Size const extra_len)
+{
+    Size new_size = (buf_size ? buf_size * 2 : 4096);
+    while (new_size - len < extra_len)
+        new_size *= 2;
+
+    Byte * const new_buf = new (std::nothrow) Byte [new_size];
+    assert (new_buf);
+    if (len)
+        memcpy (new_buf, buf, len);
+
+    delete[] buf;
+    buf = new_buf;
+    buf_size = new_size;
+}
+
+void
+ConfigSerializer::appendIndent (unsigned const nest_level)
+{
+    Size indent_len = nest_level * indent_width;
+    while (indent_len) {
+        Size const chunk_len = (indent_len < sizeof (indent_spaces) - 1 ? indent_len : sizeof (indent_spaces) - 1);
+        append (ConstMemory (indent_spaces, chunk_len));
+        indent_len -= chunk_len;
+    }
+}
+
+void
+ConfigSerializer::appendQuoted (ConstMemory const mem,
+                                Byte        const prefix)
+{
+  // Worst case for JSON is 6 bytes per input byte ("\u00XX").
+    if (buf_size - len < mem.len() * 6 + 3)
+        grow (mem.len() * 6 + 3);
+
+    Byte * const out_start = buf + len;
+    Byte *out = out_start;
+    *out++ = '"';
+    if (prefix)
+        *out++ = prefix;
+
+    Byte const *in = mem.mem();
+    Byte const * const in_end = in + mem.len();
+    if (format == Format_Json) {
+        static char const hex_digits [] = "0123456789abcdef";
+
+        for (; in < in_end; ++in) {
+            Byte const c = *in;
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                *out++ = c;
+                continue;
+            }
+
+            *out++ = '\\';
+            switch (c) {
+                case '"':  *out++ = '"';  break;
+                case '\\': *out++ = '\\'; break;
+                case '\n': *out++ = 'n';  break;
+                case '\r': *out++ = 'r';  break;
+                case '\t': *out++ = 't';  break;
+                case '\b': *out++ = 'b';  break;
+                case '\f': *out++ = 'f';  break;
+                default:
+                    *out++ = 'u';
+                    *out++ = '0';
+                    *out++ = '0';
+                    *out++ = hex_digits [c >> 4];
+                    *out++ = hex_digits [c & 0xf];
+            }
+        }
+    } else {
+        for (; in < in_end; ++in) {
+            Byte const c = *in;
+            if (c == '"' || c == '\\')
+                *out++ = '\\';
+
+            *out++ = c;
+        }
+    }
+
+    *out++ = '"';
+    len += out - out_start;
+}
+
+void
+ConfigSerializer::appendName (ConstMemory const name)
+{
+    if (format == Format_MConfig && isBareName (name))
+        append (name);
+    else
+        appendQuoted (name);
+}
+
+void
+ConfigSerializer::appendOption_mconfig (Option   * const mt_nonnull option,
+                                        unsigned   const nest_level)
+{
+    appendIndent (nest_level);
+    appendName (option->getName());
+
+    Option::iter iter (*option);
+    if (!option->iter_done (iter)) {
+        append (ConstMemory (" = ", 3));
+        for (;;) {
+            appendQuoted (option->iter_next (iter)->mem());
+            if (option->iter_done (iter))
+                break;
+
+            append (ConstMemory (", ", 2));
+        }
+    }
+
+    append (ConstMemory (";\n", 2));
+}
+
+void
+ConfigSerializer::appendSection_mconfig (Section  * const mt_nonnull section,
+                                         unsigned   const nest_level)
+{
+    appendIndent (nest_level);
+    if (section->getName().len()) {
+        appendName (section->getName());
+        appendByte (' ');
+    }
+
+    {
+        Section::attribute_iterator iter (*section);
+        while (!iter.done()) {
+            Attribute * const attr = iter.next ();
+            appendName (attr->getName());
+            if (attr->hasValue()) {
+                appendByte ('=');
+                appendQuoted (attr->getValue());
+            }
+            appendByte (' ');
+        }
+    }
+
+    append (ConstMemory ("{\n", 2));
+    appendSectionBody_mconfig (section, nest_level + 1);
+    appendIndent (nest_level);
+    append (ConstMemory ("}\n", 2));
+}
+
+void
+ConfigSerializer::appendSectionBody_mconfig (Section  * const mt_nonnull section,
+                                             unsigned   const nest_level)
+{
+    bool first_entry = true;
+
+    Section::iter iter (*section);
+    while (!section->iter_done (iter)) {
+        SectionEntry * const section_entry = section->iter_next (iter);
+        switch (section_entry->getType()) {
+            case SectionEntry::Type_Option: {
+                appendOption_mconfig (static_cast <Option*> (section_entry), nest_level);
+            } break;
+            case SectionEntry::Type_Section: {
+                Section *subsection = static_cast <Section*> (section_entry);
+              // Repeated sections are written together, in their original order.
+                if (subsection->getPrevSibling())
+                    continue;
+
+                for (; subsection; subsection = subsection->getNextSibling()) {
+                    if (!first_entry)
+                        appendByte ('\n');
+
+                    appendSection_mconfig (subsection, nest_level);
+                    first_entry = false;
+                }
+            } break;
+            default:
+                unreachable ();
+        }
+
+        first_entry = false;
+    }
+}
+
+void
+ConfigSerializer::appendOptionValue_json (Option * const mt_nonnull option)
+{
+    Option::iter iter (*option);
+    if (option->iter_done (iter)) {
+        append (ConstMemory ("null", 4));
+        return;
+    }
+
+    Value * const value = option->iter_next (iter);
+    if (option->iter_done (iter)) {
+        appendQuoted (value->mem());
+        return;
+    }
+
+    appendByte ('[');
+    appendQuoted (value->mem());
+    while (!option->iter_done (iter)) {
+        append (ConstMemory (", ", 2));
+        appendQuoted (option->iter_next (iter)->mem());
+    }
+    appendByte (']');
+}
+
+void
+ConfigSerializer::appendSectionObject_json (Section  * const mt_nonnull section,
+                                            unsigned   const nest_level)
+{
+    bool first_member = true;
+    appendByte ('{');
+
+    {
+        Section::attribute_iterator iter (*section);
+        while (!iter.done()) {
+            Attribute * const attr = iter.next ();
+
+            append (first_member ? ConstMemory ("\n", 1) : ConstMemory (",\n", 2));
+            first_member = false;
+
+            appendIndent (nest_level + 1);
+            appendQuoted (attr->getName(), '@');
+
+            append (ConstMemory (": ", 2));
+            if (attr->hasValue())
+                appendQuoted (attr->getValue());
+            else
+                append (ConstMemory ("true", 4));
+        }
+    }
+
+    Section::iter iter (*section);
+    while (!section->iter_done (iter)) {
+        SectionEntry * const section_entry = section->iter_next (iter);
+
+        Section *subsection = NULL;
+        if (section_entry->getType() == SectionEntry::Type_Section) {
+            subsection = static_cast <Section*> (section_entry);
+            if (subsection->getPrevSibling())
+                continue;
+        }
+
+        append (first_member ? ConstMemory ("\n", 1) : ConstMemory (",\n", 2));
+        first_member = false;
+
+        appendIndent (nest_level + 1);
+        appendQuoted (section_entry->getName());
+        append (ConstMemory (": ", 2));
+
+        if (!subsection) {
+            appendOptionValue_json (static_cast <Option*> (section_entry));
+            continue;
+        }
+
+        if (!subsection->getNextSibling()) {
+            appendSectionObject_json (subsection, nest_level + 1);
+            continue;
+        }
+
+        appendByte ('[');
+        for (; subsection; subsection = subsection->getNextSibling()) {
+            appendByte ('\n');
+            appendIndent (nest_level + 2);
+            appendSectionObject_json (subsection, nest_level + 2);
+            if (subsection->getNextSibling())
+                appendByte (',');
+        }
+        appendByte ('\n');
+        appendIndent (nest_level + 1);
+        appendByte (']');
+    }
+
+    if (!first_member) {
+        appendByte ('\n');
+        appendIndent (nest_level);
+    }
+    appendByte ('}');
+}
+
+void
+ConfigSerializer::addConfig (Config   * const mt_nonnull config,
+                             unsigned   const nest_level)
+{
+    addSectionBody (config->getRootSection(), nest_level);
+}
+
+void
+ConfigSerializer::addSection (Section  * const mt_nonnull section,
+                              unsigned   const nest_level)
+{
+    if (format == Format_Json) {
+        appendIndent (nest_level);
+        appendSectionObject_json (section, nest_level);
+        appendByte ('\n');
+    } else {
+        appendSection_mconfig (section, nest_level);
+    }
+}
+
+void
+ConfigSerializer::addSectionBody (Section  * const mt_nonnull section,
+                                  unsigned   const nest_level)
+{
+    if (format == Format_Json) {
+      // JSON has no notion of a section body: this is the section's object.
+        appendIndent (nest_level);
+        appendSectionObject_json (section, nest_level);
+        appendByte ('\n');
+    } else {
+        appendSectionBody_mconfig (section, nest_level);
+    }
+}
+
+void
+ConfigSerializer::addOption (Option   * const mt_nonnull option,
+                             unsigned   const nest_level)
+{
+    if (format == Format_Json) {
+        appendIndent (nest_level);
+        appendOptionValue_json (option);
+        appendByte ('\n');
+    } else {
+        appendOption_mconfig (option, nest_level);
+    }
+}
+
+Result
+ConfigSerializer::write (OutputStream * const mt_nonnull outs)
+{
+    if (!outs->writeFull (getMem(), NULL /* ret_nwritten */))
+        return Result::Failure;
+
+    return Result::Success;
+}
+
+ConfigSerializer::ConfigSerializer (Format const format)
+    : format   (format),
+      buf      (NULL),
+      len      (0),
+      buf_size (0)
+{
+}
+
+ConfigSerializer::~ConfigSerializer ()
+{
+    delete[] buf;
+}
+
+}
+
@@ -0,0 +1,146 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__CONFIG_SERIALIZER__H__
+#define MCONFIG__CONFIG_SERIALIZER__H__
+
+
+#include <libmary/libmary.h>
+#include <cstring>
+
+#include <mconfig/config.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Renders config trees into a single growable buffer, which is then written
+// out with one call.
+//
+// Format_MConfig produces configuration file syntax. Values and attribute
+// values are always quoted, names are quoted unless they consist of
+// alphanumerics and underscores. Quotes and backslashes are escaped the way
+// C string literals do it. Note that the parser doesn't decode escapes, so
+// values containing them don't round-trip byte-exact.
+//
+// Format_Json produces a JSON object per section. Options map to a string for
+// a single value, an array for multiple values and null for no values.
+// Repeated sections map to an array of objects in file order. Attributes are
+// stored as members prefixed with '@', with value true if there's no value.
+class ConfigSerializer
+{
+public:
+    enum Format {
+        Format_MConfig,
+        Format_Json
+    };
+
+private:
+    mt_const Format format;
+
+    Byte *buf;
+    Size  len;
+    Size  buf_size;
+
+    void grow (Size extra_len);
+
+    void append (ConstMemory const mem)
+    {
+        if (buf_size - len < mem.len())
+            grow (mem.len());
+
+        memcpy (buf + len, mem.mem(), mem.len());
+        len += mem.len();
+    }
+
+    void appendByte (Byte const c)
+    {
+        if (buf_size == len)
+            grow (1);
+
+        buf [len] = c;
+        ++len;
+    }
+
+    void appendIndent (unsigned nest_level);
+
+    // @prefix, if non-zero, is put right after the opening quote.
+    void appendQuoted (ConstMemory mem,
+                       Byte        prefix = 0);
+
+    void appendName (ConstMemory name);
+
+    void appendOption_mconfig (Option * mt_nonnull option,
+                               unsigned nest_level);
+
+    void appendSection_mconfig (Section * mt_nonnull section,
+                                unsigned nest_level);
+
+    void appendSectionBody_mconfig (Section * mt_nonnull section,
+                                    unsigned nest_level);
+
+    void appendOptionValue_json (Option * mt_nonnull option);
+
+    void appendSectionObject_json (Section * mt_nonnull section,
+                                   unsigned nest_level);
+
+public:
+    // Appends the contents of the root section.
+    void addConfig (Config   * mt_nonnull config,
+                    unsigned  nest_level = 0);
+
+    // Appends the section itself. For Format_Json, this is an object with
+    // the section's contents.
+    void addSection (Section  * mt_nonnull section,
+                     unsigned  nest_level = 0);
+
+    // Appends the contents of the section.
+    void addSectionBody (Section  * mt_nonnull section,
+                         unsigned  nest_level = 0);
+
+    // Appends a single option. For Format_Json, this is the option's value.
+    void addOption (Option   * mt_nonnull option,
+                    unsigned  nest_level = 0);
+
+    ConstMemory getMem () const
+    {
+        return ConstMemory (buf, len);
+    }
+
+    // Writes the whole buffer with a single writeFull() call.
+    Result write (OutputStream * mt_nonnull outs);
+
+    // Clears the buffer, keeping the memory for reuse.
+    void reset ()
+    {
+        len = 0;
+    }
+
+    ConfigSerializer (Format format = Format_MConfig);
+
+    ~ConfigSerializer ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_SERIALIZER__H__ */
+
@@ -0,0 +1,364 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <libmary/libmary.h>
+#include <algorithm>
+
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <unistd.h>
+#endif
+
+#include <mconfig/config_set.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
+
+namespace {
+
+struct ParseJob
+{
+    ConstMemory filename;
+    Ref<Config> config;
+    bool success;
+};
+
+struct ParseJobSet
+{
+    ConfigParser *parser;
+
+    ParseJob *jobs;
+    Count num_jobs;
+
+    AtomicInt next_job;
+};
+
+void parseWorkerFunc (void * const _job_set)
+{
+    ParseJobSet * const job_set = static_cast <ParseJobSet*> (_job_set);
+
+    for (;;) {
+        Count const job_idx = (Count) job_set->next_job.fetchAdd (1);
+        if (job_idx >= job_set->num_jobs)
+            break;
+
+        ParseJob * const job = &job_set->jobs [job_idx];
+        job->success = job_set->parser->parseConfig (job->filename, job->config);
+    }
+}
+
+Count getDefaultNumThreads ()
+{
+#ifndef LIBMARY_PLATFORM_WIN32
+    long const num_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    if (num_cpus > 0)
+        return (Count) num_cpus;
+#endif
+
+    return 1;
+}
+
+// Appends entries of @section to @entries in iteration order, with repeated
+// sections kept in their original order.
+void collectEntries (Section             * const mt_nonnull section,
+                     List<SectionEntry*> * const mt_nonnull entries)
+{
+    Section::iterator iter (*section);
+    while (!iter.done()) {
+        SectionEntry * const section_entry = iter.next ();
+        if (section_entry->getType() == SectionEntry::Type_Section) {
+            Section *sibling = static_cast <Section*> (section_entry);
+            if (sibling->getPrevSibling())
+                continue;
+
+            for (; sibling; sibling = sibling->getNextSibling())
+                entries->append (sibling);
+
+            continue;
+        }
+
+        entries->append (section_entry);
+    }
+}
+
+void copyValues (Option * const mt_nonnull dst_option,
+                 Option * const mt_nonnull src_option)
+{
+    Size num_bytes = 0;
+    {
+        Option::iter iter (*src_option);
+        while (!src_option->iter_done (iter))
+            num_bytes += src_option->iter_next (iter)->mem().len();
+    }
+    dst_option->reserveValues (src_option->getNumValues(), num_bytes);
+
+    Option::iter iter (*src_option);
+    while (!src_option->iter_done (iter))
+        dst_option->addValue (src_option->iter_next (iter)->mem());
+}
+
+// Copies attributes and entries of @src into @dst. The sections belong to
+// different Configs: new entries are allocated the same way as @dst, and their
+// names are interned in the name table of its Config.
+void copySectionBody (Section * const mt_nonnull dst,
+                      Section * const mt_nonnull src)
+{
+    {
+        Section::attribute_iterator iter (*src);
+        while (!iter.done()) {
+            Attribute * const attr = iter.next ();
+            dst->addAttribute (dst->createAttribute (attr->getName(), attr->hasValue(), attr->getValue()));
+        }
+    }
+
+    List<SectionEntry*> entries;
+    collectEntries (src, &entries);
+
+    for (List<SectionEntry*>::Element *el = entries.first; el; el = el->next) {
+        SectionEntry * const section_entry = el->data;
+        switch (section_entry->getType()) {
+            case SectionEntry::Type_Section: {
+                Section * const src_section = static_cast <Section*> (section_entry);
+                Section * const dst_section = dst->createSection (src_section->getName());
+                copySectionBody (dst_section, src_section);
+                dst->addSection (dst_section);
+            } break;
+            case SectionEntry::Type_Option: {
+                Option * const src_option = static_cast <Option*> (section_entry);
+                Option * const dst_option = dst->createOption (src_option->getName());
+                copyValues (dst_option, src_option);
+                dst->addOption (dst_option);
+            } break;
+            default:
+                unreachable ();
+        }
+    }
+}
+
+// Copies the contents of @src into @dst the same way parseConfig() would add
+// them when parsing into @dst directly.
+void mergeConfig (Config * const mt_nonnull dst,
+                  Config * const mt_nonnull src)
+{
+    Section * const dst_root = dst->getRootSection();
+    Section * const src_root = src->getRootSection();
+
+    List<SectionEntry*> entries;
+    collectEntries (src_root, &entries);
+
+    for (List<SectionEntry*>::Element *el = entries.first; el; el = el->next) {
+        SectionEntry * const section_entry = el->data;
+        switch (section_entry->getType()) {
+            case SectionEntry::Type_Section: {
+                Section * const src_section = static_cast <Section*> (section_entry);
+                Section * const dst_section = dst_root->createSection (src_section->getName());
+                copySectionBody (dst_section, src_section);
+                dst_root->addSection (dst_section);
+            } break;
+            case SectionEntry::Type_Option: {
+                Option * const src_option = static_cast <Option*> (section_entry);
+
+              // Last option wins.
+                Option *dst_option = dst_root->getOption (src_option->getName());
+                if (dst_option) {
+                    dst_option->removeValues ();
+                } else {
+                    dst_option = dst_root->createOption (src_option->getName());
+                    dst_root->addOption (dst_option);
+                }
+
+                copyValues (dst_option, src_option);
+            } break;
+            default:
+                unreachable ();
+        }
+    }
+}
+
+bool filenameLess (Ref<String> const &left,
+                   Ref<String> const &right)
+{
+    return compare (left->mem(), right->mem()) < 0;
+}
+
+}
+
+Result parseConfigSet (ConstMemory const * const filenames,
+                       Count               const num_filenames,
+                       Config            * const config,
+                       Count                     num_threads,
+                       ConfigParser      * const parser)
+{
+    if (num_filenames == 0)
+        return Result::Success;
+
+    ConfigParser *tmp_parser = NULL;
+
+    ParseJobSet job_set;
+    job_set.parser = parser;
+    if (!job_set.parser) {
+        tmp_parser = new (std::nothrow) ConfigParser;
+        assert (tmp_parser);
+        job_set.parser = tmp_parser;
+    }
+
+    job_set.num_jobs = num_filenames;
+    job_set.jobs = new (std::nothrow) ParseJob [num_filenames];
+    assert (job_set.jobs);
+    for (Count i = 0; i < num_filenames; ++i) {
+        ParseJob * const job = &job_set.jobs [i];
+        job->filename = filenames [i];
+        // Every fragment is parsed by a single worker and has its own arena
+        // and name table, so workers don't contend on a shared name table
+        // lock. Entries are copied into @config by mergeConfig().
+        Ref<ConfigNameTable> const name_table =
+                grab (new (std::nothrow) ConfigNameTable (false /* thread_safe */));
+        job->config = grab (new (std::nothrow) Config (true /* use_arena */, name_table));
+        job->success = false;
+    }
+
+    if (num_threads == 0)
+        num_threads = getDefaultNumThreads ();
+    if (num_threads > num_filenames)
+        num_threads = num_filenames;
+
+  // The calling thread is one of the workers.
+    Count const num_spawned = num_threads - 1;
+    Ref<Thread> * const threads = (num_spawned ? new (std::nothrow) Ref<Thread> [num_spawned] : NULL);
+    for (Count i = 0; i < num_spawned; ++i) {
+        Ref<Thread> const thread =
+                grab (new (std::nothrow) Thread (
+                        CbDesc<Thread::ThreadFunc> (parseWorkerFunc, &job_set, NULL /* coderef_container */)));
+        if (!thread->spawn (true /* joinable */)) {
+          // The remaining threads will do the work.
+            logE_ (_func, "Thread::spawn() failed: ", exc->toString());
+            continue;
+        }
+
+        threads [i] = thread;
+    }
+
+    parseWorkerFunc (&job_set);
+
+    for (Count i = 0; i < num_spawned; ++i) {
+        if (threads [i] && !threads [i]->join ())
+            logE_ (_func, "Thread::join() failed: ", exc->toString());
+    }
+    delete[] threads;
+
+  // @config is left untouched unless every fragment has been parsed.
+    Result res = Result::Success;
+    for (Count i = 0; i < num_filenames; ++i) {
+        ParseJob * const job = &job_set.jobs [i];
+        if (!job->success) {
+            logE_ (_func, "Could not parse ", job->filename);
+            res = Result::Failure;
+        }
+    }
+
+    if (res) {
+        for (Count i = 0; i < num_filenames; ++i)
+            mergeConfig (config, job_set.jobs [i].config);
+    }
+
+    delete[] job_set.jobs;
+    delete tmp_parser;
+
+    return res;
+}
+
+Result parseConfigDirectory (ConstMemory    const dirname,
+                             Config       * const config,
+                             ConstMemory    const suffix,
+                             Count          const num_threads,
+                             ConfigParser * const parser)
+{
+    Ref<Vfs> const vfs = Vfs::createDefaultLocalVfs (dirname);
+    Ref<Vfs::VfsDirectory> const dir = vfs->openDirectory (ConstMemory());
+    if (!dir) {
+        logE_ (_func, "Could not open directory ", dirname, ": ", exc->toString());
+        return Result::Failure;
+    }
+
+    List< Ref<String> > filename_list;
+    Count num_filenames = 0;
+    for (;;) {
+        Ref<String> entry_name;
+        if (!dir->getNextEntry (entry_name)) {
+            logE_ (_func, "Could not read directory ", dirname, ": ", exc->toString());
+            return Result::Failure;
+        }
+
+        if (!entry_name)
+            break;
+
+        ConstMemory const name = entry_name->mem();
+        if (name.len() == 0 || name.mem() [0] == '.')
+            continue;
+
+        if (suffix.len() > 0
+            && (name.len() < suffix.len()
+                || !equal (name.region (name.len() - suffix.len()), suffix)))
+        {
+            continue;
+        }
+
+        Vfs::FileStat stat_data;
+        if (!vfs->stat (name, &stat_data)) {
+            logW_ (_func, "Could not stat ", name, " in ", dirname, ": ", exc->toString());
+            continue;
+        }
+
+        if (stat_data.file_type != Vfs::FileType::File)
+            continue;
+
+        filename_list.append (makeString (dirname, "/", name));
+        ++num_filenames;
+    }
+
+    Ref<String> * const filename_strs = new (std::nothrow) Ref<String> [num_filenames + 1];
+    assert (filename_strs);
+    {
+        Count i = 0;
+        for (List< Ref<String> >::Element *el = filename_list.first; el; el = el->next) {
+            filename_strs [i] = el->data;
+            ++i;
+        }
+    }
+
+    std::sort (filename_strs, filename_strs + num_filenames, filenameLess);
+
+    ConstMemory * const filenames = new (std::nothrow) ConstMemory [num_filenames + 1];
+    assert (filenames);
+    for (Count i = 0; i < num_filenames; ++i)
+        filenames [i] = filename_strs [i]->mem();
+
+    Result const res = parseConfigSet (filenames, num_filenames, config, num_threads, parser);
+
+    delete[] filenames;
+    delete[] filename_strs;
+
+    return res;
+}
+
+}
+
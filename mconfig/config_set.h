@@ -0,0 +1,68 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MCONFIG__CONFIG_SET__H__
+#define MCONFIG__CONFIG_SET__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config.h>
+#include <mconfig/config_parser.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Parses @filenames on a pool of @num_threads worker threads (0 means one
+// thread per online CPU), each file into a separate tree. The trees are then
+// merged into @config in the order of @filenames, which gives the same result
+// as calling parseConfig() for every file in turn: sections are appended,
+// top-level options of later files replace earlier ones.
+//
+// Merging is done in the calling thread after all files have been parsed.
+// Fragments have their own arenas and name tables, so their entries are
+// copied into @config rather than relinked. The copy is linear in the total
+// size of the fragments, which bounds the speedup for large sets of small
+// files.
+//
+// If any file fails to parse, @config is not modified.
+//
+// If @parser is NULL, a temporary ConfigParser is used.
+Result parseConfigSet (ConstMemory const *filenames,
+                       Count              num_filenames,
+                       Config            *config,
+                       Count              num_threads = 0,
+                       ConfigParser      *parser = NULL);
+
+// Parses all files in @dirname (conf.d style) with parseConfigSet(), in the
+// order of file names. Hidden files are skipped. If @suffix is not empty,
+// only files with names ending with @suffix are parsed.
+Result parseConfigDirectory (ConstMemory   dirname,
+                             Config       *config,
+                             ConstMemory   suffix = ConstMemory(),
+                             Count         num_threads = 0,
+                             ConfigParser *parser = NULL);
+
+}
+
+
+#endif /* MCONFIG__CONFIG_SET__H__ */
+
@@ -0,0 +1,463 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <libmary/libmary.h>
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include <mconfig/mapped_file.h>
+#include <mconfig/native_config_parser.h>
+#include <mconfig/config_watcher.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
+
+#ifdef __linux__
+
+namespace {
+
+// Limits include discovery for recursive or pathological include graphs.
+Count const max_watched_files = 256;
+
+ConstMemory
+dirPart (ConstMemory const filename)
+{
+    for (Size i = filename.len(); i > 0; --i) {
+        if (filename.mem() [i - 1] == '/')
+            return (i == 1 ? filename.region (0, 1) : filename.region (0, i - 1));
+    }
+
+    return ConstMemory (".", 1);
+}
+
+ConstMemory
+namePart (ConstMemory const filename)
+{
+    for (Size i = filename.len(); i > 0; --i) {
+        if (filename.mem() [i - 1] == '/')
+            return filename.region (i);
+    }
+
+    return filename;
+}
+
+bool
+hasFilename (List< Ref<String> > * const mt_nonnull list,
+             ConstMemory           const filename)
+{
+    for (List< Ref<String> >::Element *el = list->first; el; el = el->next) {
+        if (equal (el->data->mem(), filename))
+            return true;
+    }
+
+    return false;
+}
+
+void collectFiles (ConstMemory           filename,
+                   List< Ref<String> > * mt_nonnull list);
+
+struct IncludeDirective_Data
+{
+    ConstMemory          filename;
+    List< Ref<String> > *list;
+};
+
+void
+includeDirective (ConstMemory   const include_name,
+                  void        * const _data)
+{
+    IncludeDirective_Data * const data = static_cast <IncludeDirective_Data*> (_data);
+
+    if (include_name.len() == 0)
+        return;
+
+    if (include_name.mem() [0] == '/') {
+        collectFiles (include_name, data->list);
+        return;
+    }
+
+    Ref<String> const include_filename = makeString (dirPart (data->filename), "/", include_name);
+    collectFiles (include_filename->mem(), data->list);
+}
+
+// Appends @filename and the files it includes with #include "..." to @list.
+// Include paths are resolved relative to the including file, the way the
+// preprocessor does it for quoted includes.
+void
+collectFiles (ConstMemory           const filename,
+              List< Ref<String> > * const mt_nonnull list)
+{
+    if (hasFilename (list, filename) || list->getNumElements() >= max_watched_files)
+        return;
+
+    list->append (grab (new (std::nothrow) String (filename)));
+
+    MappedFile file;
+    if (!file.open (filename, false /* log_open_error */))
+        return;
+
+    IncludeDirective_Data data;
+    data.filename = filename;
+    data.list = list;
+    nativeConfigGetIncludes (file.getMem(), includeDirective, &data);
+}
+
+}
+
+void
+ConfigWatcher::addWatch (ConstMemory const watch_filename)
+{
+    for (WatchedFileList::Element *el = watched_files.first; el; el = el->next) {
+        if (equal (el->data->filename->mem(), watch_filename))
+            return;
+    }
+
+    WatchedFile * const watched_file = new (std::nothrow) WatchedFile;
+    assert (watched_file);
+    watched_file->filename = grab (new (std::nothrow) String (watch_filename));
+    watched_file->dir = grab (new (std::nothrow) String (dirPart (watch_filename)));
+    watched_file->name = namePart (watched_file->filename->mem());
+
+  // inotify returns the same watch descriptor for repeated watches of
+  // a directory.
+    watched_file->wd = inotify_add_watch (inotify_fd,
+                                          (char const*) watched_file->dir->cstr(),
+                                          IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (watched_file->wd == -1) {
+        logE_ (_func, "inotify_add_watch() failed for ", watched_file->dir->mem(), ": ", strerror (errno));
+        delete watched_file;
+        return;
+    }
+
+    watched_files.append (watched_file);
+}
+
+void
+ConfigWatcher::updateWatches ()
+{
+    List< Ref<String> > files;
+    collectFiles (filename->mem(), &files);
+
+    mutex.lock ();
+    for (List< Ref<String> >::Element *el = extra_files.first; el; el = el->next)
+        collectFiles (el->data->mem(), &files);
+    mutex.unlock ();
+
+  // Directory watches of files which are no longer included are kept. Events
+  // for such files are filtered out.
+    {
+        WatchedFileList::Element *el = watched_files.first;
+        while (el) {
+            WatchedFileList::Element * const next_el = el->next;
+            if (!hasFilename (&files, el->data->filename->mem())) {
+                delete el->data;
+                watched_files.remove (el);
+            }
+
+            el = next_el;
+        }
+    }
+
+    for (List< Ref<String> >::Element *el = files.first; el; el = el->next)
+        addWatch (el->data->mem());
+}
+
+bool
+ConfigWatcher::isEventRelevant (int         const wd,
+                                ConstMemory const name)
+{
+    for (WatchedFileList::Element *el = watched_files.first; el; el = el->next) {
+        if (el->data->wd == wd && equal (el->data->name, name))
+            return true;
+    }
+
+    return false;
+}
+
+void
+ConfigWatcher::reload (Time const change_time)
+{
+    Ref<Config> const config = holder->createConfig ();
+    bool const parsed = parseConfig (filename->mem(), config, mode);
+    Time const parse_finish_time = getTimeMicroseconds ();
+
+    Time publish_time = 0;
+    if (parsed) {
+        holder->setConfig (config);
+        publish_time = getTimeMicroseconds ();
+    } else {
+        logE_ (_func, "Could not parse ", filename->mem(), ", keeping the current config");
+    }
+
+  // The set of included files may have changed.
+    updateWatches ();
+
+    mutex.lock ();
+    ++stats.num_reloads;
+    stats.last_change_time = change_time;
+    stats.last_parse_finish_time = parse_finish_time;
+    if (parsed) {
+        stats.last_publish_time = publish_time;
+        stats.last_reload_latency = publish_time - change_time;
+        if (stats.last_reload_latency > stats.max_reload_latency)
+            stats.max_reload_latency = stats.last_reload_latency;
+    } else {
+        ++stats.num_failed_reloads;
+    }
+    mutex.unlock ();
+
+    if (parsed) {
+        logD (mconfig, _func, filename->mem(), " reloaded: parse ", parse_finish_time - change_time, " us, "
+              "publish ", publish_time - parse_finish_time, " us");
+    }
+}
+
+void
+ConfigWatcher::watcherThreadFunc ()
+{
+    Time const debounce_time = debounce_millis * 1000;
+    Time const max_delay_time = debounce_time * 10;
+
+    bool pending = false;
+    Time first_event_time = 0;
+    Time last_event_time = 0;
+
+    for (;;) {
+        int timeout_millis = -1;
+        if (pending) {
+            Time const now = getTimeMicroseconds ();
+            Time deadline = last_event_time + debounce_time;
+            if (deadline > first_event_time + max_delay_time)
+                deadline = first_event_time + max_delay_time;
+
+            if (now >= deadline) {
+                pending = false;
+                reload (first_event_time);
+                continue;
+            }
+
+            timeout_millis = (int) ((deadline - now + 999) / 1000);
+        }
+
+        struct pollfd fds [2];
+        fds [0].fd = inotify_fd;
+        fds [0].events = POLLIN;
+        fds [0].revents = 0;
+        fds [1].fd = stop_fds [0];
+        fds [1].events = POLLIN;
+        fds [1].revents = 0;
+
+        int const res = poll (fds, 2, timeout_millis);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            logE_ (_func, "poll() failed: ", strerror (errno));
+            break;
+        }
+
+        if (fds [1].revents)
+            break;
+
+        if (!fds [0].revents)
+            continue;
+
+        for (;;) {
+            union {
+                struct inotify_event event;
+                char buf [4096];
+            } events;
+
+            ssize_t const nread = read (inotify_fd, events.buf, sizeof (events.buf));
+            if (nread <= 0) {
+                if (nread == -1 && errno != EAGAIN && errno != EINTR)
+                    logE_ (_func, "read() failed: ", strerror (errno));
+                break;
+            }
+
+            Count num_relevant = 0;
+            for (ssize_t pos = 0; pos < nread; ) {
+                struct inotify_event const * const event = (struct inotify_event const *) (events.buf + pos);
+                pos += sizeof (struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                  // Events have been lost.
+                    ++num_relevant;
+                    continue;
+                }
+
+                if (event->len
+                    && isEventRelevant (event->wd, ConstMemory (event->name, strlen (event->name))))
+                {
+                    ++num_relevant;
+                }
+            }
+
+            if (num_relevant) {
+                Time const now = getTimeMicroseconds ();
+                if (!pending) {
+                    pending = true;
+                    first_event_time = now;
+                }
+                last_event_time = now;
+
+                mutex.lock ();
+                stats.num_events += num_relevant;
+                mutex.unlock ();
+            }
+        }
+    }
+}
+
+void
+ConfigWatcher::watcherThreadFunc (void * const _self)
+{
+    ConfigWatcher * const self = static_cast <ConfigWatcher*> (_self);
+    self->watcherThreadFunc ();
+}
+
+Result
+ConfigWatcher::start ()
+{
+    assert (!thread);
+
+    inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd == -1) {
+        logE_ (_func, "inotify_init1() failed: ", strerror (errno));
+        return Result::Failure;
+    }
+
+    if (pipe (stop_fds) == -1) {
+        logE_ (_func, "pipe() failed: ", strerror (errno));
+        close (inotify_fd);
+        inotify_fd = -1;
+        return Result::Failure;
+    }
+
+    updateWatches ();
+
+    thread = grab (new (std::nothrow) Thread (
+            CbDesc<Thread::ThreadFunc> (watcherThreadFunc, this, NULL /* coderef_container */)));
+    if (!thread->spawn (true /* joinable */)) {
+        logE_ (_func, "Thread::spawn() failed: ", exc->toString());
+        thread = NULL;
+        stop ();
+        return Result::Failure;
+    }
+
+    return Result::Success;
+}
+
+void
+ConfigWatcher::stop ()
+{
+    if (thread) {
+        Byte const byte = 0;
+        while (write (stop_fds [1], &byte, 1) == -1 && errno == EINTR);
+
+        if (!thread->join ())
+            logE_ (_func, "Thread::join() failed: ", exc->toString());
+
+        thread = NULL;
+    }
+
+    if (inotify_fd != -1) {
+        close (inotify_fd);
+        inotify_fd = -1;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        if (stop_fds [i] != -1) {
+            close (stop_fds [i]);
+            stop_fds [i] = -1;
+        }
+    }
+
+    for (WatchedFileList::Element *el = watched_files.first; el; el = el->next)
+        delete el->data;
+    watched_files.clear ();
+}
+
+#else
+
+Result
+ConfigWatcher::start ()
+{
+    logE_ (_func, "not supported on this platform");
+    return Result::Failure;
+}
+
+void
+ConfigWatcher::stop ()
+{
+}
+
+#endif
+
+void
+ConfigWatcher::addFile (ConstMemory const watch_filename)
+{
+    mutex.lock ();
+    extra_files.append (grab (new (std::nothrow) String (watch_filename)));
+    mutex.unlock ();
+}
+
+void
+ConfigWatcher::getStats (Stats * const mt_nonnull ret_stats)
+{
+    mutex.lock ();
+    *ret_stats = stats;
+    mutex.unlock ();
+}
+
+ConfigWatcher::ConfigWatcher (ConfigHolder     * const mt_nonnull holder,
+                              ConstMemory        const filename,
+                              ConfigParserMode   const mode,
+                              Time               const debounce_millis)
+    : holder          (holder),
+      filename        (grab (new (std::nothrow) String (filename))),
+      mode            (mode),
+      debounce_millis (debounce_millis),
+      inotify_fd      (-1)
+{
+    memset (&stats, 0, sizeof (stats));
+    stop_fds [0] = -1;
+    stop_fds [1] = -1;
+}
+
+ConfigWatcher::~ConfigWatcher ()
+{
+    stop ();
+}
+
+}
+
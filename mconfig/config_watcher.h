@@ -0,0 +1,139 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__CONFIG_WATCHER__H__
+#define MCONFIG__CONFIG_WATCHER__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config_holder.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Reloads a configuration file into a ConfigHolder when the file or any of
+// the files it includes changes. Linux only: changes are detected with inotify,
+// start() fails on other platforms.
+//
+// Parent directories are watched rather than the files themselves, so that
+// files replaced by rename() are noticed. Files which are rewritten in place
+// are noticed on every write, not only when they're closed, and they are read
+// into memory rather than mmap'ed, as they may be truncated during a parse.
+// A burst of writes is coalesced into one reparse: the file is parsed once no
+// relevant event has arrived for @debounce_millis, but no later than
+// 10 * @debounce_millis after the first event of the burst. Parsing and
+// publishing happen in the watcher's thread.
+class ConfigWatcher : public Object
+{
+public:
+    // Times are in microseconds as returned by getTimeMicroseconds(), zero
+    // if there has been no such event yet.
+    struct Stats
+    {
+        // Filesystem events which concerned watched files.
+        Count num_events;
+        // One per coalesced burst of events.
+        Count num_reloads;
+        Count num_failed_reloads;
+
+        // First event of the burst which caused the last reload.
+        Time last_change_time;
+        Time last_parse_finish_time;
+        Time last_publish_time;
+
+        // last_publish_time - last_change_time for the last published snapshot.
+        Time last_reload_latency;
+        Time max_reload_latency;
+    };
+
+private:
+    struct WatchedFile
+    {
+        Ref<String> filename;
+        // Directory part of filename, used for the inotify watch.
+        Ref<String> dir;
+        ConstMemory name;
+        int wd;
+    };
+
+    typedef List<WatchedFile*> WatchedFileList;
+
+    Mutex mutex;
+
+    mt_const Ref<ConfigHolder> holder;
+    mt_const Ref<String> filename;
+    mt_const ConfigParserMode mode;
+    mt_const Time debounce_millis;
+
+    mt_mutex (mutex) Stats stats;
+
+    // Files added with addFile().
+    mt_mutex (mutex) List< Ref<String> > extra_files;
+
+    // Accessed by the watcher thread only once it's started.
+    WatchedFileList watched_files;
+
+    int inotify_fd;
+    int stop_fds [2];
+
+    Ref<Thread> thread;
+
+    void addWatch (ConstMemory watch_filename);
+
+    void updateWatches ();
+
+    bool isEventRelevant (int wd, ConstMemory name);
+
+    void reload (Time change_time);
+
+    void watcherThreadFunc ();
+
+    static void watcherThreadFunc (void *_self);
+
+public:
+    // Files which are not reachable through #include "..." directives can be
+    // added explicitly. Call before start().
+    void addFile (ConstMemory watch_filename);
+
+    // Starts the watcher thread. The current contents of the file are not
+    // loaded, call ConfigHolder::reload() for the initial snapshot.
+    Result start ();
+
+    // Stops the watcher thread and waits for it to exit.
+    void stop ();
+
+    void getStats (Stats * mt_nonnull ret_stats);
+
+    ConfigWatcher (ConfigHolder     * mt_nonnull holder,
+                   ConstMemory       filename,
+                   ConfigParserMode  mode = ConfigParserMode_Auto,
+                   Time              debounce_millis = 100);
+
+    ~ConfigWatcher ();
+};
+
+}
+
+
+#endif /* MCONFIG__CONFIG_WATCHER__H__ */
+
@@ -0,0 +1,158 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <libmary/libmary.h>
+
+#include <cstring>
+
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <mconfig/mapped_file.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
+
+// Reads until EOF rather than trusting the file size, which is 0 for pipes and
+// for many special files.
+Result
+MappedFile::readFile (NativeFile  * const mt_nonnull file,
+                      ConstMemory   const filename,
+                      FileSize      const size_hint)
+{
+    Size size = 4096;
+  // One extra byte lets EOF be seen without growing the buffer.
+    if (size_hint > 0 && size_hint < (FileSize) (Size) -1)
+        size = (Size) size_hint + 1;
+
+    buf = new (std::nothrow) Byte [size];
+    assert (buf);
+
+    for (;;) {
+        if (len == size) {
+            Byte * const new_buf = new (std::nothrow) Byte [size * 2];
+            assert (new_buf);
+            memcpy (new_buf, buf, len);
+            delete[] buf;
+            buf = new_buf;
+            size *= 2;
+        }
+
+        Size nread = 0;
+        IoResult const res = file->read (Memory (buf + len, size - len), &nread);
+        if (res == IoResult::Error) {
+            logE_ (_func, "Read error for ", filename, ": ", exc->toString());
+            close ();
+            return Result::Failure;
+        }
+
+        if (res == IoResult::Eof)
+            break;
+
+        len += nread;
+    }
+
+    if (len == 0) {
+        delete[] buf;
+        buf = NULL;
+    }
+
+    return Result::Success;
+}
+
+Result
+MappedFile::open (ConstMemory const filename,
+                  bool        const log_open_error,
+                  bool        const allow_mmap)
+{
+    close ();
+
+    NativeFile file;
+    if (!file.open (filename, 0 /* open_flags */, FileAccessMode::ReadOnly)) {
+        if (log_open_error)
+            logE_ (_func, "Could not open ", filename, ": ", exc->toString());
+        else
+            logD (mconfig, _func, "Could not open ", filename, ": ", exc->toString());
+
+        return Result::Failure;
+    }
+
+    FileStat fs;
+    if (!file.stat (&fs)) {
+        logE_ (_func, "NativeFile::stat() failed for ", filename, ": ", exc->toString());
+        return Result::Failure;
+    }
+
+#ifndef LIBMARY_PLATFORM_WIN32
+  // Only non-empty regular files are mapped: mmap() doesn't accept zero
+  // length, and special files may report any size.
+    if (allow_mmap) {
+        struct stat st;
+        if (fstat (file.getFd(), &st) == 0
+            && S_ISREG (st.st_mode)
+            && st.st_size > 0
+            && (Uint64) (Size) st.st_size == (Uint64) st.st_size)
+        {
+            void * const map = mmap (NULL, (Size) st.st_size, PROT_READ, MAP_PRIVATE, file.getFd(), 0);
+            if (map != MAP_FAILED) {
+                madvise (map, (Size) st.st_size, MADV_SEQUENTIAL);
+
+                buf = (Byte*) map;
+                len = (Size) st.st_size;
+                mapped = true;
+
+                file.close (false /* flush_data */);
+                return Result::Success;
+            }
+
+            logD (mconfig, _func, "mmap() failed for ", filename, ", reading the file");
+        }
+    }
+#endif
+
+    Result const res = readFile (&file, filename, fs.size);
+    file.close (false /* flush_data */);
+    return res;
+}
+
+void
+MappedFile::close ()
+{
+    if (buf) {
+#ifndef LIBMARY_PLATFORM_WIN32
+        if (mapped)
+            munmap (buf, len);
+        else
+#endif
+            delete[] buf;
+    }
+
+    buf = NULL;
+    len = 0;
+    mapped = false;
+}
+
+}
+
@@ -0,0 +1,86 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MCONFIG__MAPPED_FILE__H__
+#define MCONFIG__MAPPED_FILE__H__
+
+
+#include <libmary/libmary.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Read-only view of the whole contents of a file, which is read into a heap
+// buffer or, on request, mmap'ed.
+class MappedFile
+{
+private:
+    Byte *buf;
+    Size  len;
+    bool  mapped;
+
+    Result readFile (NativeFile  * mt_nonnull file,
+                     ConstMemory   filename,
+                     FileSize      size_hint);
+
+public:
+    // Failures to open the file are logged at debug level if @log_open_error
+    // is false, for files which may legitimately be missing.
+    //
+    // If @allow_mmap is true, then non-empty regular files are mmap'ed. Only
+    // for files which are never truncated while they are in use, like files
+    // replaced with rename(): accessing pages of a mapping past the new end
+    // of the file raises SIGBUS. Other files are read until EOF, so pipes and
+    // special files which report zero size are read correctly.
+    Result open (ConstMemory filename,
+                 bool        log_open_error = true,
+                 bool        allow_mmap = false);
+
+    void close ();
+
+    ConstMemory getMem () const
+    {
+        return ConstMemory (buf, len);
+    }
+
+    bool isMapped () const
+    {
+        return mapped;
+    }
+
+    MappedFile ()
+        : buf    (NULL),
+          len    (0),
+          mapped (false)
+    {
+    }
+
+    ~MappedFile ()
+    {
+        close ();
+    }
+};
+
+}
+
+
+#endif /* MCONFIG__MAPPED_FILE__H__ */
+
@@ -24,10 +24,20 @@
 #include <mconfig/util.h>
 
 #include <mconfig/config.h>
+#include <mconfig/config_path.h>
+#include <mconfig/config_lookup_stats.h>
+#include <mconfig/config_serializer.h>
+#include <mconfig/parse_stats.h>
 #include <mconfig/config_parser.h>
+#include <mconfig/config_set.h>
+#include <mconfig/config_diff.h>
+#include <mconfig/config_holder.h>
+#include <mconfig/config_watcher.h>
+#include <mconfig/compiled_config.h>
 
 #include <mconfig/varlist.h>
 #include <mconfig/varlist_parser.h>
+#include <mconfig/var_expander.h>
 
 
 #endif /* MCONFIG__MCONFIG__H__ */
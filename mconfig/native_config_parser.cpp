@@ -0,0 +1,962 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config_builder.h>
+#include <mconfig/native_config_parser.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+static LogGroup libMary_logGroup_mconfig ("mconfig", LogLevel::I);
+
+namespace {
+
+enum {
+    CharClass_Other = 0,
+    CharClass_Space = 1,
+    CharClass_Alpha = 2,
+    CharClass_Digit = 4
+};
+
+class CharTable
+{
+public:
+    Byte classes [256];
+
+    CharTable ()
+    {
+        memset (classes, CharClass_Other, sizeof (classes));
+
+        classes [(Byte) ' ']  = CharClass_Space;
+        classes [(Byte) '\t'] = CharClass_Space;
+        classes [(Byte) '\v'] = CharClass_Space;
+        classes [(Byte) '\f'] = CharClass_Space;
+        classes [(Byte) '\r'] = CharClass_Space;
+
+        for (unsigned c = 'a'; c <= 'z'; ++c)
+            classes [c] = CharClass_Alpha;
+        for (unsigned c = 'A'; c <= 'Z'; ++c)
+            classes [c] = CharClass_Alpha;
+        classes [(Byte) '_'] = CharClass_Alpha;
+
+        for (unsigned c = '0'; c <= '9'; ++c)
+            classes [c] = CharClass_Digit;
+    }
+};
+
+CharTable const char_table;
+
+struct Token
+{
+    enum Type {
+        Eof,
+        Word,
+        Equals,
+        Comma,
+        // ';' or a newline.
+        Semicolon,
+        LBrace,
+        RBrace,
+        // Tokens which are neither words nor punctuation known to the grammar:
+        // '#', "==", unterminated literals and comments.
+        Invalid,
+        // '#' at the beginning of a line.
+        Directive
+    };
+
+    Type type;
+    ConstMemory mem;
+    // Position of the token in the source, for error messages.
+    Byte const *pos;
+};
+
+class NativeLexer
+{
+private:
+    Byte const * const buf_start;
+    Byte const * const end;
+    Byte const *pos;
+
+    bool line_start;
+
+    // Copies of tokens with line splices ("\\\n") removed.
+    List< Ref<String> > spliced_tokens;
+
+    Size spliceLen (Byte const * const p) const
+    {
+        if (p >= end || p [0] != '\\')
+            return 0;
+
+        if (p + 1 < end && p [1] == '\n')
+            return 2;
+
+        if (p + 2 < end && p [1] == '\r' && p [2] == '\n')
+            return 3;
+
+        return 0;
+    }
+
+    Byte const* skipSplices (Byte const *p) const
+    {
+        Size len;
+        while ((len = spliceLen (p)))
+            p += len;
+
+        return p;
+    }
+
+    ConstMemory makeTokenMem (Byte const *token_start,
+                              Byte const *token_end,
+                              bool        spliced);
+
+    Byte const* skipComment (Byte const *p);
+
+    Size punctuatorLen (Byte const *p) const;
+
+public:
+    void nextToken (Token *ret_token);
+
+    void releaseSplicedTokens ()
+    {
+        spliced_tokens.clear ();
+    }
+
+    Count getLineNumber (Byte const * const p) const
+    {
+        Count line = 1;
+        Byte const *cur = buf_start;
+        while (cur < p) {
+            Byte const * const nl = (Byte const *) memchr (cur, '\n', p - cur);
+            if (!nl)
+                break;
+
+            ++line;
+            cur = nl + 1;
+        }
+
+        return line;
+    }
+
+    NativeLexer (ConstMemory const mem)
+        : buf_start  (mem.mem()),
+          end        (mem.mem() + mem.len()),
+          pos        (mem.mem()),
+          line_start (true)
+    {
+    }
+};
+
+ConstMemory
+NativeLexer::makeTokenMem (Byte const * const token_start,
+                           Byte const * const token_end,
+                           bool         const spliced)
+{
+    if (!spliced)
+        return ConstMemory (token_start, token_end - token_start);
+
+    Size len = 0;
+    for (Byte const *p = token_start; p < token_end; ) {
+        if (Size const splice_len = spliceLen (p)) {
+            p += splice_len;
+            continue;
+        }
+
+        ++len;
+        ++p;
+    }
+
+    Ref<String> const str = grab (new (std::nothrow) String (len));
+    {
+        Byte *dst = str->mem().mem();
+        for (Byte const *p = token_start; p < token_end; ) {
+            if (Size const splice_len = spliceLen (p)) {
+                p += splice_len;
+                continue;
+            }
+
+            *dst = *p;
+            ++dst;
+            ++p;
+        }
+    }
+
+    spliced_tokens.append (str);
+    return str->mem();
+}
+
+// Returns the position after a comment starting at @p, @p if there's no
+// comment at @p, or NULL for an unterminated block comment.
+Byte const*
+NativeLexer::skipComment (Byte const * const p)
+{
+    if (*p != '/')
+        return p;
+
+    Byte const * const next = skipSplices (p + 1);
+    if (next >= end)
+        return p;
+
+    if (*next == '/') {
+      // Line comment. The terminating newline is left in place. A line splice
+      // continues the comment onto the next line.
+        Byte const *cur = next + 1;
+        for (;;) {
+            Byte const * const nl = (Byte const *) memchr (cur, '\n', end - cur);
+            if (!nl)
+                return end;
+
+            if ((nl - 1 >= cur && nl [-1] == '\\') ||
+                (nl - 2 >= cur && nl [-1] == '\r' && nl [-2] == '\\'))
+            {
+                cur = nl + 1;
+                continue;
+            }
+
+            return nl;
+        }
+    }
+
+    if (*next == '*') {
+      // Block comment. Newlines within the comment are not reported, just like
+      // the C preprocessor replaces the whole comment with a single space.
+        Byte const *cur = next + 1;
+        for (;;) {
+            Byte const * const star = (Byte const *) memchr (cur, '*', end - cur);
+            if (!star)
+                return NULL;
+
+            Byte const * const slash = skipSplices (star + 1);
+            if (slash < end && *slash == '/')
+                return slash + 1;
+
+            cur = star + 1;
+        }
+    }
+
+    return p;
+}
+
+// Punctuators are glued into keys and values without whitespace, so the only
+// thing that matters is how they group with a trailing '=': "a += b" declares
+// an option named "a+=b", not an option "a+" with value "b".
+Size
+NativeLexer::punctuatorLen (Byte const * const p) const
+{
+    Size const avail = end - p;
+    Byte const c = p [0];
+    Byte const c1 = avail > 1 ? p [1] : 0;
+    Byte const c2 = avail > 2 ? p [2] : 0;
+
+    switch (c) {
+        case '<':
+        case '>':
+            if (c1 == c)
+                return c2 == '=' ? 3 : 2;
+            return c1 == '=' ? 2 : 1;
+        case '-':
+            if (c1 == '>')
+                return c2 == '*' ? 3 : 2;
+            return (c1 == '-' || c1 == '=') ? 2 : 1;
+        case '+':
+        case '&':
+        case '|':
+            return (c1 == c || c1 == '=') ? 2 : 1;
+        case '*':
+        case '/':
+        case '%':
+        case '^':
+        case '!':
+            return c1 == '=' ? 2 : 1;
+        case ':':
+            return c1 == ':' ? 2 : 1;
+        case '.':
+            if (c1 == '.' && c2 == '.')
+                return 3;
+            return c1 == '*' ? 2 : 1;
+    }
+
+    return 1;
+}
+
+void
+NativeLexer::nextToken (Token * const mt_nonnull ret_token)
+{
+    for (;;) {
+        pos = skipSplices (pos);
+        if (pos >= end) {
+            ret_token->type = Token::Eof;
+            ret_token->mem = ConstMemory();
+            ret_token->pos = end;
+            return;
+        }
+
+        Byte const c = *pos;
+        if (char_table.classes [c] & CharClass_Space) {
+            ++pos;
+            continue;
+        }
+
+        if (c == '\n') {
+            ret_token->type = Token::Semicolon;
+            ret_token->mem = ConstMemory (";");
+            ret_token->pos = pos;
+            ++pos;
+            line_start = true;
+            return;
+        }
+
+        if (c == '/') {
+            Byte const * const next = skipComment (pos);
+            if (!next) {
+                ret_token->type = Token::Invalid;
+                ret_token->mem = ConstMemory (pos, end - pos);
+                ret_token->pos = pos;
+                pos = end;
+                return;
+            }
+
+            if (next != pos) {
+                pos = next;
+                continue;
+            }
+        }
+
+        break;
+    }
+
+    Byte const * const start = pos;
+    bool const at_line_start = line_start;
+    line_start = false;
+
+    ret_token->pos = start;
+
+    Byte const c = *start;
+    Byte const c_class = char_table.classes [c];
+
+    if (c_class & CharClass_Alpha) {
+        Byte const *p = start + 1;
+        bool spliced = false;
+        for (;;) {
+            if (Size const splice_len = spliceLen (p)) {
+                p += splice_len;
+                spliced = true;
+                continue;
+            }
+
+            if (p >= end || !(char_table.classes [*p] & (CharClass_Alpha | CharClass_Digit)))
+                break;
+
+            ++p;
+        }
+
+        ret_token->type = Token::Word;
+        ret_token->mem = makeTokenMem (start, p, spliced);
+        pos = p;
+        return;
+    }
+
+    if ((c_class & CharClass_Digit) ||
+        (c == '.' && start + 1 < end && (char_table.classes [start [1]] & CharClass_Digit)))
+    {
+      // pp-number
+        Byte const *p = start + 1;
+        Byte prv = c;
+        bool spliced = false;
+        for (;;) {
+            if (Size const splice_len = spliceLen (p)) {
+                p += splice_len;
+                spliced = true;
+                continue;
+            }
+
+            if (p >= end)
+                break;
+
+            Byte const nc = *p;
+            if (!(char_table.classes [nc] & (CharClass_Alpha | CharClass_Digit))
+                && nc != '.'
+                && !((nc == '+' || nc == '-') && (prv == 'e' || prv == 'E')))
+            {
+                break;
+            }
+
+            prv = nc;
+            ++p;
+        }
+
+        ret_token->type = Token::Word;
+        ret_token->mem = makeTokenMem (start, p, spliced);
+        pos = p;
+        return;
+    }
+
+    if (c == '"' || c == '\'') {
+        Byte const *p = start + 1;
+        bool spliced = false;
+        bool terminated = false;
+        for (;;) {
+            if (p >= end || *p == '\n')
+                break;
+
+            if (*p == '\\') {
+                if (Size const splice_len = spliceLen (p)) {
+                    p += splice_len;
+                    spliced = true;
+                    continue;
+                }
+
+                Byte const * const escaped = skipSplices (p + 1);
+                if (escaped != p + 1)
+                    spliced = true;
+
+                if (escaped >= end || *escaped == '\n') {
+                    p = escaped;
+                    continue;
+                }
+
+                p = escaped + 1;
+                continue;
+            }
+
+            if (*p == c) {
+                ++p;
+                terminated = true;
+                break;
+            }
+
+            ++p;
+        }
+
+        if (!terminated) {
+            if (c == '\'') {
+              // A lone apostrophe is an ordinary character.
+                ret_token->type = Token::Word;
+                ret_token->mem = ConstMemory (start, 1);
+                pos = start + 1;
+                return;
+            }
+
+            ret_token->type = Token::Invalid;
+            ret_token->mem = ConstMemory (start, p - start);
+            pos = p;
+            return;
+        }
+
+        ret_token->type = Token::Word;
+        ret_token->mem = makeTokenMem (start, p, spliced);
+        pos = p;
+        return;
+    }
+
+    switch (c) {
+        case '{':
+            ret_token->type = Token::LBrace;
+            ret_token->mem = ConstMemory (start, 1);
+            pos = start + 1;
+            return;
+        case '}':
+            ret_token->type = Token::RBrace;
+            ret_token->mem = ConstMemory (start, 1);
+            pos = start + 1;
+            return;
+        case ',':
+            ret_token->type = Token::Comma;
+            ret_token->mem = ConstMemory (start, 1);
+            pos = start + 1;
+            return;
+        case ';':
+            ret_token->type = Token::Semicolon;
+            ret_token->mem = ConstMemory (start, 1);
+            pos = start + 1;
+            return;
+        case '=': {
+            Size const len = (start + 1 < end && start [1] == '=') ? 2 : 1;
+            ret_token->type = (len == 1 ? Token::Equals : Token::Invalid);
+            ret_token->mem = ConstMemory (start, len);
+            pos = start + len;
+        } return;
+        case '#': {
+            Size const len = (start + 1 < end && start [1] == '#') ? 2 : 1;
+            ret_token->type = (at_line_start ? Token::Directive : Token::Invalid);
+            ret_token->mem = ConstMemory (start, len);
+            pos = start + len;
+        } return;
+    }
+
+    Size const len = punctuatorLen (start);
+    ret_token->type = Token::Word;
+    ret_token->mem = ConstMemory (start, len);
+    pos = start + len;
+}
+
+// Reusable buffer which only grows.
+template <class T>
+class ScratchBuffer
+{
+private:
+    T     *buf;
+    Count  size;
+
+public:
+    T* get (Count const num_elems)
+    {
+        if (num_elems > size) {
+            delete[] buf;
+            size = (num_elems > 64 ? num_elems : 64);
+            buf = new (std::nothrow) T [size];
+            assert (buf);
+        }
+
+        return buf;
+    }
+
+    ScratchBuffer ()
+        : buf  (NULL),
+          size (0)
+    {
+    }
+
+    ~ScratchBuffer ()
+    {
+        delete[] buf;
+    }
+};
+
+class NativeConfigParser
+{
+private:
+    NativeLexer lexer;
+    ConstMemory const filename;
+
+    ConfigEvents const * const events;
+    void * const cb_data;
+
+    // Total number of tokens read.
+    Count num_total_tokens;
+
+    // Tokens of the current section entry.
+    Token *tokens;
+    Count  num_tokens;
+    Count  tokens_size;
+
+    ScratchBuffer<ConfigAttributeDesc> attrs_buf;
+    ScratchBuffer<ConstMemory> values_buf;
+    // Storage for multi-word keys and values.
+    ScratchBuffer<Byte> word_buf;
+
+    void appendToken (Token const &token)
+    {
+        if (num_tokens == tokens_size) {
+            Count const new_size = (tokens_size ? tokens_size * 2 : 64);
+            Token * const new_tokens = new (std::nothrow) Token [new_size];
+            assert (new_tokens);
+            if (num_tokens)
+                memcpy (new_tokens, tokens, num_tokens * sizeof (Token));
+
+            delete[] tokens;
+            tokens = new_tokens;
+            tokens_size = new_size;
+        }
+
+        tokens [num_tokens] = token;
+        ++num_tokens;
+    }
+
+    static Size wordsLen (Token const *words,
+                          Count        num_words);
+
+    // Glues @words together into @buf, which must be at least
+    // wordsLen (words, num_words) bytes long.
+    static ConstMemory wordsToMem (Token const *words,
+                                   Count        num_words,
+                                   Byte        *buf);
+
+    Result acceptOption ();
+
+    Result beginSection ();
+
+    Result syntaxError (Token const &token);
+
+public:
+    Result parse ();
+
+    Count getNumTokens () const
+    {
+        return num_total_tokens;
+    }
+
+    NativeConfigParser (ConstMemory          const mem,
+                        ConstMemory          const filename,
+                        ConfigEvents const * const mt_nonnull events,
+                        void               * const cb_data)
+        : lexer            (mem),
+          filename         (filename),
+          events           (events),
+          cb_data          (cb_data),
+          num_total_tokens (0),
+          tokens           (NULL),
+          num_tokens       (0),
+          tokens_size      (0)
+    {
+    }
+
+    ~NativeConfigParser ()
+    {
+        delete[] tokens;
+    }
+};
+
+Size
+NativeConfigParser::wordsLen (Token const * const words,
+                              Count         const num_words)
+{
+    if (num_words < 2)
+        return 0;
+
+    Size str_len = 0;
+    ConstMemory prv_word;
+    for (Count i = 0; i < num_words; ++i) {
+        ConstMemory const word = unquoteWord (words [i].mem);
+        str_len += word.len();
+
+        if (whitespaceBetweenWordsNeeded (prv_word, word))
+            ++str_len;
+
+        prv_word = word;
+    }
+
+    return str_len;
+}
+
+ConstMemory
+NativeConfigParser::wordsToMem (Token const * const words,
+                                Count         const num_words,
+                                Byte        * const buf)
+{
+    if (num_words == 0)
+        return ConstMemory();
+
+    if (num_words == 1)
+        return unquoteWord (words [0].mem);
+
+    Size pos = 0;
+    ConstMemory prv_word;
+    for (Count i = 0; i < num_words; ++i) {
+        ConstMemory const word = unquoteWord (words [i].mem);
+
+        if (whitespaceBetweenWordsNeeded (prv_word, word)) {
+            buf [pos] = ' ';
+            ++pos;
+        }
+
+        memcpy (buf + pos, word.mem(), word.len());
+        pos += word.len();
+
+        prv_word = word;
+    }
+
+    return ConstMemory (buf, pos);
+}
+
+//   KeyValue) key [=] value [;]
+//   Key)      key [;]
+//
+Result
+NativeConfigParser::acceptOption ()
+{
+    Count key_len = 0;
+    while (key_len < num_tokens && tokens [key_len].type == Token::Word)
+        ++key_len;
+
+    if (key_len == 0)
+        return Result::Failure;
+
+    Count num_values = 0;
+    if (key_len < num_tokens) {
+        if (tokens [key_len].type != Token::Equals)
+            return Result::Failure;
+
+        num_values = 1;
+        for (Count i = key_len + 1; i < num_tokens; ++i) {
+            if (tokens [i].type == Token::Comma) {
+                ++num_values;
+                continue;
+            }
+
+            if (tokens [i].type != Token::Word)
+                return Result::Failure;
+        }
+    }
+
+    if (!events->option)
+        return Result::Success;
+
+    Size total_len = wordsLen (tokens, key_len);
+    if (num_values) {
+        Count value_start = key_len + 1;
+        for (Count i = key_len + 1; i <= num_tokens; ++i) {
+            if (i == num_tokens || tokens [i].type == Token::Comma) {
+                total_len += wordsLen (tokens + value_start, i - value_start);
+                value_start = i + 1;
+            }
+        }
+    }
+
+    Byte * const buf = word_buf.get (total_len);
+    Size buf_pos = 0;
+
+    ConstMemory const key = wordsToMem (tokens, key_len, buf);
+    if (key.mem() == buf)
+        buf_pos += key.len();
+
+    ConstMemory * const values = values_buf.get (num_values);
+    if (num_values) {
+        Count value_idx = 0;
+        Count value_start = key_len + 1;
+        for (Count i = key_len + 1; i <= num_tokens; ++i) {
+            if (i == num_tokens || tokens [i].type == Token::Comma) {
+                ConstMemory const value = wordsToMem (tokens + value_start, i - value_start, buf + buf_pos);
+                if (value.mem() == buf + buf_pos)
+                    buf_pos += value.len();
+
+                values [value_idx] = value;
+                ++value_idx;
+                value_start = i + 1;
+            }
+        }
+        assert (value_idx == num_values);
+    }
+
+    if (!events->option (key, values, num_values, cb_data))
+        return Result::Failure;
+
+    return Result::Success;
+}
+
+//   section: <name> word_opt attribute_opt_seq [{]
+//
+// The name is optional: in "a = b {", "a" is the name of an attribute of
+// a name-less section, as in the pargen grammar, which backtracks there.
+//
+Result
+NativeConfigParser::beginSection ()
+{
+    Count attrs_start = 0;
+    ConstMemory section_name;
+    if (num_tokens > 0
+        && tokens [0].type == Token::Word
+        && !(num_tokens > 1 && tokens [1].type == Token::Equals))
+    {
+        section_name = tokens [0].mem;
+        attrs_start = 1;
+    }
+
+    ConfigAttributeDesc * const attrs = attrs_buf.get (num_tokens);
+    Count num_attrs = 0;
+
+    for (Count i = attrs_start; i < num_tokens; ) {
+        if (tokens [i].type != Token::Word)
+            return Result::Failure;
+
+        ConfigAttributeDesc &attr = attrs [num_attrs];
+        ++num_attrs;
+
+        attr.name = tokens [i].mem;
+        if (i + 1 < num_tokens && tokens [i + 1].type == Token::Equals) {
+            if (i + 2 >= num_tokens || tokens [i + 2].type != Token::Word)
+                return Result::Failure;
+
+            attr.value = tokens [i + 2].mem;
+            attr.has_value = true;
+            i += 3;
+        } else {
+            attr.value = ConstMemory();
+            attr.has_value = false;
+            i += 1;
+        }
+    }
+
+    if (events->beginSection
+        && !events->beginSection (section_name, attrs, num_attrs, cb_data))
+    {
+        return Result::Failure;
+    }
+
+    return Result::Success;
+}
+
+Result
+NativeConfigParser::syntaxError (Token const &token)
+{
+    if (token.type == Token::Directive) {
+        logE_ (_func, "Unexpected preprocessor directive in configuration file ", filename,
+               ", line ", lexer.getLineNumber (token.pos));
+        return Result::Failure;
+    }
+
+    logE_ (_func, "Syntax error in configuration file ", filename,
+           ", line ", lexer.getLineNumber (token.pos));
+    return Result::Failure;
+}
+
+Result
+NativeConfigParser::parse ()
+{
+    Count depth = 0;
+    for (;;) {
+        num_tokens = 0;
+        lexer.releaseSplicedTokens ();
+
+        Token token;
+        for (;;) {
+            lexer.nextToken (&token);
+            ++num_total_tokens;
+
+            if (token.type == Token::Word   ||
+                token.type == Token::Equals ||
+                token.type == Token::Comma)
+            {
+                appendToken (token);
+                continue;
+            }
+
+            break;
+        }
+
+        switch (token.type) {
+            case Token::Semicolon: {
+                if (num_tokens > 0 && !acceptOption ())
+                    return syntaxError (token);
+            } break;
+            case Token::LBrace: {
+                if (!beginSection ())
+                    return syntaxError (token);
+
+                ++depth;
+            } break;
+            case Token::RBrace: {
+                if (num_tokens > 0 || depth == 0)
+                    return syntaxError (token);
+
+                if (events->endSection && !events->endSection (cb_data))
+                    return syntaxError (token);
+
+                --depth;
+            } break;
+            case Token::Eof: {
+                if (num_tokens > 0 || depth > 0)
+                    return syntaxError (token);
+
+                return Result::Success;
+            } break;
+            default:
+                return syntaxError (token);
+        }
+    }
+
+    unreachable ();
+    return Result::Failure;
+}
+
+} // namespace {}
+
+bool
+nativeConfigNeedsPreprocessing (ConstMemory const mem)
+{
+    if (mem.len() == 0 ||
+        !memchr (mem.mem(), '#', mem.len()))
+    {
+        return false;
+    }
+
+  // '#' may appear in string literals and comments, so the input has to be
+  // tokenized to tell for sure.
+    NativeLexer lexer (mem);
+    for (;;) {
+        Token token;
+        lexer.nextToken (&token);
+        if (token.type == Token::Directive)
+            return true;
+
+        if (token.type == Token::Eof)
+            return false;
+
+        lexer.releaseSplicedTokens ();
+    }
+}
+
+void
+nativeConfigGetIncludes (ConstMemory                const mem,
+                         IncludeDirectiveCallback   const mt_nonnull cb,
+                         void                     * const cb_data)
+{
+    if (mem.len() == 0 ||
+        !memchr (mem.mem(), '#', mem.len()))
+    {
+        return;
+    }
+
+    NativeLexer lexer (mem);
+    Token token;
+    lexer.nextToken (&token);
+    while (token.type != Token::Eof) {
+        if (token.type != Token::Directive) {
+            lexer.releaseSplicedTokens ();
+            lexer.nextToken (&token);
+            continue;
+        }
+
+        lexer.nextToken (&token);
+        if (token.type != Token::Word || !equal (token.mem, ConstMemory ("include")))
+            continue;
+
+        lexer.nextToken (&token);
+        if (token.type == Token::Word
+            && token.mem.len() >= 2
+            && token.mem.mem() [0] == '"')
+        {
+            cb (unquoteWord (token.mem), cb_data);
+        }
+    }
+}
+
+Result
+parseConfig_native (ConstMemory          const mem,
+                    ConstMemory          const filename,
+                    ConfigEvents const * const mt_nonnull events,
+                    void               * const cb_data,
+                    Count              * const ret_num_tokens)
+{
+    logD (mconfig, _func, "filename: ", filename);
+
+    NativeConfigParser parser (mem, filename, events, cb_data);
+    Result const res = parser.parse ();
+
+    if (ret_num_tokens)
+        *ret_num_tokens = parser.getNumTokens ();
+
+    return res;
+}
+
+}
+
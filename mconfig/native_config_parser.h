@@ -0,0 +1,61 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef MCONFIG__NATIVE_CONFIG_PARSER__H__
+#define MCONFIG__NATIVE_CONFIG_PARSER__H__
+
+
+#include <libmary/libmary.h>
+
+#include <mconfig/config_parser.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Returns true if @mem contains preprocessor directives. Such input has to go
+// through Scruffy::CppPreprocessor and cannot be handled by the native parser.
+bool nativeConfigNeedsPreprocessing (ConstMemory mem);
+
+typedef void (*IncludeDirectiveCallback) (ConstMemory  include_name,
+                                          void        *cb_data);
+
+// Calls @cb for every '#include "name"' directive in @mem, with the name as
+// written, without quotes. Includes of the <name> form are skipped.
+void nativeConfigGetIncludes (ConstMemory               mem,
+                              IncludeDirectiveCallback  mt_nonnull cb,
+                              void                     *cb_data);
+
+// Single-pass parser for mconfig.par grammar which works directly on @mem.
+// Tokenization follows the rules of the C preprocessor (comments, line
+// splicing, pp-numbers, string literals), newlines act as ';'.
+// @filename is used for error messages only. If @ret_num_tokens is non-NULL,
+// the number of tokens read is stored there, on failure as well.
+Result parseConfig_native (ConstMemory         mem,
+                           ConstMemory         filename,
+                           ConfigEvents const * mt_nonnull events,
+                           void               *cb_data,
+                           Count              *ret_num_tokens = NULL);
+
+}
+
+
+#endif /* MCONFIG__NATIVE_CONFIG_PARSER__H__ */
+
@@ -0,0 +1,64 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+
+#include <time.h>
+
+#include <mconfig/parse_stats.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+#ifndef LIBMARY_PLATFORM_WIN32
+static Uint64
+clockNanosec (clockid_t const clock_id)
+{
+    struct timespec ts;
+    if (clock_gettime (clock_id, &ts) != 0)
+        return 0;
+
+    return (Uint64) ts.tv_sec * 1000000000 + (Uint64) ts.tv_nsec;
+}
+#endif
+
+Uint64
+getParseWallNanosec ()
+{
+#ifndef LIBMARY_PLATFORM_WIN32
+    return clockNanosec (CLOCK_MONOTONIC);
+#else
+    return (Uint64) getTimeMicroseconds () * 1000;
+#endif
+}
+
+Uint64
+getParseCpuNanosec ()
+{
+#if !defined (LIBMARY_PLATFORM_WIN32) && defined (CLOCK_THREAD_CPUTIME_ID)
+    return clockNanosec (CLOCK_THREAD_CPUTIME_ID);
+#else
+    return 0;
+#endif
+}
+
+}
+
@@ -0,0 +1,178 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+
+#ifndef MCONFIG__PARSE_STATS__H__
+#define MCONFIG__PARSE_STATS__H__
+
+
+#include <libmary/libmary.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Filled by parseConfig*() and VarlistParser::parseVarlist() when requested.
+// Collecting the stats costs a few clock reads per parse plus one per 16
+// parser events, so it may be left on in production.
+struct ParseStats
+{
+    enum Phase {
+        // Opening and mapping the file.
+        Phase_Read,
+        // Scruffy preprocessor. Zero for files handled by the native parser.
+        Phase_Preprocess,
+        // Tokenization and parsing, including tree building.
+        Phase_Parse,
+        Phase_Num
+    };
+
+    Uint64 wall_nanosec [Phase_Num];
+    // CPU time of the calling thread.
+    Uint64 cpu_nanosec  [Phase_Num];
+
+    // Part of Phase_Parse wall time spent in parser event callbacks, which is
+    // where the tree is built. Estimated by timing every 16th event.
+    Uint64 build_wall_nanosec;
+
+    bool used_preprocessor;
+
+    // Size of the input. Not known for files which ConfigParserMode_Pargen
+    // reads through the preprocessor directly.
+    Size  num_bytes;
+    // Tokens seen by the native parser.
+    Count num_tokens;
+    // Preprocessor output items.
+    Count num_pp_items;
+    // Pargen checkpoints, and those of them which were rolled back because
+    // an alternative did not match. Zero for the native parser, which never
+    // backtracks.
+    Count num_checkpoints;
+    Count num_backtracks;
+
+    // Parser events. Options are counted on every occurrence, including
+    // repeated options which replace each other in a Config.
+    Count num_sections;
+    Count num_options;
+    Count num_values;
+    Count num_attributes;
+    // Varlists only.
+    Count num_vars;
+    Count num_section_specs;
+
+    // Memory allocated for the nodes and strings of the resulting Config or
+    // Varlist. Names interned in a ConfigNameTable are not included.
+    Size alloc_bytes;
+
+    Uint64 getTotalWallNanosec () const
+    {
+        Uint64 total = 0;
+        for (unsigned i = 0; i < Phase_Num; ++i)
+            total += wall_nanosec [i];
+
+        return total;
+    }
+
+    Uint64 getTotalCpuNanosec () const
+    {
+        Uint64 total = 0;
+        for (unsigned i = 0; i < Phase_Num; ++i)
+            total += cpu_nanosec [i];
+
+        return total;
+    }
+
+    void reset ()
+    {
+        *this = ParseStats ();
+    }
+
+    ParseStats ()
+        : build_wall_nanosec (0),
+          used_preprocessor  (false),
+          num_bytes          (0),
+          num_tokens         (0),
+          num_pp_items       (0),
+          num_checkpoints    (0),
+          num_backtracks     (0),
+          num_sections       (0),
+          num_options        (0),
+          num_values         (0),
+          num_attributes     (0),
+          num_vars           (0),
+          num_section_specs  (0),
+          alloc_bytes        (0)
+    {
+        for (unsigned i = 0; i < Phase_Num; ++i) {
+            wall_nanosec [i] = 0;
+            cpu_nanosec  [i] = 0;
+        }
+    }
+};
+
+// Monotonic wall clock.
+Uint64 getParseWallNanosec ();
+
+// CPU time of the calling thread. Always 0 where not supported.
+Uint64 getParseCpuNanosec ();
+
+// Adds the time between construction and stop() (or destruction) to
+// @phase of @stats. Does nothing if @stats is NULL.
+class ParsePhaseTimer
+{
+private:
+    ParseStats * const stats;
+    ParseStats::Phase const phase;
+
+    Uint64 wall_start;
+    Uint64 cpu_start;
+
+public:
+    void stop ()
+    {
+        if (!stats || wall_start == (Uint64) -1)
+            return;
+
+        stats->wall_nanosec [phase] += getParseWallNanosec () - wall_start;
+        stats->cpu_nanosec  [phase] += getParseCpuNanosec  () - cpu_start;
+        wall_start = (Uint64) -1;
+    }
+
+    ParsePhaseTimer (ParseStats        * const stats,
+                     ParseStats::Phase   const phase)
+        : stats      (stats),
+          phase      (phase),
+          wall_start (stats ? getParseWallNanosec () : 0),
+          cpu_start  (stats ? getParseCpuNanosec  () : 0)
+    {
+    }
+
+    ~ParsePhaseTimer ()
+    {
+        stop ();
+    }
+};
+
+}
+
+
+#endif /* MCONFIG__PARSE_STATS__H__ */
+
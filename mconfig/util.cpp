@@ -27,31 +27,42 @@ using namespace M;
 
 namespace MConfig {
 
-BooleanValue strToBoolean (ConstMemory const value_mem)
+// Case-insensitive comparison with a lowercase keyword.
+static bool
+equalNoCase (ConstMemory const mem,
+	     char const * const keyword)
 {
-    if (value_mem.len() == 0)
+    Size const keyword_len = strlen (keyword);
+    if (mem.len() != keyword_len)
+	return false;
+
+    for (Size i = 0; i < keyword_len; ++i) {
+	if ((Byte) tolower (mem.mem() [i]) != (Byte) keyword [i])
+	    return false;
+    }
+
+    return true;
+}
+
+BooleanValue strToBoolean (ConstMemory const mem)
+{
+    if (mem.len() == 0)
 	return Boolean_Default;
 
-    // TODO malloc here is not necessary
-    Ref<String> value_str = grab (new String (value_mem));
-    Memory const mem = value_str->mem();
-    for (Size i = 0; i < mem.len(); ++i)
-	mem.mem() [i] = (Byte) tolower (mem.mem() [i]);
-
-    if (equal (mem, "y")    ||
-	equal (mem, "yes")  ||
-	equal (mem, "on")   ||
-	equal (mem, "true") ||
-	equal (mem, "1"))
+    if (equalNoCase (mem, "y")    ||
+	equalNoCase (mem, "yes")  ||
+	equalNoCase (mem, "on")   ||
+	equalNoCase (mem, "true") ||
+	equalNoCase (mem, "1"))
     {
 	return Boolean_True;
     }
 
-    if (equal (mem, "n")     ||
-	equal (mem, "no")    ||
-	equal (mem, "off")   ||
-	equal (mem, "false") ||
-	equal (mem, "0"))
+    if (equalNoCase (mem, "n")     ||
+	equalNoCase (mem, "no")    ||
+	equalNoCase (mem, "off")   ||
+	equalNoCase (mem, "false") ||
+	equalNoCase (mem, "0"))
     {
 	return Boolean_False;
     }
@@ -0,0 +1,169 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <mconfig/var_expander.h>
+
+
+using namespace M;
+
+namespace MConfig {
+
+void
+VarExpander::Buffer::append (ConstMemory const mem)
+{
+    if (size - len < mem.len()) {
+        Size new_size = (size ? size * 2 : 256);
+        while (new_size - len < mem.len())
+            new_size *= 2;
+
+        Byte * const new_buf = new (std::nothrow) Byte [new_size];
+        assert (new_buf);
+        if (len)
+            memcpy (new_buf, buf, len);
+
+        delete[] buf;
+        buf = new_buf;
+        size = new_size;
+    }
+
+    if (mem.len())
+        memcpy (buf + len, mem.mem(), mem.len());
+    len += mem.len();
+}
+
+Result
+VarExpander::expandVar (ConstMemory   const name,
+                        ConstMemory * const ret_value)
+{
+    ConfigNameKey const name_key (name);
+
+    if (ExpandedVar * const expanded_var = expanded_var_hash.lookup (name_key)) {
+        if (expanded_var->failed)
+            return Result::Failure;
+
+        if (expanded_var->in_progress) {
+            logE_ (_func, "Variable reference cycle through \"", name, "\"");
+            return Result::Failure;
+        }
+
+        *ret_value = expanded_var->value;
+        return Result::Success;
+    }
+
+    Varlist::Var * const var = varlist->lookupVar (name);
+    if (!var) {
+        logE_ (_func, "Undefined variable \"", name, "\"");
+        return Result::Failure;
+    }
+
+    ExpandedVar * const expanded_var = new (arena.alloc (sizeof (ExpandedVar))) ExpandedVar;
+    expanded_var->name_key = ConfigNameKey (var->getName(), name_key.hash);
+    expanded_var->in_progress = true;
+    expanded_var->failed = false;
+    expanded_var_hash.add (expanded_var);
+
+    if (!mayNeedExpansion (var->getValue())) {
+        expanded_var->value = var->getValue();
+    } else {
+        Buffer buf;
+        if (!expandTo (var->getValue(), &buf)) {
+            expanded_var->in_progress = false;
+            expanded_var->failed = true;
+            return Result::Failure;
+        }
+
+        expanded_var->value = arena.copy (ConstMemory (buf.buf, buf.len));
+    }
+
+    expanded_var->in_progress = false;
+    *ret_value = expanded_var->value;
+    return Result::Success;
+}
+
+Result
+VarExpander::expandTo (ConstMemory   const mem,
+                       Buffer      * const out)
+{
+    Byte const * const end = mem.mem() + mem.len();
+    Byte const *pos = mem.mem();
+    while (pos < end) {
+        Byte const * const dollar = (Byte const *) memchr (pos, '$', end - pos);
+        if (!dollar) {
+            out->append (ConstMemory (pos, end - pos));
+            break;
+        }
+
+        out->append (ConstMemory (pos, dollar - pos));
+
+        if (dollar + 1 < end && dollar [1] == '$') {
+            out->append (ConstMemory ("$", 1));
+            pos = dollar + 2;
+            continue;
+        }
+
+        if (dollar + 1 == end || dollar [1] != '{') {
+            out->append (ConstMemory ("$", 1));
+            pos = dollar + 1;
+            continue;
+        }
+
+        Byte const * const name_start = dollar + 2;
+        Byte const * const name_end = (Byte const *) memchr (name_start, '}', end - name_start);
+        if (!name_end) {
+            logE_ (_func, "Unterminated variable reference in \"", mem, "\"");
+            return Result::Failure;
+        }
+
+        ConstMemory value;
+        if (!expandVar (ConstMemory (name_start, name_end - name_start), &value))
+            return Result::Failure;
+
+        out->append (value);
+        pos = name_end + 1;
+    }
+
+    return Result::Success;
+}
+
+Result
+VarExpander::expand (ConstMemory   const mem,
+                     ConstMemory * const ret_mem)
+{
+    if (!mayNeedExpansion (mem)) {
+        *ret_mem = mem;
+        return Result::Success;
+    }
+
+    result_buf.len = 0;
+    if (!expandTo (mem, &result_buf))
+        return Result::Failure;
+
+    *ret_mem = ConstMemory (result_buf.buf, result_buf.len);
+    return Result::Success;
+}
+
+VarExpander::VarExpander (Varlist * const mt_nonnull varlist)
+    : varlist (varlist),
+      arena   (4096 /* chunk_size */)
+{
+}
+
+}
+
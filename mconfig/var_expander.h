@@ -0,0 +1,108 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef MCONFIG__VAR_EXPANDER__H__
+#define MCONFIG__VAR_EXPANDER__H__
+
+
+#include <libmary/libmary.h>
+#include <cstring>
+
+#include <mconfig/config_arena.h>
+#include <mconfig/config_name_table.h>
+#include <mconfig/varlist.h>
+
+
+namespace MConfig {
+
+using namespace M;
+
+// Expands ${name} references with values of variables from a Varlist.
+// The last occurrence of a variable is used. Values of variables may refer to
+// other variables; each variable is expanded once and the result is reused.
+// Undefined variables and reference cycles are errors. "$$" stands for
+// a literal '$'.
+class VarExpander
+{
+private:
+    struct ExpandedVar : public HashEntry<>
+    {
+        ConfigNameKey name_key;
+        ConstMemory   value;
+        // Set while the variable's own value is being expanded.
+        bool in_progress;
+        // Expansion has failed, the error has been reported already.
+        bool failed;
+    };
+
+    typedef Hash< ExpandedVar,
+                  ConfigNameKey,
+                  MemberExtractor< ExpandedVar,
+                                   ConfigNameKey,
+                                   &ExpandedVar::name_key >,
+                  ConfigNameKeyComparator,
+                  ConfigNameKeyHasher >
+            ExpandedVarHash;
+
+    struct Buffer
+    {
+        Byte *buf;
+        Size  len;
+        Size  size;
+
+        void append (ConstMemory mem);
+
+        Buffer () : buf (NULL), len (0), size (0) {}
+        ~Buffer () { delete[] buf; }
+    };
+
+    mt_const Varlist *varlist;
+
+    // Holds ExpandedVar records and expanded values.
+    ConfigArena arena;
+    ExpandedVarHash expanded_var_hash;
+
+    Buffer result_buf;
+
+    Result expandVar (ConstMemory  name,
+                      ConstMemory *ret_value);
+
+    Result expandTo (ConstMemory  mem,
+                     Buffer      *out);
+
+public:
+    static bool mayNeedExpansion (ConstMemory const mem)
+    {
+        return mem.len() && memchr (mem.mem(), '$', mem.len());
+    }
+
+    // On success, *ret_mem is valid until the next call to expand().
+    Result expand (ConstMemory  mem,
+                   ConstMemory *ret_mem);
+
+    // @varlist must outlive the expander and must not be modified.
+    VarExpander (Varlist * mt_nonnull varlist);
+};
+
+}
+
+
+#endif /* MCONFIG__VAR_EXPANDER__H__ */
+
@@ -12,76 +12,102 @@ Varlist::addEntry (ConstMemory const name,
                    bool        const enable_section,
                    bool        const disable_section)
 {
-    if (with_value
-        || (!enable_section && !disable_section))
-    {
-        Var * const var = new (std::nothrow) Var;
-        assert (var);
-        if (!with_value) {
+    ConfigNameKey const lookup_key (name);
+
+    Var *prev_var = NULL;
+    Section *prev_section = NULL;
+    bool const add_var = with_value || (!enable_section && !disable_section);
+    bool const add_section = enable_section || disable_section;
+    if (add_var)
+        prev_var = var_hash.lookup (lookup_key);
+    if (add_section)
+        prev_section = section_hash.lookup (lookup_key);
+
+  // Repeated names are stored once.
+    ConfigNameKey name_key;
+    if (prev_var)
+        name_key = prev_var->name_key;
+    else
+    if (prev_section)
+        name_key = prev_section->name_key;
+    else
+        name_key = ConfigNameKey (arena.copy (name), lookup_key.hash);
+
+    if (add_var) {
+        Var * const var = new (arena.alloc (sizeof (Var))) Var;
+        var->name_key = name_key;
+        if (with_value && value.len()) {
+            var->value_buf = arena.copy (value).mem();
+            var->value_len = value.len();
+        } else {
             var->value_buf = NULL;
             var->value_len = 0;
-        } else {
-            if (value.len()) {
-                var->value_buf = new (std::nothrow) Byte [value.len()];
-                assert (var->value_buf);
-                memcpy (var->value_buf, value.mem(), value.len());
-            } else {
-                var->value_buf = NULL;
-            }
-            var->value_len = value.len();
         }
 
-        if (name.len()) {
-            var->name_buf = new (std::nothrow) Byte [name.len()];
-            assert (var->name_buf);
-            memcpy (var->name_buf, name.mem(), name.len());
-        } else {
-            var->name_buf = NULL;
-        }
-        var->name_len = name.len();
+        var->prev_occurrence = prev_var;
+        if (prev_var)
+            var_hash.remove (prev_var);
 
+        var_hash.add (var);
         var_list.append (var);
     }
 
-    if (enable_section || disable_section) {
-        Section * const section = new (std::nothrow) Section;
-        assert (section);
+    if (add_section) {
+        Section * const section = new (arena.alloc (sizeof (Section))) Section;
+        section->name_key = name_key;
+        section->enabled = !disable_section;
 
-        if (name.len()) {
-            section->name_buf = new (std::nothrow) Byte [name.len()];
-            assert (section->name_buf);
-            memcpy (section->name_buf, name.mem(), name.len());
-        } else {
-            section->name_buf = NULL;
-        }
-        section->name_len = name.len();
-
-        if (disable_section)
-            section->enabled = false;
-        else
-            section->enabled = true;
+        section->prev_occurrence = prev_section;
+        if (prev_section)
+            section_hash.remove (prev_section);
 
+        section_hash.add (section);
         section_list.append (section);
     }
 }
 
-Varlist::~Varlist ()
+void
+Varlist::getMemoryStats (ConfigMemoryStats * const mt_nonnull ret_stats)
 {
+    ret_stats->reset ();
+
     {
-        VarList::iterator iter (var_list);
-        while (!iter.done()) {
-            Var * const var = iter.next ();
-            delete var;
+        VarList::iter iter (var_list);
+        while (!var_list.iter_done (iter)) {
+            Var * const var = var_list.iter_next (iter);
+
+            ++ret_stats->num_vars;
+            ret_stats->node_bytes += sizeof (Var);
+            ret_stats->string_bytes += var->value_len;
+          // Repeated names are stored once and indexed once.
+            if (!var->prev_occurrence) {
+                ret_stats->string_bytes += var->name_key.mem.len();
+                ret_stats->hash_bytes += sizeof (void*);
+            }
         }
     }
 
     {
-        SectionList::iterator iter (section_list);
-        while (!iter.done()) {
-            Section * const section = iter.next ();
-            delete section;
+        SectionList::iter iter (section_list);
+        while (!section_list.iter_done (iter)) {
+            Section * const section = section_list.iter_next (iter);
+
+            ++ret_stats->num_section_specs;
+            ret_stats->node_bytes += sizeof (Section);
+            if (!section->prev_occurrence) {
+                ret_stats->hash_bytes += sizeof (void*);
+
+                Var * const var = var_hash.lookup (section->name_key);
+                if (!var || var->name_key.mem.mem() != section->name_key.mem.mem())
+                    ret_stats->string_bytes += section->name_key.mem.len();
+            }
         }
     }
+
+    ret_stats->node_bytes += sizeof (Varlist);
+    ret_stats->num_hashes = 2;
+
+    arena.getMemoryStats (ret_stats);
 }
 
 void parseVarlistSection (MConfig::Section * const mt_nonnull section,
@@ -30,24 +30,31 @@ namespace MConfig {
 
 using namespace M;
 
+// Names and values of all entries are stored in a single arena. Entries are
+// kept in file order in var_list and section_list, and are indexed by name.
+// When a name occurs more than once, lookups return the last occurrence, and
+// earlier occurrences are reachable with getPrevOccurrence().
 class Varlist : public Object
 {
 public:
-    class Var : public IntrusiveListElement<>
+    class Var : public IntrusiveListElement<>,
+                public HashEntry<>
     {
         friend class Varlist;
 
     private:
-        Byte *name_buf;
-        Size  name_len;
+        ConfigNameKey name_key;
 
         Byte *value_buf;
         Size  value_len;
 
+        // Previous var with the same name.
+        Var *prev_occurrence;
+
     public:
         ConstMemory getName () const
         {
-            return ConstMemory (name_buf, name_len);
+            return name_key.mem;
         }
 
         ConstMemory getValue () const
@@ -55,29 +62,31 @@ public:
             return ConstMemory (value_buf, value_len);
         }
 
-        ~Var ()
+        Var* getPrevOccurrence () const
         {
-            delete[] name_buf;
-            delete[] value_buf;
+            return prev_occurrence;
         }
     };
 
     typedef IntrusiveList<Var> VarList;
 
-    class Section : public IntrusiveListElement<>
+    class Section : public IntrusiveListElement<>,
+                    public HashEntry<>
     {
         friend class Varlist;
 
     private:
-        Byte *name_buf;
-        Size  name_len;
+        ConfigNameKey name_key;
 
         bool enabled;
 
+        // Previous section specifier with the same name.
+        Section *prev_occurrence;
+
     public:
         ConstMemory getName () const
         {
-            return ConstMemory (name_buf, name_len);
+            return name_key.mem;
         }
 
         bool getEnabled () const
@@ -85,14 +94,40 @@ public:
             return enabled;
         }
 
-        ~Section ()
+        Section* getPrevOccurrence () const
         {
-            delete[] name_buf;
+            return prev_occurrence;
         }
     };
 
     typedef IntrusiveList<Section> SectionList;
 
+private:
+    typedef Hash< Var,
+                  ConfigNameKey,
+                  MemberExtractor< Var,
+                                   ConfigNameKey,
+                                   &Var::name_key >,
+                  ConfigNameKeyComparator,
+                  ConfigNameKeyHasher >
+            VarHash;
+
+    typedef Hash< Section,
+                  ConfigNameKey,
+                  MemberExtractor< Section,
+                                   ConfigNameKey,
+                                   &Section::name_key >,
+                  ConfigNameKeyComparator,
+                  ConfigNameKeyHasher >
+            SectionHash;
+
+    ConfigArena arena;
+
+    // Last occurrences only.
+    VarHash     var_hash;
+    SectionHash section_hash;
+
+public:
     VarList var_list;
     SectionList section_list;
 
@@ -102,7 +137,38 @@ public:
                    bool        enable_section,
                    bool        disable_section);
 
-    ~Varlist ();
+    // Returns the last var named @name, or NULL.
+    Var* lookupVar (ConstMemory const name)
+    {
+        return var_hash.lookup (ConfigNameKey (name));
+    }
+
+    // Returns the last enable/disable specifier for section @name, or NULL.
+    Section* lookupSection (ConstMemory const name)
+    {
+        return section_hash.lookup (ConfigNameKey (name));
+    }
+
+    // The last specifier for the section wins. Returns @default_enabled if
+    // the section is not mentioned.
+    bool isSectionEnabled (ConstMemory const name,
+                           bool        const default_enabled = false)
+    {
+        Section * const section = lookupSection (name);
+        if (!section)
+            return default_enabled;
+
+        return section->enabled;
+    }
+
+    // Fills @ret_stats with the number of vars and section specifiers and with
+    // the memory they take. All entries live in the varlist's arena.
+    void getMemoryStats (ConfigMemoryStats * mt_nonnull ret_stats);
+
+    Varlist ()
+        : arena (4096 /* chunk_size */)
+    {
+    }
 };
 
 void parseVarlistSection (MConfig::Section * mt_nonnull section,
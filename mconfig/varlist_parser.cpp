@@ -18,10 +18,12 @@
 
 
 #include <libmary/libmary.h>
+#include <cstring>
 
 #include <pargen/memory_token_stream.h>
 #include <pargen/parser.h>
 
+#include <mconfig/mapped_file.h>
 #include <mconfig/varlist_pargen.h>
 #include <mconfig/varlist_parser.h>
 
@@ -30,6 +32,9 @@ using namespace M;
 
 namespace MConfig {
 
+// Chunks end at the first newline after this many bytes.
+static Size const varlist_chunk_size = 1 << 20;
+
 bool
 varlist_word_token_match_func (ConstMemory const &token_mem,
                                void * const /* token_user_ptr */,
@@ -113,58 +118,11 @@ varlist_accept_var_decl (VarList_VarDecl        * const var_decl,
     return true;
 }
 
-Result VarlistParser::parseVarlist (ConstMemory   const filename,
-                                    Varlist     * const varlist)
+Result
+VarlistParser::parseVarlistChunk (ConstMemory   const mem,
+                                  ConstMemory   const filename,
+                                  Varlist     * const varlist)
 {
-    Byte *buf = NULL;
-
- try {
-    NativeFile file;
-    if (!file.open (filename, 0 /* open_flags */, FileAccessMode::ReadOnly)) {
-        logD_ (_func, "Could not open ", filename, ": ", exc->toString());
-        return Result::Failure;
-    }
-
-    ConstMemory mem;
-    {
-        FileStat fs;
-        if (!file.stat (&fs)) {
-            logE_ (_func, "NativeFile::stat() failed:\n", exc->backtrace());
-            return Result::Failure;
-        }
-
-        Uint64 const limit = (1 << 22 /* 4 MB */);
-        if (fs.size > limit) {
-            logE_ (_func, "varlist file is too large: ", fs.size, " bytes (max ", limit, " bytes");
-            return Result::Failure;
-        }
-
-        if (fs.size == 0) {
-          // Nothing to read. This early return simplifies EOF handling.
-            return Result::Success;
-        }
-
-        buf = new (std::nothrow) Byte [fs.size];
-        assert (buf);
-
-        Size nread;
-        IoResult const res = file.readFull (Memory (buf, fs.size), &nread);
-        if (res == IoResult::Error) {
-            delete[] buf;
-            logE_ (_func, "varlist file read error:\n", exc->backtrace());
-            return Result::Failure;
-        }
-
-        if (nread != fs.size) {
-            logW_ (_func, "WARNING: read size (", nread, ") differs from stat size (", fs.size, ")");
-        }
-        assert (nread <= fs.size);
-
-        mem = ConstMemory (buf, nread);
-
-        logD_ (_func, "varlist file data:\n", mem, "\n");
-    }
-
     Pargen::MemoryTokenStream token_stream;
     token_stream.init (mem,
                        true  /* report_newlines */,
@@ -184,9 +142,6 @@ Result VarlistParser::parseVarlist (ConstMemory   const filename,
                    parser_config,
                    false /* debug_dump */);
 
-    delete[] buf;
-    buf = NULL;
-
     ConstMemory token;
     if (!token_stream.getNextToken (&token)) {
         logE_ (_func, "Read error: ", exc->toString());
@@ -199,14 +154,81 @@ Result VarlistParser::parseVarlist (ConstMemory   const filename,
 	logE_ (_func, "Syntax error in configuration file ", filename);
 	return Result::Failure;
     }
+
+    return Result::Success;
+}
+
+Result
+VarlistParser::parseVarlistChunks (ConstMemory   const mem,
+                                   ConstMemory   const filename,
+                                   Varlist     * const varlist)
+{
+  // Statements end at newlines, so the file is parsed in chunks of whole
+  // lines. Parse trees are released after every chunk, which keeps memory
+  // usage independent of the size of the file.
+    Size pos = 0;
+    while (pos < mem.len()) {
+        Size end = mem.len();
+        if (mem.len() - pos > varlist_chunk_size) {
+            Byte const * const nl = (Byte const *) memchr (mem.mem() + pos + varlist_chunk_size,
+                                                           '\n',
+                                                           mem.len() - pos - varlist_chunk_size);
+            if (nl)
+                end = nl - mem.mem() + 1;
+        }
+
+        if (!parseVarlistChunk (mem.region (pos, end - pos), filename, varlist))
+            return Result::Failure;
+
+        pos = end;
+    }
+
+    return Result::Success;
+}
+
+Result VarlistParser::parseVarlist (ConstMemory   const filename,
+                                    Varlist     * const varlist,
+                                    ParseStats  * const stats)
+{
+ try {
+    ConfigMemoryStats initial_mem_stats;
+    if (stats) {
+        stats->reset ();
+        varlist->getMemoryStats (&initial_mem_stats);
+    }
+
+    ParsePhaseTimer read_timer (stats, ParseStats::Phase_Read);
+
+    MappedFile file;
+    if (!file.open (filename, false /* log_open_error */))
+        return Result::Failure;
+
+    read_timer.stop ();
+
+    ConstMemory const mem = file.getMem();
+    logD_ (_func, "varlist file ", filename, ": ", mem.len(), " bytes");
+
+    Result res = Result::Success;
+    {
+        ParsePhaseTimer parse_timer (stats, ParseStats::Phase_Parse);
+        res = parseVarlistChunks (mem, filename, varlist);
+    }
+
+    if (stats) {
+        ConfigMemoryStats mem_stats;
+        varlist->getMemoryStats (&mem_stats);
+
+        stats->num_bytes = mem.len();
+        stats->num_vars = mem_stats.num_vars - initial_mem_stats.num_vars;
+        stats->num_section_specs = mem_stats.num_section_specs - initial_mem_stats.num_section_specs;
+        stats->alloc_bytes = mem_stats.arena_used_bytes - initial_mem_stats.arena_used_bytes;
+    }
+
+    return res;
  } catch (...) {
-     delete[] buf;
      logE_ (_func, "parsing exception");
      return Result::Failure;
  }
-
-   delete[] buf;
-   return Result::Success;
 }
 
 VarlistParser::VarlistParser ()
@@ -25,6 +25,7 @@
 #include <pargen/parser.h>
 
 #include <mconfig/varlist.h>
+#include <mconfig/parse_stats.h>
 
 
 namespace MConfig {
@@ -37,9 +38,22 @@ private:
     mt_const StRef<Pargen::Grammar> grammar;
     mt_const StRef<Pargen::ParserConfig> parser_config;
 
+    Result parseVarlistChunk (ConstMemory  mem,
+                              ConstMemory  filename,
+                              Varlist     *varlist);
+
+    Result parseVarlistChunks (ConstMemory  mem,
+                               ConstMemory  filename,
+                               Varlist     *varlist);
+
 public:
+    // The file is mmap'ed and parsed in place, with no limit on its size.
+    // If @stats is non-NULL, it is reset and filled with timings and counters
+    // of the parse. Entry counts and alloc_bytes cover the entries added to
+    // @varlist by this call.
     Result parseVarlist (ConstMemory  filename,
-                         Varlist     *varlist);
+                         Varlist     *varlist,
+                         ParseStats  *stats = NULL);
 
     VarlistParser ();
 };
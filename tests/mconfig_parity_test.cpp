@@ -0,0 +1,255 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+// Checks that the native parser and the preprocessor + pargen pipeline agree.
+//
+// Every input is parsed in both modes. The sequences of parser events are
+// compared, and so are the resulting Config trees. Inputs which are syntax
+// errors have to be rejected by both parsers.
+
+
+#include <libmary/libmary.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <mconfig/mconfig.h>
+
+
+using namespace M;
+using namespace MConfig;
+
+namespace {
+
+char const * const valid_inputs [] = {
+    "a = b\n",
+    "a = b; c = d\n",
+    "key\n",
+    "multi word key = multi word value\n",
+    "list = 1, 2, 3\n",
+    "list = one two, three, \"four, five\"\n",
+    "empty = \"\"\n",
+    "addr = 1.2.3.4:80\n",
+    "quoted = \"a { b } = c ; d\"\n",
+    "// comment\na = b /* inline */ c\n/* multi\n   line */\n",
+    "spliced = one \\\n two\n",
+    "section {\n    a = b\n}\n",
+    "section { a = b; c = d;\n}\n",
+    "outer {\n    inner {\n        deep {\n            x = 1\n        }\n    }\n    y = 2\n}\n",
+    "empty_section {\n}\n",
+    "repeated { n = 1\n}\nrepeated { n = 2\n}\nrepeated { n = 3\n}\n",
+    "item x = 1 y {\n    z = 2\n}\n",
+    "item flag {\n}\n",
+    "item \"quoted attr\" = \"quoted value\" {\n}\n",
+  // Name-less sections: the first word is an attribute if it's followed by '='.
+    "a = b {\n    c = d\n}\n",
+    "a = b c = d flag {\n}\n",
+    "{\n    x = 1\n}\n",
+    "x = 1\ns {\n    y = 2\n}\nz = 3\n",
+    "last = 1\nlast = 2\n",
+    "\n\n;;\n  a = b  \n\n"
+};
+
+char const * const invalid_inputs [] = {
+    "}\n",
+    "a {\n",
+    "a = {\n}\n",
+    "a = b = c {\n}\n",
+    "section { } }\n",
+  // '}' has to follow a newline or ';'.
+    "section { a = b }\n"
+};
+
+class Trace
+{
+private:
+    char buf [16384];
+    Size len;
+
+public:
+    void append (char const * const str,
+                 ConstMemory  const mem = ConstMemory())
+    {
+        int const res = snprintf (buf + len, sizeof (buf) - len, "%s%.*s",
+                                  str, (int) mem.len(), (char const *) mem.mem());
+        assert (res >= 0);
+        len += (Size) res;
+        if (len >= sizeof (buf))
+            len = sizeof (buf) - 1;
+    }
+
+    char const * get () const
+    {
+        return buf;
+    }
+
+    bool equals (Trace const &trace) const
+    {
+        return len == trace.len && !memcmp (buf, trace.buf, len);
+    }
+
+    Trace ()
+        : len (0)
+    {
+        buf [0] = 0;
+    }
+};
+
+bool traceBeginSection (ConstMemory                 const section_name,
+                        ConfigAttributeDesc const * const attrs,
+                        Count                       const num_attrs,
+                        void                      * const _trace)
+{
+    Trace * const trace = static_cast <Trace*> (_trace);
+
+    trace->append ("begin [", section_name);
+    trace->append ("]");
+    for (Count i = 0; i < num_attrs; ++i) {
+        trace->append (" [", attrs [i].name);
+        if (attrs [i].has_value)
+            trace->append ("]=[", attrs [i].value);
+        trace->append ("]");
+    }
+    trace->append ("\n");
+
+    return true;
+}
+
+bool traceOption (ConstMemory         const key,
+                  ConstMemory const * const values,
+                  Count               const num_values,
+                  void              * const _trace)
+{
+    Trace * const trace = static_cast <Trace*> (_trace);
+
+    trace->append ("option [", key);
+    trace->append ("]");
+    for (Count i = 0; i < num_values; ++i) {
+        trace->append (i ? ", [" : " = [", values [i]);
+        trace->append ("]");
+    }
+    trace->append ("\n");
+
+    return true;
+}
+
+bool traceEndSection (void * const _trace)
+{
+    static_cast <Trace*> (_trace)->append ("end\n");
+    return true;
+}
+
+void traceCancelSection (void * const _trace)
+{
+    static_cast <Trace*> (_trace)->append ("cancel\n");
+}
+
+ConfigEvents const trace_events = {
+    traceBeginSection,
+    traceOption,
+    traceEndSection,
+    traceCancelSection
+};
+
+void countChange (ConfigChange const * const /* change */,
+                  void               * const /* cb_data */)
+{
+}
+
+bool checkValid (char const * const input)
+{
+    ConstMemory const mem (input, strlen (input));
+
+    Trace native_trace;
+    Trace pargen_trace;
+    if (!parseConfigEventsFromMemory (mem, &trace_events, &native_trace, ConfigParserMode_Native)) {
+        fprintf (stderr, "FAIL: native parser rejected:\n%s\n", input);
+        return false;
+    }
+
+    if (!parseConfigEventsFromMemory (mem, &trace_events, &pargen_trace, ConfigParserMode_Pargen)) {
+        fprintf (stderr, "FAIL: pargen parser rejected:\n%s\n", input);
+        return false;
+    }
+
+    if (!native_trace.equals (pargen_trace)) {
+        fprintf (stderr, "FAIL: events differ for:\n%s\n--- native:\n%s--- pargen:\n%s\n",
+                 input, native_trace.get(), pargen_trace.get());
+        return false;
+    }
+
+    Ref<Config> const native_config = grab (new (std::nothrow) Config);
+    Ref<Config> const pargen_config = grab (new (std::nothrow) Config);
+    if (!parseConfigFromMemory (mem, native_config, ConfigParserMode_Native)
+        || !parseConfigFromMemory (mem, pargen_config, ConfigParserMode_Pargen))
+    {
+        fprintf (stderr, "FAIL: could not build trees for:\n%s\n", input);
+        return false;
+    }
+
+    Count const num_changes = diffConfigs (native_config, pargen_config, countChange, NULL);
+    if (num_changes) {
+        fprintf (stderr, "FAIL: trees differ in %lu places for:\n%s\n", (unsigned long) num_changes, input);
+        return false;
+    }
+
+    return true;
+}
+
+bool checkInvalid (char const * const input)
+{
+    ConstMemory const mem (input, strlen (input));
+
+    Trace trace;
+    bool const native_res = parseConfigEventsFromMemory (mem, &trace_events, &trace, ConfigParserMode_Native);
+    bool const pargen_res = parseConfigEventsFromMemory (mem, &trace_events, &trace, ConfigParserMode_Pargen);
+    if (native_res || pargen_res) {
+        fprintf (stderr, "FAIL: accepted by the %s parser:\n%s\n",
+                 (native_res ? (pargen_res ? "native and pargen" : "native") : "pargen"), input);
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+int main ()
+{
+    libMaryInit ();
+
+    unsigned num_failed = 0;
+    unsigned num_checked = 0;
+
+    for (Size i = 0; i < sizeof (valid_inputs) / sizeof (*valid_inputs); ++i) {
+        ++num_checked;
+        if (!checkValid (valid_inputs [i]))
+            ++num_failed;
+    }
+
+    for (Size i = 0; i < sizeof (invalid_inputs) / sizeof (*invalid_inputs); ++i) {
+        ++num_checked;
+        if (!checkInvalid (invalid_inputs [i]))
+            ++num_failed;
+    }
+
+    printf ("mconfig_parity_test: %u of %u inputs failed\n", num_failed, num_checked);
+    return num_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
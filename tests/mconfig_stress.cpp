@@ -0,0 +1,350 @@
+/*  MConfig - C++ library for working with configuration files
+    Copyright (C) 2012 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+// Stress test for concurrent readers of a shared Config.
+//
+// Usage: mconfig_stress [threads] [iterations]
+//
+// Builds a Config with integer, floating point, boolean, list and malformed
+// options, then reads all of them from several threads at once through
+// Config's typed getters, ConfigPath handles, Value::getAs*() and
+// Option::get*Array(). Every decoded value is compared with the expected one.
+// After the threads have finished, checks that each bad value has been
+// reported exactly once across all threads, that Option::getNumBadValues()
+// matches the number of failed reads and that lookups have not modified
+// the tree.
+//
+// Prints one line per failed check and exits with a non-zero status if there
+// were any. Best run under ThreadSanitizer as well.
+
+
+#include <libmary/libmary.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <mconfig/mconfig.h>
+
+
+using namespace M;
+using namespace MConfig;
+
+namespace {
+
+Count const num_options = 256;
+Count const num_bad     = 16;
+Count const list_len    = 16;
+
+Config *config;
+unsigned long num_iterations = 100;
+pthread_barrier_t start_barrier;
+
+AtomicInt num_errors;
+// Number of times Value::reportInvalid() returned true for raw_* options.
+AtomicInt num_reports;
+// Number of failed typed reads of bad_* options.
+AtomicInt num_bad_reads;
+
+Int64  expectedInt64  (Count const i) { return (Int64) i * 7919 - 1000000; }
+Uint64 expectedUint64 (Count const i) { return (Uint64) 18000000000000000000ULL + i; }
+double expectedDouble (Count const i) { return (double) i + 0.25; }
+bool   expectedBool   (Count const i) { return i % 2; }
+
+ConstMemory makePath (char        * const buf,
+                      Size          const len,
+                      char const  * const prefix,
+                      Count         const i)
+{
+    int const res = snprintf (buf, len, "%s_%lu", prefix, (unsigned long) i);
+    assert (res > 0 && (Size) res < len);
+    return ConstMemory (buf, (Size) res);
+}
+
+void error (char const * const what,
+            Count        const i)
+{
+    fprintf (stderr, "mconfig_stress: %s, option %lu\n", what, (unsigned long) i);
+    num_errors.inc ();
+}
+
+void buildConfig ()
+{
+    char path_buf [64];
+    char value_buf [64];
+
+    for (Count i = 0; i < num_options; ++i) {
+        snprintf (value_buf, sizeof (value_buf), "%lld", (long long) expectedInt64 (i));
+        config->setOption (makePath (path_buf, sizeof (path_buf), "ints/int", i),
+                           ConstMemory (value_buf, strlen (value_buf)));
+
+        snprintf (value_buf, sizeof (value_buf), "%llu", (unsigned long long) expectedUint64 (i));
+        config->setOption (makePath (path_buf, sizeof (path_buf), "uints/uint", i),
+                           ConstMemory (value_buf, strlen (value_buf)));
+
+        snprintf (value_buf, sizeof (value_buf), "%lu.25", (unsigned long) i);
+        config->setOption (makePath (path_buf, sizeof (path_buf), "doubles/double", i),
+                           ConstMemory (value_buf, strlen (value_buf)));
+
+        config->setOption (makePath (path_buf, sizeof (path_buf), "bools/bool", i),
+                           expectedBool (i) ? ConstMemory ("yes") : ConstMemory ("no"));
+
+        Option * const list = config->setOption (makePath (path_buf, sizeof (path_buf), "lists/list", i),
+                                                 ConstMemory ("0"));
+        for (Count j = 1; j < list_len; ++j) {
+            snprintf (value_buf, sizeof (value_buf), "%lu", (unsigned long) (i + j));
+            list->addValue (ConstMemory (value_buf, strlen (value_buf)));
+        }
+    }
+
+    for (Count i = 0; i < num_bad; ++i) {
+        snprintf (value_buf, sizeof (value_buf), "bad value %lu", (unsigned long) i);
+        config->setOption (makePath (path_buf, sizeof (path_buf), "bad/bad", i),
+                           ConstMemory (value_buf, strlen (value_buf)));
+        config->setOption (makePath (path_buf, sizeof (path_buf), "raw/raw", i),
+                           ConstMemory (value_buf, strlen (value_buf)));
+    }
+}
+
+void checkOptions (ConfigPath ** const int_paths)
+{
+    char path_buf [64];
+
+    for (Count i = 0; i < num_options; ++i) {
+        {
+            Int64 val;
+            if (config->getInt64 (makePath (path_buf, sizeof (path_buf), "ints/int", i), &val) != GetResult::Success
+                || val != expectedInt64 (i))
+            {
+                error ("getInt64() mismatch", i);
+            }
+        }
+
+        {
+            Int64 val;
+            if (int_paths [i]->getInt64 (config, &val) != GetResult::Success
+                || val != expectedInt64 (i))
+            {
+                error ("ConfigPath::getInt64() mismatch", i);
+            }
+        }
+
+        {
+            Uint64 val;
+            if (config->getUint64 (makePath (path_buf, sizeof (path_buf), "uints/uint", i), &val) != GetResult::Success
+                || val != expectedUint64 (i))
+            {
+                error ("getUint64() mismatch", i);
+            }
+        }
+
+        {
+            double val;
+            if (config->getDouble (makePath (path_buf, sizeof (path_buf), "doubles/double", i), &val) != GetResult::Success
+                || val != expectedDouble (i))
+            {
+                error ("getDouble() mismatch", i);
+            }
+        }
+
+        {
+            BooleanValue const val = config->getBoolean (makePath (path_buf, sizeof (path_buf), "bools/bool", i));
+            if (val != (expectedBool (i) ? Boolean_True : Boolean_False))
+                error ("getBoolean() mismatch", i);
+        }
+
+        {
+            Option * const list = config->getOption (makePath (path_buf, sizeof (path_buf), "lists/list", i));
+            Int64 const *elems;
+            Count num_elems;
+            if (!list
+                || !list->getInt64Array (&elems, &num_elems)
+                || num_elems != list_len)
+            {
+                error ("getInt64Array() failed", i);
+            } else {
+                for (Count j = 0; j < list_len; ++j) {
+                    if (elems [j] != (Int64) (j ? i + j : 0)) {
+                        error ("getInt64Array() mismatch", i);
+                        break;
+                    }
+                }
+            }
+        }
+
+      // Lookups through an option must fail without touching the option.
+        {
+            char sub_buf [72];
+            snprintf (sub_buf, sizeof (sub_buf), "ints/int_%lu/sub", (unsigned long) i);
+            if (config->getOption (ConstMemory (sub_buf, strlen (sub_buf))))
+                error ("lookup through an option succeeded", i);
+        }
+    }
+
+    for (Count i = 0; i < num_bad; ++i) {
+        ConstMemory const bad_path = makePath (path_buf, sizeof (path_buf), "bad/bad", i);
+
+        Int64 int64_val;
+        if (config->getInt64 (bad_path, &int64_val) != GetResult::Invalid)
+            error ("getInt64() accepted a bad value", i);
+        else
+            num_bad_reads.inc ();
+
+        Uint64 uint64_val;
+        if (config->getUint64 (bad_path, &uint64_val) != GetResult::Invalid)
+            error ("getUint64() accepted a bad value", i);
+        else
+            num_bad_reads.inc ();
+
+        double double_val;
+        if (config->getDouble (bad_path, &double_val) != GetResult::Invalid)
+            error ("getDouble() accepted a bad value", i);
+        else
+            num_bad_reads.inc ();
+
+        Option * const raw = config->getOption (makePath (path_buf, sizeof (path_buf), "raw/raw", i));
+        Value * const value = (raw ? raw->getValue() : NULL);
+        if (!value) {
+            error ("raw option not found", i);
+            continue;
+        }
+
+        if (value->getAsInt64 (&int64_val))
+            error ("Value::getAsInt64() accepted a bad value", i);
+
+        if (value->reportInvalid (Value::DecodedType_Int64))
+            num_reports.inc ();
+    }
+}
+
+void* threadFunc (void * const /* arg */)
+{
+    char path_buf [64];
+
+    // ConfigPath is not thread-safe, every thread has its own handles.
+    ConfigPath *int_paths [num_options];
+    for (Count i = 0; i < num_options; ++i) {
+        int_paths [i] = new (std::nothrow) ConfigPath (makePath (path_buf, sizeof (path_buf), "ints/int", i));
+        assert (int_paths [i]);
+    }
+
+    pthread_barrier_wait (&start_barrier);
+
+    for (unsigned long i = 0; i < num_iterations; ++i)
+        checkOptions (int_paths);
+
+    for (Count i = 0; i < num_options; ++i)
+        delete int_paths [i];
+
+    return NULL;
+}
+
+void usage ()
+{
+    fprintf (stderr, "Usage: mconfig_stress [threads] [iterations]\n");
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    libMaryInit ();
+
+    if (argc > 3) {
+        usage ();
+        return EXIT_FAILURE;
+    }
+
+    unsigned long num_threads = 8;
+    if (argc >= 2) {
+        num_threads = strtoul (argv [1], NULL, 10);
+        if (num_threads == 0) {
+            usage ();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc >= 3) {
+        num_iterations = strtoul (argv [2], NULL, 10);
+        if (num_iterations == 0) {
+            usage ();
+            return EXIT_FAILURE;
+        }
+    }
+
+    Ref<Config> const config_ref = grab (new (std::nothrow) Config);
+    config = config_ref;
+    buildConfig ();
+    Uint64 const generation = config->getGeneration();
+
+    pthread_t * const threads = new (std::nothrow) pthread_t [num_threads];
+    assert (threads);
+
+    if (pthread_barrier_init (&start_barrier, NULL, (unsigned) num_threads)) {
+        perror ("mconfig_stress: pthread_barrier_init()");
+        return EXIT_FAILURE;
+    }
+
+    for (unsigned long i = 0; i < num_threads; ++i) {
+        if (pthread_create (&threads [i], NULL, threadFunc, NULL)) {
+            perror ("mconfig_stress: pthread_create()");
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (unsigned long i = 0; i < num_threads; ++i)
+        pthread_join (threads [i], NULL);
+
+    pthread_barrier_destroy (&start_barrier);
+    delete[] threads;
+
+    if (num_reports.get() != (int) num_bad) {
+        fprintf (stderr, "mconfig_stress: %d bad values reported, expected %lu\n",
+                 num_reports.get(), (unsigned long) num_bad);
+        num_errors.inc ();
+    }
+
+    {
+        char path_buf [64];
+        Uint64 total_bad_values = 0;
+        for (Count i = 0; i < num_bad; ++i) {
+            Option * const option = config->getOption (makePath (path_buf, sizeof (path_buf), "bad/bad", i));
+            if (option)
+                total_bad_values += option->getNumBadValues();
+        }
+
+        if (total_bad_values != (Uint64) num_bad_reads.get()) {
+            fprintf (stderr, "mconfig_stress: getNumBadValues() sums up to %llu, expected %d\n",
+                     (unsigned long long) total_bad_values, num_bad_reads.get());
+            num_errors.inc ();
+        }
+    }
+
+    if (config->getGeneration() != generation) {
+        fprintf (stderr, "mconfig_stress: the tree has been modified by lookups\n");
+        num_errors.inc ();
+    }
+
+    printf ("mconfig_stress: %lu threads, %lu iterations, %d errors\n",
+            num_threads, num_iterations, num_errors.get());
+
+    return num_errors.get() ? EXIT_FAILURE : EXIT_SUCCESS;
+}